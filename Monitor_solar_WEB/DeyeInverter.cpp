@@ -1,52 +1,152 @@
 #include "DeyeInverter.h"
+#include "DeyeRegisters.h"
+#include "InverterProfile.h"
+#include "ReadPlanner.h"
 
-DeyeInverter::DeyeInverter(SolarmanV5 *solarman) {
-    _solarman = solarman;
-}
-
-bool DeyeInverter::isRegisterSigned(uint16_t register_addr) {
-    // Lista de registros que contienen valores signed (2's complement)
-    switch(register_addr) {
-        case 0x00BE: // Battery Power
-        case 0x00BF: // Battery Current
-        case 0x00A9: // Grid Power
-        case 0x00AF: // Total Power
-        case 0x00AD: // Inverter L1 Power
-        case 0x00AE: // Inverter L2 Power
-            return true;
-        default:
+// Índice del bloque del plan que contiene entero a `block`, o -1
+static int findBlock(const ReadPlan &plan, const RegisterBlock &block) {
+    for (size_t i = 0; i < plan.count; i++) {
+        if (block.start_addr >= plan.blocks[i].start_addr &&
+            block.start_addr + block.count <= plan.blocks[i].start_addr + plan.blocks[i].count) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void removeBlock(ReadPlan *plan, size_t index) {
+    plan->count--;
+    memmove(&plan->blocks[index], &plan->blocks[index + 1], (plan->count - index) * sizeof(RegisterBlock));
+}
+
+// Añade un bloque al final; si no cabe, se olvida el más antiguo
+static void appendBlock(ReadPlan *plan, const RegisterBlock &block) {
+    if (plan->count == MAX_PLAN_BLOCKS) {
+        removeBlock(plan, 0);
+    }
+    plan->blocks[plan->count++] = block;
+}
+
+DeyeInverter::DeyeInverter(RegisterReader *reader) {
+    _reader = reader;
+    memset(_regs, 0, sizeof(_regs));
+    memset(_cache, 0, sizeof(_cache));
+    _generation = 0;
+    _register_queue.count = 0;
+    _register_reads.count = 0;
+    _register_pending = 0;
+    _register_failed.count = 0;
+    _profile = nullptr;
+    _registers = DEYE_REGISTERS;
+    _register_count = DEYE_REGISTER_COUNT;
+    _conversions = nullptr;
+    _max_span = DEFAULT_MAX_SPAN;
+    _max_gap = DEFAULT_MAX_GAP;
+    _plan_span = DEFAULT_MAX_SPAN;
+    _async_plan = nullptr;
+    _async_data = nullptr;
+    _async_callback = nullptr;
+    _async_ctx = nullptr;
+    _async_pending = 0;
+    _async_poll_mask = 0;
+    _async_ok = false;
+    _async_started_us = 0;
+    _failed_cycles = 0;
+    for (uint8_t g = 0; g < GROUP_COUNT; g++) {
+        _group_plans[g].count = 0;
+    }
+    for (uint8_t m = 0; m <= ALL_POLL_MASK; m++) {
+        _poll_plans[m].count = 0;
+    }
+    
+    _poll_periods[POLL_LIVE] = DEFAULT_LIVE_PERIOD;
+    _poll_periods[POLL_THERMAL] = DEFAULT_THERMAL_PERIOD;
+    _poll_periods[POLL_TOTALS] = DEFAULT_TOTALS_PERIOD;
+    _poll_periods[POLL_STATIC] = 0;
+    memset(_last_poll, 0, sizeof(_last_poll));
+    _attempted_mask = 0;
+    _polled_mask = 0;
+    
+    _push_layout.count = 0;
+    
+    buildPlans(DEFAULT_MAX_SPAN, DEFAULT_MAX_GAP);
+}
+
+bool DeyeInverter::buildPlans(uint16_t max_span, uint16_t max_gap) {
+    ReadPlan group_plans[GROUP_COUNT];
+    ReadPlan poll_plans[1 << POLL_CLASS_COUNT];
+    
+    if (max_span > RegisterReader::MAX_REGISTERS_PER_READ) {
+        max_span = RegisterReader::MAX_REGISTERS_PER_READ;
+    }
+    uint16_t span = max_span;
+    if (span > _reader->getMaxSpan()) {
+        span = _reader->getMaxSpan();
+    }
+    
+    for (uint8_t g = 0; g < GROUP_COUNT; g++) {
+        if (!ReadPlanner::build(_registers, _register_count, 1 << g, ALL_POLL_MASK,
+                                span, max_gap, &group_plans[g])) {
+            return false;
+        }
+    }
+    // Las clases que vencen a la vez comparten peticiones
+    for (uint8_t m = 0; m <= ALL_POLL_MASK; m++) {
+        if (!ReadPlanner::build(_registers, _register_count, ALL_GROUPS_MASK, m,
+                                span, max_gap, &poll_plans[m])) {
             return false;
+        }
     }
+    
+    memcpy(_group_plans, group_plans, sizeof(_group_plans));
+    memcpy(_poll_plans, poll_plans, sizeof(_poll_plans));
+    _max_span = max_span;
+    _max_gap = max_gap;
+    _plan_span = span;
+    return true;
 }
 
-String DeyeInverter::getBatteryStatus(uint16_t status) {
-    switch(status) {
-        case 0: return "Charge";
-        case 1: return "Stand-by";
-        case 2: return "Discharge";
-        default: return "Unknown";
+void DeyeInverter::followReaderSpan() {
+    uint16_t span = _max_span < _reader->getMaxSpan() ? _max_span : _reader->getMaxSpan();
+    if (span != _plan_span) {
+        // Si con el nuevo límite no cabe, se siguen usando los planes anteriores
+        buildPlans(_max_span, _max_gap);
     }
 }
 
-String DeyeInverter::getRunningStatus(uint16_t status) {
-    switch(status) {
-        case 0: return "Stand-by";
-        case 1: return "Self-checking";
-        case 2: return "Normal";
-        case 3: return "FAULT";
-        default: return "Unknown";
+bool DeyeInverter::setReadPlanLimits(uint16_t max_span, uint16_t max_gap) {
+    if (_async_data != nullptr) {
+        return false;
     }
+    return buildPlans(max_span, max_gap);
 }
 
-String DeyeInverter::getWorkMode(uint16_t mode) {
-    switch(mode) {
-        case 0: return "Selling First";
-        case 1: return "Zero-Export to Load&Solar Sell";
-        case 2: return "Zero-Export to Home&Solar Sell";
-        case 3: return "Zero-Export to Load";
-        case 4: return "Zero-Export to Home";
-        default: return "Unknown";
+bool DeyeInverter::setProfile(const InverterProfile *profile) {
+    if (_async_data != nullptr) {
+        return false;
     }
+    
+    const InverterProfile *old_profile = _profile;
+    const RegisterDescriptor *old_registers = _registers;
+    size_t old_count = _register_count;
+    const ValueConversion *old_conversions = _conversions;
+    
+    _profile = profile;
+    _registers = profile ? profile->getRegisters() : DEYE_REGISTERS;
+    _register_count = profile ? profile->getRegisterCount() : DEYE_REGISTER_COUNT;
+    _conversions = profile ? profile->getConversions() : nullptr;
+    if (!buildPlans(_max_span, _max_gap)) {
+        _profile = old_profile;
+        _registers = old_registers;
+        _register_count = old_count;
+        _conversions = old_conversions;
+        return false;
+    }
+    
+    // Los campos ya no vienen de los mismos registros: todo está por leer
+    _attempted_mask = 0;
+    _polled_mask = 0;
+    return true;
 }
 
 float DeyeInverter::applyScaleAndOffset(uint16_t value, float scale, int16_t offset, bool is_signed) {
@@ -58,175 +158,480 @@ float DeyeInverter::applyScaleAndOffset(uint16_t value, float scale, int16_t off
     }
 }
 
+bool DeyeInverter::fetchPlan(const ReadPlan &plan) {
+    SolarmanReadRequest requests[MAX_PLAN_BLOCKS];
+    
+    for (size_t i = 0; i < plan.count; i++) {
+        requests[i].start_addr = plan.blocks[i].start_addr;
+        requests[i].count = plan.blocks[i].count;
+        requests[i].values = &_regs[plan.blocks[i].start_addr];
+    }
+    
+    bool ok = _reader->readPipelined(requests, plan.count);
+    for (size_t i = 0; i < plan.count; i++) {
+        if (requests[i].ok) {
+            storeBlock(requests[i].start_addr, requests[i].count);
+        }
+    }
+    return ok;
+}
+
+void DeyeInverter::storeBlock(uint16_t start_addr, uint16_t count) {
+    // El bloque nuevo sustituye a los que cubre enteros; si no deja ninguna
+    // entrada libre, al más antiguo
+    CacheEntry *slot = &_cache[0];
+    for (size_t i = 0; i < CACHE_ENTRIES; i++) {
+        CacheEntry &entry = _cache[i];
+        if (entry.count > 0 && entry.start_addr >= start_addr &&
+            entry.start_addr + entry.count <= start_addr + count) {
+            entry.count = 0;
+        }
+        if (slot->count > 0 && (entry.count == 0 || entry.generation < slot->generation)) {
+            slot = &entry;
+        }
+    }
+    _generation++;
+    slot->start_addr = start_addr;
+    slot->count = count;
+    slot->timestamp = _reader->getClock()->millis();
+    slot->generation = _generation;
+    
+    // Lo que se ha vuelto a leer bien ya no cuenta como fallido
+    for (size_t i = _register_failed.count; i > 0; i--) {
+        const RegisterBlock &failed = _register_failed.blocks[i - 1];
+        if (failed.start_addr >= start_addr && failed.start_addr + failed.count <= start_addr + count) {
+            removeBlock(&_register_failed, i - 1);
+        }
+    }
+}
+
+const DeyeInverter::CacheEntry *DeyeInverter::findCached(uint16_t addr) {
+    const CacheEntry *newest = nullptr;
+    for (size_t i = 0; i < CACHE_ENTRIES; i++) {
+        const CacheEntry &entry = _cache[i];
+        if (entry.count > 0 && addr >= entry.start_addr && addr < entry.start_addr + entry.count &&
+            (!newest || entry.generation > newest->generation)) {
+            newest = &entry;
+        }
+    }
+    return newest;
+}
+
+bool DeyeInverter::isCached(uint16_t addr, unsigned long now, uint32_t max_age_ms, uint32_t min_generation) {
+    const CacheEntry *entry = findCached(addr);
+    if (!entry) {
+        return false;
+    }
+    return (min_generation > 0 && entry->generation >= min_generation) ||
+           (max_age_ms > 0 && now - entry->timestamp <= max_age_ms);
+}
+
+bool DeyeInverter::getCachedRegister(uint16_t addr, CachedRegister *out) {
+    const CacheEntry *entry = addr < REGISTER_MAP_SIZE ? findCached(addr) : nullptr;
+    if (!entry) {
+        return false;
+    }
+    out->value = _regs[addr];
+    out->timestamp = entry->timestamp;
+    out->generation = entry->generation;
+    return true;
+}
+
+DeyeInverter::RegisterRequest DeyeInverter::requestRegisters(uint16_t start_addr, uint16_t count,
+                                                             uint32_t max_age_ms, uint32_t min_generation) {
+    if (count == 0 || start_addr >= REGISTER_MAP_SIZE || count > REGISTER_MAP_SIZE - start_addr) {
+        return REGISTERS_REJECTED;
+    }
+    
+    unsigned long now = _reader->getClock()->millis();
+    uint16_t span = _plan_span < _reader->getMaxSpan() ? _plan_span : _reader->getMaxSpan();
+    uint16_t end = start_addr + count;
+    RegisterRequest result = REGISTERS_CACHED;
+    uint16_t addr = start_addr;
+    while (addr < end) {
+        if (isCached(addr, now, max_age_ms, min_generation)) {
+            addr++;
+            continue;
+        }
+        // Se pide desde el primer registro que falta hasta el último que falta a
+        // menos de _max_gap registros del anterior, como en los planes de lectura
+        uint16_t last = addr;
+        for (uint16_t r = addr + 1; r < end && r - addr < span && r - last - 1 <= _max_gap; r++) {
+            if (!isCached(r, now, max_age_ms, min_generation)) {
+                last = r;
+            }
+        }
+        RegisterBlock block = {addr, (uint16_t)(last - addr + 1)};
+        addr = last + 1;
+        
+        int failed = findBlock(_register_failed, block);
+        if (failed >= 0) {
+            // El fallo se informa una vez: la próxima petición lo vuelve a leer
+            removeBlock(&_register_failed, failed);
+            result = REGISTERS_FAILED;
+            continue;
+        }
+        if (findBlock(_register_queue, block) < 0 &&
+            (_register_pending == 0 || findBlock(_register_reads, block) < 0)) {
+            if (_register_queue.count == MAX_PLAN_BLOCKS) {
+                return REGISTERS_REJECTED;
+            }
+            _register_queue.blocks[_register_queue.count++] = block;
+        }
+        if (result == REGISTERS_CACHED) {
+            result = REGISTERS_PENDING;
+        }
+    }
+    return result;
+}
+
+void DeyeInverter::startRegisterReads() {
+    // Escriben en la misma imagen de registros que el plan: se espera a que acabe
+    if (_register_queue.count == 0 || isReading()) {
+        return;
+    }
+    _register_reads = _register_queue;
+    _register_queue.count = 0;
+    _register_pending = _register_reads.count;
+    for (size_t i = 0; i < _register_reads.count; i++) {
+        const RegisterBlock &block = _register_reads.blocks[i];
+        _register_handles[i] = _reader->beginRead(block.start_addr, block.count, &_regs[block.start_addr],
+                                                  onRegistersRead, this);
+        if (_register_handles[i] < 0) {
+            appendBlock(&_register_failed, block);
+            _register_pending--;
+        }
+    }
+}
+
+void DeyeInverter::onRegistersRead(int handle, bool ok, void *ctx) {
+    DeyeInverter *self = (DeyeInverter *)ctx;
+    for (size_t i = 0; i < self->_register_reads.count; i++) {
+        if (self->_register_handles[i] == handle) {
+            const RegisterBlock &block = self->_register_reads.blocks[i];
+            if (ok) {
+                self->storeBlock(block.start_addr, block.count);
+            } else {
+                appendBlock(&self->_register_failed, block);
+            }
+            break;
+        }
+    }
+    if (self->_register_pending > 0) {
+        self->_register_pending--;
+    }
+}
+
+void DeyeInverter::markPolled(uint8_t poll_mask, bool ok) {
+    unsigned long now = _reader->getClock()->millis();
+    for (uint8_t c = 0; c < POLL_CLASS_COUNT; c++) {
+        if (poll_mask & (1 << c)) {
+            _last_poll[c] = now;
+        }
+    }
+    _attempted_mask |= poll_mask;
+    if (ok) {
+        _polled_mask |= poll_mask;
+    }
+}
+
+uint8_t DeyeInverter::getDueClasses() {
+    unsigned long now = _reader->getClock()->millis();
+    uint8_t due = 0;
+    
+    for (uint8_t c = 0; c < POLL_CLASS_COUNT; c++) {
+        uint8_t bit = 1 << c;
+        uint32_t wait = _poll_periods[c];
+        
+        if (!(_attempted_mask & bit)) {
+            due |= bit;
+            continue;
+        }
+        if (!(_polled_mask & bit)) {
+            if (wait == 0 || wait > UNREAD_RETRY_MS) wait = UNREAD_RETRY_MS;
+        } else if (wait == 0) {
+            continue;  // Clase estática ya leída
+        }
+        if (now - _last_poll[c] >= wait) {
+            due |= bit;
+        }
+    }
+    return due;
+}
+
 bool DeyeInverter::readAllData(InverterData *data) {
-    data->timestamp = millis();
-    data->data_valid = true;
+    return readClasses(ALL_POLL_MASK, data);
+}
+
+bool DeyeInverter::readClasses(uint8_t poll_mask, InverterData *data) {
+    poll_mask &= ALL_POLL_MASK;
+    followReaderSpan();
+    Clock *clock = _reader->getClock();
+    unsigned long start = clock->micros();
+    bool ok = fetchPlan(_poll_plans[poll_mask]);
+    _cycle_stats.record(clock->micros() - start);
+    if (!ok) {
+        _failed_cycles++;
+    }
+    markPolled(poll_mask, ok);
     
-    // Leer datos en grupos
-    if (!readSolarData(data)) data->data_valid = false;
-    if (!readBatteryData(data)) data->data_valid = false;
-    if (!readGridData(data)) data->data_valid = false;
-    if (!readLoadData(data)) data->data_valid = false;
-    if (!readInverterData(data)) data->data_valid = false;
+    data->timestamp = _reader->getClock()->millis();
+    data->data_valid = ok && _polled_mask == ALL_POLL_MASK;
+    if (ok) {
+        decode(ALL_GROUPS_MASK, poll_mask, data);
+    }
     
-    return data->data_valid;
+    return ok;
 }
 
 bool DeyeInverter::readSolarData(InverterData *data) {
-    uint16_t value;
-    bool is_signed;
-    
-    // PV1 Voltage (0x006D)
-    if (_solarman->readRegister(0x006D, &value)) {
-        data->pv1_voltage = value * 0.1;
-    } else return false;
-    
-    // PV1 Current (0x006E)
-    if (_solarman->readRegister(0x006E, &value)) {
-        data->pv1_current = value * 0.1;
-    } else return false;
-    
-    // PV2 Voltage (0x006F)
-    if (_solarman->readRegister(0x006F, &value)) {
-        data->pv2_voltage = value * 0.1;
-    } else return false;
-    
-    // PV2 Current (0x0070)
-    if (_solarman->readRegister(0x0070, &value)) {
-        data->pv2_current = value * 0.1;
-    } else return false;
-    
-    // PV1 Power (0x00BA)
-    if (_solarman->readRegister(0x00BA, &value)) {
-        data->pv1_power = value;
-    } else return false;
-    
-    // PV2 Power (0x00BB)
-    if (_solarman->readRegister(0x00BB, &value)) {
-        data->pv2_power = value;
-    } else return false;
-    
-    // Daily Production (0x006C)
-    if (_solarman->readRegister(0x006C, &value)) {
-        data->daily_production = value * 0.1;
-    } else return false;
-    
+    if (!fetchPlan(_group_plans[GROUP_SOLAR])) return false;
+    decode(1 << GROUP_SOLAR, ALL_POLL_MASK, data);
     return true;
 }
 
 bool DeyeInverter::readBatteryData(InverterData *data) {
-    uint16_t value;
-    bool is_signed;
-    
-    // Battery Voltage (0x00B7)
-    if (_solarman->readRegister(0x00B7, &value)) {
-        data->battery_voltage = value * 0.01;
-    } else return false;
-    
-    // Battery SOC (0x00B8)
-    if (_solarman->readRegister(0x00B8, &value)) {
-        data->battery_soc = value;
-    } else return false;
-    
-    // Battery Power (0x00BE) - SIGNED
-    if (_solarman->readRegister(0x00BE, &value, &is_signed)) {
-        data->battery_power = applyScaleAndOffset(value, 1.0, 0, true);
-    } else return false;
-    
-    // Battery Current (0x00BF) - SIGNED
-    if (_solarman->readRegister(0x00BF, &value, &is_signed)) {
-        data->battery_current = applyScaleAndOffset(value, 0.01, 0, true);
-    } else return false;
-    
-    // Battery Status (0x00BD)
-    if (_solarman->readRegister(0x00BD, &value)) {
-        data->battery_status = getBatteryStatus(value);
-    } else return false;
-    
-    // Battery Temperature (0x00B6)
-    if (_solarman->readRegister(0x00B6, &value)) {
-        data->battery_temperature = (value * 0.1) - 100.0;
-    } else return false;
-    
+    if (!fetchPlan(_group_plans[GROUP_BATTERY])) return false;
+    decode(1 << GROUP_BATTERY, ALL_POLL_MASK, data);
     return true;
 }
 
 bool DeyeInverter::readGridData(InverterData *data) {
-    uint16_t value;
-    bool is_signed;
-    
-    // Grid Power (0x00A9) - SIGNED
-    if (_solarman->readRegister(0x00A9, &value, &is_signed)) {
-        data->grid_power = applyScaleAndOffset(value, 1.0, 0, true);
-    } else return false;
-    
-    // Grid Voltage L1 (0x0096)
-    if (_solarman->readRegister(0x0096, &value)) {
-        data->grid_voltage_l1 = value * 0.1;
-    } else return false;
-    
-    // Grid Current L1 (0x00A0)
-    if (_solarman->readRegister(0x00A0, &value)) {
-        data->grid_current_l1 = value * 0.01;
-    } else return false;
-    
-    // Grid Frequency (0x004F)
-    if (_solarman->readRegister(0x004F, &value)) {
-        data->grid_frequency = value * 0.01;
-    } else return false;
-    
-    // Daily Energy Bought (0x004C)
-    if (_solarman->readRegister(0x004C, &value)) {
-        data->daily_energy_bought = value * 0.1;
-    } else return false;
-    
-    // Daily Energy Sold (0x004D)
-    if (_solarman->readRegister(0x004D, &value)) {
-        data->daily_energy_sold = value * 0.1;
-    } else return false;
-    
+    if (!fetchPlan(_group_plans[GROUP_GRID])) return false;
+    decode(1 << GROUP_GRID, ALL_POLL_MASK, data);
     return true;
 }
 
 bool DeyeInverter::readLoadData(InverterData *data) {
-    uint16_t value;
-    
-    // Load Power (0x00B2)
-    if (_solarman->readRegister(0x00B2, &value)) {
-        data->load_power = value;
-    } else return false;
-    
-    // Load L1 Power (0x00B0)
-    if (_solarman->readRegister(0x00B0, &value)) {
-        data->load_l1_power = value;
-    } else return false;
+    if (!fetchPlan(_group_plans[GROUP_LOAD])) return false;
+    decode(1 << GROUP_LOAD, ALL_POLL_MASK, data);
+    return true;
+}
+
+bool DeyeInverter::readInverterData(InverterData *data) {
+    if (!fetchPlan(_group_plans[GROUP_INVERTER])) return false;
+    decode(1 << GROUP_INVERTER, ALL_POLL_MASK, data);
+    return true;
+}
+
+bool DeyeInverter::beginReadAll(InverterData *data, InverterDataCallback callback, void *ctx) {
+    return beginReadClasses(ALL_POLL_MASK, data, callback, ctx);
+}
+
+bool DeyeInverter::beginReadClasses(uint8_t poll_mask, InverterData *data, InverterDataCallback callback, void *ctx) {
+    poll_mask &= ALL_POLL_MASK;
+    if (isReading() || poll_mask == 0) {
+        return false;
+    }
+    followReaderSpan();
+    
+    const ReadPlan &plan = _poll_plans[poll_mask];
+    _async_plan = &plan;
+    _async_data = data;
+    _async_callback = callback;
+    _async_ctx = ctx;
+    _async_poll_mask = poll_mask;
+    _async_ok = true;
+    _async_pending = plan.count;
+    _async_started_us = _reader->getClock()->micros();
+    
+    for (size_t i = 0; i < plan.count; i++) {
+        const RegisterBlock *block = &plan.blocks[i];
+        _async_handles[i] = _reader->beginRead(block->start_addr, block->count, &_regs[block->start_addr],
+                                               onBlockRead, this);
+        if (_async_handles[i] < 0) {
+            _async_ok = false;
+            _async_pending--;
+        }
+    }
     
-    // Daily Load Consumption (0x0054)
-    if (_solarman->readRegister(0x0054, &value)) {
-        data->daily_load_consumption = value * 0.1;
-    } else return false;
+    if (_async_pending == 0) {
+        finishAsyncRead();
+    }
+    return true;
+}
+
+void DeyeInverter::poll() {
+    _reader->poll();
+    startRegisterReads();
+}
+
+void DeyeInverter::onBlockRead(int handle, bool ok, void *ctx) {
+    DeyeInverter *self = (DeyeInverter *)ctx;
+    if (!ok) {
+        self->_async_ok = false;
+    } else if (self->_async_plan != nullptr) {
+        for (size_t i = 0; i < self->_async_plan->count; i++) {
+            if (self->_async_handles[i] == handle) {
+                self->storeBlock(self->_async_plan->blocks[i].start_addr, self->_async_plan->blocks[i].count);
+                break;
+            }
+        }
+    }
+    if (self->_async_pending > 0 && --self->_async_pending == 0) {
+        self->finishAsyncRead();
+    }
+}
+
+void DeyeInverter::finishAsyncRead() {
+    InverterData *data = _async_data;
+    _async_data = nullptr;
+    _async_plan = nullptr;
+    
+    _cycle_stats.record(_reader->getClock()->micros() - _async_started_us);
+    if (!_async_ok) {
+        _failed_cycles++;
+    }
+    markPolled(_async_poll_mask, _async_ok);
+    data->timestamp = _reader->getClock()->millis();
+    data->data_valid = _async_ok && _polled_mask == ALL_POLL_MASK;
+    if (_async_ok) {
+        decode(ALL_GROUPS_MASK, _async_poll_mask, data);
+    }
     
+    if (_async_callback) {
+        _async_callback(data, _async_ctx);
+    }
+}
+
+bool DeyeInverter::setPushLayout(const RegisterBlock *blocks, size_t count) {
+    if (count > MAX_PLAN_BLOCKS) {
+        return false;
+    }
+    for (size_t b = 0; b < count; b++) {
+        if ((uint32_t)blocks[b].start_addr + blocks[b].count > REGISTER_MAP_SIZE) {
+            return false;
+        }
+    }
+    memcpy(_push_layout.blocks, blocks, count * sizeof(RegisterBlock));
+    _push_layout.count = count;
     return true;
 }
 
-bool DeyeInverter::readInverterData(InverterData *data) {
-    uint16_t value;
-    bool is_signed;
+bool DeyeInverter::decodePush(const uint8_t *payload, size_t len, InverterData *data) {
+    // Sin disposición no se sabe qué registro es cada palabra de la trama
+    if (_push_layout.count == 0) {
+        return false;
+    }
     
-    // Running Status (0x003B)
-    if (_solarman->readRegister(0x003B, &value)) {
-        data->running_status = getRunningStatus(value);
-    } else return false;
+    // Copiar a la imagen de registros los bloques que quepan en la trama
+    size_t pos = 0;
+    size_t complete = 0;
+    for (size_t b = 0; b < _push_layout.count; b++) {
+        const RegisterBlock &block = _push_layout.blocks[b];
+        if (pos + block.count * 2 > len) {
+            break;
+        }
+        for (uint16_t r = 0; r < block.count; r++) {
+            _regs[block.start_addr + r] = (payload[pos] << 8) | payload[pos + 1];
+            pos += 2;
+        }
+        storeBlock(block.start_addr, block.count);
+        complete++;
+    }
     
-    // Work Mode (0x00F4)
-    if (_solarman->readRegister(0x00F4, &value)) {
-        data->work_mode = getWorkMode(value);
-    } else return false;
+    // Decodificar solo los registros que han venido en la trama
+    for (size_t i = 0; i < _register_count; i++) {
+        const RegisterDescriptor &reg = _registers[i];
+        for (size_t b = 0; b < complete; b++) {
+            const RegisterBlock &block = _push_layout.blocks[b];
+            if (reg.address >= block.start_addr && reg.address + reg.width <= block.start_addr + block.count) {
+                decodeRegister(reg, data);
+                break;
+            }
+        }
+    }
     
-    // Inverter Temperature (0x005A) - DC Temperature
-    if (_solarman->readRegister(0x005A, &value)) {
-        data->inverter_temperature = (value * 0.1) - 100.0;
-    } else return false;
+    bool ok = complete > 0 && complete == _push_layout.count;
+    data->timestamp = _reader->getClock()->millis();
+    data->data_valid = ok || (data->data_valid && complete > 0);
+    return ok;
+}
+
+void DeyeInverter::decode(uint8_t group_mask, uint8_t poll_mask, InverterData *data) {
+    for (size_t i = 0; i < _register_count; i++) {
+        const RegisterDescriptor &reg = _registers[i];
+        if ((group_mask & (1 << reg.group)) && (poll_mask & (1 << reg.poll))) {
+            decodeRegister(reg, data);
+        }
+    }
+}
+
+void DeyeInverter::decodeRegister(const RegisterDescriptor &reg, InverterData *data) {
+    uint8_t *field = (uint8_t *)data + reg.field_offset;
+    uint32_t raw = _regs[reg.address];
+    if (reg.width == 2) {
+        raw |= (uint32_t)_regs[reg.address + 1] << 16;
+    }
+    if (reg.conversion != 0) {
+        convertRegister(reg, raw, field);
+        return;
+    }
     
-    return true;
-}
\ No newline at end of file
+    // Solo se copia el valor bruto: el tipo del campo sabe su escala y su signo
+    if (reg.field_size == 1) {
+        uint8_t code = raw > 0xFF ? UNKNOWN_CODE : raw;
+        memcpy(field, &code, sizeof(code));
+    } else if (reg.field_size == 2) {
+        uint16_t word = raw;
+        memcpy(field, &word, sizeof(word));
+    } else {
+        memcpy(field, &raw, sizeof(raw));
+    }
+}
+
+void DeyeInverter::convertRegister(const RegisterDescriptor &reg, uint32_t raw, uint8_t *field) {
+    const ValueConversion &conv = _conversions[reg.conversion - 1];
+    int64_t value = raw;
+    if (conv.raw_signed) {
+        value = reg.width == 2 ? (int64_t)(int32_t)raw : (int64_t)(int16_t)raw;
+    }
+    
+    if (reg.field_size == 1) {
+        // Enumerado: el código del perfil se traduce al de la tabla de textos
+        uint8_t code = UNKNOWN_CODE;
+        if (conv.lookup_count == 0) {
+            if (value >= 0 && value < UNKNOWN_CODE) code = value;
+        } else if (value >= 0 && value < conv.lookup_count) {
+            code = conv.lookup[value];
+        }
+        memcpy(field, &code, sizeof(code));
+        return;
+    }
+    
+    // Escala con redondeo al entero más cercano y saturación al rango del campo
+    value *= conv.mul;
+    if (conv.div != 1) {
+        value = (value >= 0 ? value + conv.div / 2 : value - conv.div / 2) / conv.div;
+    }
+    value += conv.add;
+    int64_t min_value = conv.field_signed ? -((int64_t)1 << (reg.field_size * 8 - 1)) : 0;
+    int64_t max_value = conv.field_signed ? ((int64_t)1 << (reg.field_size * 8 - 1)) - 1
+                                          : ((int64_t)1 << (reg.field_size * 8)) - 1;
+    if (value < min_value) value = min_value;
+    if (value > max_value) value = max_value;
+    
+    if (reg.field_size == 2) {
+        uint16_t word = (uint16_t)value;
+        memcpy(field, &word, sizeof(word));
+    } else {
+        uint32_t dword = (uint32_t)value;
+        memcpy(field, &dword, sizeof(dword));
+    }
+}
+
+const char *batteryStatusLabel(BatteryStatus code) {
+    return labelFor(BATTERY_STATUS_LABELS, code);
+}
+
+const char *runningStatusLabel(RunningStatus code) {
+    return labelFor(RUNNING_STATUS_LABELS, code);
+}
+
+const char *workModeLabel(WorkMode code) {
+    return labelFor(WORK_MODE_LABELS, code);
+}
+
+const char *deviceTypeLabel(DeviceType code) {
+    return labelFor(DEVICE_TYPE_LABELS, code);
+}
@@ -0,0 +1,173 @@
+#include "InverterSite.h"
+#include <string.h>
+
+InverterSite::InverterSite() {
+    memset(_units, 0, sizeof(_units));
+    _unit_count = 0;
+    _callback = nullptr;
+    _ctx = nullptr;
+    memset(_unit_tickets, 0, sizeof(_unit_tickets));
+    _refresh_ticket = 0;
+    _refresh_done = 0;
+}
+
+InverterSite::~InverterSite() {
+    for (uint8_t i = 0; i < _unit_count; i++) {
+        delete _units[i].refresher;
+    }
+}
+
+int InverterSite::addUnit(DeyeInverter *inverter, const char *name) {
+    if (_unit_count >= MAX_UNITS) {
+        return -1;
+    }
+    Unit *unit = &_units[_unit_count];
+    unit->site = this;
+    unit->index = _unit_count;
+    unit->name = name;
+    unit->inverter = inverter;
+    unit->refresher = new RefreshCoalescer(inverter, &unit->data);
+    unit->refresher->onRefresh(onUnitRead, unit);
+    unit->paused = false;
+    return _unit_count++;
+}
+
+void InverterSite::onUnitRead(InverterData *data, void *ctx) {
+    Unit *unit = (Unit *)ctx;
+    InverterSite *site = unit->site;
+    if (site->_callback) {
+        site->_callback(unit->index, data, site->_ctx);
+    }
+}
+
+void InverterSite::poll() {
+    for (uint8_t i = 0; i < _unit_count; i++) {
+        Unit *unit = &_units[i];
+        unit->refresher->poll();
+        
+        // Con el lector en pausa (breaker abierto) se espera a su próximo intento
+        DeyeInverter *inverter = unit->inverter;
+        if (unit->paused || inverter->isReading() || unit->refresher->isBusy() ||
+            inverter->getReader()->getNextProbeIn() > 0) {
+            continue;
+        }
+        uint8_t due = inverter->getDueClasses();
+        if (due) {
+            inverter->beginReadClasses(due, &unit->data, onUnitRead, unit);
+        }
+    }
+    updateRefresh();
+}
+
+uint32_t InverterSite::requestRefresh(uint32_t max_staleness_ms, RefreshCoalescer::RefreshSource *sources) {
+    bool idle = _refresh_done == _refresh_ticket;
+    bool started = false;
+    for (uint8_t i = 0; i < _unit_count; i++) {
+        RefreshCoalescer *refresher = _units[i].refresher;
+        uint32_t ticket = refresher->request(max_staleness_ms, sources ? &sources[i] : nullptr);
+        // Un inversor que se une a su barrido en curso no cambia lo que hay que esperar
+        if (idle || (int32_t)(ticket - _unit_tickets[i]) > 0) {
+            _unit_tickets[i] = ticket;
+            started = started || !refresher->isDone(ticket);
+        }
+    }
+    if (started) {
+        _refresh_ticket++;
+    }
+    return _refresh_ticket;
+}
+
+void InverterSite::updateRefresh() {
+    if (_refresh_done == _refresh_ticket) {
+        return;
+    }
+    for (uint8_t i = 0; i < _unit_count; i++) {
+        if (!_units[i].refresher->isDone(_unit_tickets[i])) {
+            return;
+        }
+    }
+    _refresh_done = _refresh_ticket;
+}
+
+bool InverterSite::refreshAll(uint32_t max_staleness_ms, RefreshCoalescer::RefreshSource *sources) {
+    uint32_t ticket = requestRefresh(max_staleness_ms, sources);
+    while (!isRefreshDone(ticket)) {
+        // Se avanzan todos: los demás inversores siguen leyendo mientras se espera al más lento
+        poll();
+        _units[0].inverter->getClock()->delay(1);
+    }
+    
+    bool all_valid = true;
+    for (uint8_t i = 0; i < _unit_count; i++) {
+        all_valid = all_valid && _units[i].data.data_valid;
+    }
+    return all_valid;
+}
+
+bool InverterSite::decodePush(uint8_t unit, const uint8_t *payload, size_t len) {
+    if (unit >= _unit_count || !_units[unit].inverter->decodePush(payload, len, &_units[unit].data)) {
+        return false;
+    }
+    onUnitRead(&_units[unit].data, &_units[unit]);
+    return true;
+}
+
+bool InverterSite::isBusy() {
+    for (uint8_t i = 0; i < _unit_count; i++) {
+        if (_units[i].inverter->isReading() || _units[i].refresher->isBusy()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void InverterSite::getSiteData(SiteData *site) {
+    const InverterData *units[MAX_UNITS];
+    for (uint8_t i = 0; i < _unit_count; i++) {
+        units[i] = &_units[i].data;
+    }
+    sum(units, _unit_count, site);
+}
+
+void InverterSite::sum(const InverterData *const *units, uint8_t count, SiteData *site) {
+    memset(site, 0, sizeof(SiteData));
+    site->unit_count = count;
+    site->battery_temperature = -100;
+    site->inverter_temperature = -100;
+    
+    float soc_sum = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        const InverterData &data = *units[i];
+        if (!data.data_valid) {
+            continue;
+        }
+        if (site->units_valid == 0 || (long)(data.timestamp - site->timestamp) < 0) {
+            site->timestamp = data.timestamp;
+        }
+        site->units_valid++;
+        site->pv1_power += data.pv1_power.raw;
+        site->pv2_power += data.pv2_power.raw;
+        site->grid_power += data.grid_power.raw;
+        site->load_power += data.load_power.raw;
+        site->battery_power += data.battery_power.raw;
+        soc_sum += data.battery_soc.value();
+        if (data.battery_temperature.value() > site->battery_temperature) {
+            site->battery_temperature = data.battery_temperature.value();
+        }
+        if (data.inverter_temperature.value() > site->inverter_temperature) {
+            site->inverter_temperature = data.inverter_temperature.value();
+        }
+        site->daily_production += data.daily_production.value();
+        site->daily_energy_bought += data.daily_energy_bought.value();
+        site->daily_energy_sold += data.daily_energy_sold.value();
+        site->daily_load_consumption += data.daily_load_consumption.value();
+    }
+    site->solar_power = site->pv1_power + site->pv2_power;
+    if (site->units_valid > 0) {
+        site->battery_soc = soc_sum / site->units_valid;
+    } else {
+        site->battery_temperature = 0;
+        site->inverter_temperature = 0;
+    }
+    site->data_valid = count > 0 && site->units_valid == count;
+}
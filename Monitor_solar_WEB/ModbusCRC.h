@@ -0,0 +1,59 @@
+#ifndef MODBUSCRC_H
+#define MODBUSCRC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Por defecto la tabla del CRC queda en flash junto al resto de constantes.
+// Definir MODBUS_CRC_TABLE_IN_RAM para copiarla a DRAM y evitar fallos de
+// caché de flash en el bucle (cuesta 512 bytes de RAM).
+// #define MODBUS_CRC_TABLE_IN_RAM
+
+class ModbusCRC {
+public:
+    /**
+     * @brief Calcula el CRC16/Modbus usando una tabla de 256 entradas
+     * 
+     * @param data Datos sobre los que calcular el CRC
+     * @param length Número de bytes
+     * @return uint16_t CRC (se transmite en little-endian)
+     */
+    static uint16_t compute(const uint8_t *data, size_t length);
+    
+    /**
+     * @brief Calcula el CRC16/Modbus bit a bit (implementación de referencia)
+     * 
+     * @param data Datos sobre los que calcular el CRC
+     * @param length Número de bytes
+     * @return uint16_t CRC
+     */
+    static uint16_t computeBitwise(const uint8_t *data, size_t length);
+    
+    /**
+     * @brief Calcula la suma de comprobación V5 (suma de bytes módulo 256)
+     * 
+     * @param data Datos a sumar
+     * @param length Número de bytes
+     * @return uint8_t Suma
+     */
+    static uint8_t sum(const uint8_t *data, size_t length);
+    
+    /**
+     * @brief Calcula en una sola pasada la suma V5 y el CRC Modbus
+     * 
+     * Suma todos los bytes de data[0..length) y, a la vez, calcula el CRC
+     * de la trama Modbus contenida en data[crc_start..crc_end). SolarmanV5
+     * la usa al construir cada petición y al validar cada respuesta.
+     * 
+     * @param data Datos a recorrer
+     * @param length Número de bytes a sumar
+     * @param crc_start Primer byte de la trama Modbus
+     * @param crc_end Fin (exclusivo) de la trama Modbus, <= length
+     * @param checksum Puntero donde se almacenará la suma V5
+     * @return uint16_t CRC de la trama Modbus
+     */
+    static uint16_t computeWithSum(const uint8_t *data, size_t length,
+                                   size_t crc_start, size_t crc_end, uint8_t *checksum);
+};
+
+#endif
@@ -0,0 +1,521 @@
+#include "ModbusTCP.h"
+#include <string.h>
+
+ModbusTCP::ModbusTCP(const char *host, uint8_t unit_id, uint16_t port) {
+    _host = host;
+    _port = port;
+    _unit_id = unit_id;
+    _transaction_id = 1;
+    _pipeline_depth = DEFAULT_PIPELINE_DEPTH;
+    _response_timeout_ms = DEFAULT_RESPONSE_TIMEOUT_MS;
+    _transport = createDefaultTransport();
+    _clock = defaultClock();
+    _owns_transport = true;
+    _connect_count = 0;
+    _transaction_count = 0;
+    _timeout_count = 0;
+    _last_frame_error = SOLARMAN_FRAME_OK;
+    _last_exception = 0;
+    _connect_started_us = 0;
+    _frame_start_us = 0;
+    
+    memset(_ops, 0, sizeof(_ops));
+    _next_handle = 0;
+    _async_state = ASYNC_IDLE;
+    _async_timer = 0;
+    _rx_len = 0;
+}
+
+ModbusTCP::~ModbusTCP() {
+    disconnect();
+    if (_owns_transport) {
+        delete _transport;
+    }
+}
+
+void ModbusTCP::setTransport(Transport *transport, Clock *clock) {
+    disconnect();
+    if (_owns_transport) {
+        delete _transport;
+    }
+    _transport = transport;
+    _owns_transport = false;
+    if (clock != nullptr) {
+        _clock = clock;
+    }
+}
+
+void ModbusTCP::disconnect() {
+    _transport->stop();
+    failOps(OP_SENT);
+    _async_state = ASYNC_IDLE;
+    _rx_len = 0;
+}
+
+size_t ModbusTCP::buildRequest(uint8_t *frame, uint16_t start_addr, uint16_t count) {
+    uint16_t tid = _transaction_id++;
+    frame[0] = tid >> 8;
+    frame[1] = tid & 0xFF;
+    frame[2] = 0x00;                // Protocolo: Modbus
+    frame[3] = 0x00;
+    frame[4] = 0x00;                // Longitud: unit ID + PDU
+    frame[5] = 6;
+    frame[6] = _unit_id;
+    frame[7] = 0x03;                // Función: Read Holding Registers
+    frame[8] = start_addr >> 8;
+    frame[9] = start_addr & 0xFF;
+    frame[10] = count >> 8;
+    frame[11] = count & 0xFF;
+    _transaction_count++;
+    _stats.requests++;
+    return 12;
+}
+
+bool ModbusTCP::ensureConnected() {
+    if (_transport->connected()) {
+        // Descartar respuestas de transacciones anteriores que llegaron tarde
+        discardInput();
+        _rx_len = 0;
+        return true;
+    }
+    _transport->stop();
+    _rx_len = 0;
+    unsigned long start = _clock->micros();
+    if (!_transport->connect(_host, _port, CONNECT_TIMEOUT_MS)) {
+        return false;
+    }
+    _stats.connect.record(_clock->micros() - start);
+    _connect_count++;
+    return true;
+}
+
+bool ModbusTCP::writeRequest(const uint8_t *request, size_t len) {
+    size_t sent = _transport->write(request, len);
+    _stats.bytes_sent += sent;
+    return sent == len;
+}
+
+void ModbusTCP::recordTransaction(unsigned long sent_us) {
+    unsigned long now = _clock->micros();
+    _stats.first_byte.record(_frame_start_us - sent_us);
+    _stats.transaction.record(now - sent_us);
+}
+
+void ModbusTCP::discardInput() {
+    uint8_t scratch[32];
+    while (_transport->available() > 0 && _transport->read(scratch, sizeof(scratch)) > 0) {
+    }
+}
+
+int ModbusTCP::receiveFrame() {
+    while (_transport->available() > 0) {
+        size_t wanted;
+        if (_rx_len < MBAP_HEADER_LEN) {
+            wanted = MBAP_HEADER_LEN - _rx_len;
+        } else {
+            wanted = 6 + ((_rx_buffer[4] << 8) | _rx_buffer[5]) - _rx_len;
+        }
+        int n = _transport->read(&_rx_buffer[_rx_len], wanted);
+        if (n <= 0) {
+            break;
+        }
+        if (_rx_len == 0) {
+            _frame_start_us = _clock->micros();
+        }
+        _rx_len += n;
+        _async_timer = _clock->millis();
+        
+        if (_rx_len == MBAP_HEADER_LEN) {
+            // La longitud cuenta el unit ID y la PDU: al menos función + un byte
+            size_t length = (_rx_buffer[4] << 8) | _rx_buffer[5];
+            if (_rx_buffer[2] != 0 || _rx_buffer[3] != 0 || length < 3 || 6 + length > MAX_RESPONSE_LEN) {
+                _last_frame_error = (_rx_buffer[2] != 0 || _rx_buffer[3] != 0) ? SOLARMAN_FRAME_BAD_START
+                                                                               : SOLARMAN_FRAME_BAD_LENGTH;
+                return -1;
+            }
+            continue;
+        }
+        if (_rx_len < MBAP_HEADER_LEN || (size_t)n < wanted) {
+            continue;
+        }
+        
+        // Trama completa
+        size_t frame_len = _rx_len;
+        _rx_len = 0;
+        _stats.bytes_received += frame_len;
+        return frame_len;
+    }
+    return 0;
+}
+
+bool ModbusTCP::waitFrame(size_t *frame_len) {
+    _async_timer = _clock->millis();
+    while (true) {
+        int res = receiveFrame();
+        if (res > 0) {
+            *frame_len = res;
+            return true;
+        }
+        if (res < 0) {
+            return false;
+        }
+        if (!_transport->connected() && !_transport->available()) {
+            return false;
+        }
+        if (_clock->millis() - _async_timer > _response_timeout_ms) {
+            _timeout_count++;
+            _stats.timeouts++;
+            return false;
+        }
+        _clock->delay(1);
+    }
+}
+
+bool ModbusTCP::parseResponse(const uint8_t *response, size_t len, uint16_t *values, uint16_t count) {
+    _last_exception = 0;
+    _last_frame_error = SOLARMAN_FRAME_OK;
+    if (response[6] != _unit_id) {
+        _last_frame_error = SOLARMAN_FRAME_BAD_SLAVE;
+        return false;
+    }
+    
+    // Excepción: función | 0x80 + código
+    if (response[7] == 0x83) {
+        _last_exception = response[8];
+        _last_frame_error = SOLARMAN_FRAME_EXCEPTION;
+        return false;
+    }
+    if (response[7] != 0x03) {
+        _last_frame_error = SOLARMAN_FRAME_BAD_FUNCTION;
+        return false;
+    }
+    
+    size_t data_bytes = (size_t)count * 2;
+    if (response[8] != data_bytes || len != MBAP_HEADER_LEN + 2 + data_bytes) {
+        _last_frame_error = SOLARMAN_FRAME_BAD_LENGTH;
+        return false;
+    }
+    for (uint16_t r = 0; r < count; r++) {
+        values[r] = (response[9 + r * 2] << 8) | response[10 + r * 2];
+    }
+    return true;
+}
+
+bool ModbusTCP::readHoldingRegisters(uint16_t start_addr, uint16_t count, uint16_t *values) {
+    if (count == 0 || count > MAX_REGISTERS_PER_READ || isBusy()) {
+        return false;
+    }
+    
+    // Una conexión reutilizada puede estar medio abierta: si no responde se
+    // reconecta una vez y se reintenta
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = _transport->connected();
+        if (attempt > 0) {
+            _stats.retries++;
+        }
+        if (!ensureConnected()) {
+            return false;
+        }
+        uint8_t request[12];
+        size_t request_len = buildRequest(request, start_addr, count);
+        if (writeRequest(request, request_len)) {
+            unsigned long sent_us = _clock->micros();
+            // Descartar respuestas de otras transacciones hasta encontrar la nuestra
+            size_t frame_len;
+            for (int frames = 0; frames < MAX_PIPELINE_DEPTH + 1 && waitFrame(&frame_len); frames++) {
+                if (_rx_buffer[0] == request[0] && _rx_buffer[1] == request[1]) {
+                    recordTransaction(sent_us);
+                    return parseResponse(_rx_buffer, frame_len, values, count);
+                }
+            }
+        }
+        _transport->stop();
+        _rx_len = 0;
+        if (!reused) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool ModbusTCP::readPipelined(SolarmanReadRequest *requests, size_t n) {
+    struct InFlight {
+        uint16_t tid;
+        size_t index;
+        unsigned long sent_us;
+        bool active;
+    };
+    InFlight inflight[MAX_PIPELINE_DEPTH] = {};
+    
+    for (size_t i = 0; i < n; i++) {
+        requests[i].ok = false;
+    }
+    if (isBusy() || !ensureConnected()) {
+        return false;
+    }
+    
+    uint8_t request[12];
+    size_t next = 0;
+    size_t pending = 0;
+    bool stream_ok = true;
+    
+    while (stream_ok && (next < n || pending > 0)) {
+        // Llenar la ventana de transacciones en vuelo
+        while (pending < _pipeline_depth && next < n) {
+            SolarmanReadRequest *req = &requests[next];
+            if (req->count == 0 || req->count > MAX_REGISTERS_PER_READ) {
+                next++;
+                continue;
+            }
+            size_t request_len = buildRequest(request, req->start_addr, req->count);
+            if (!writeRequest(request, request_len)) {
+                stream_ok = false;
+                break;
+            }
+            for (uint8_t k = 0; k < MAX_PIPELINE_DEPTH; k++) {
+                if (!inflight[k].active) {
+                    inflight[k].tid = (request[0] << 8) | request[1];
+                    inflight[k].index = next;
+                    inflight[k].sent_us = _clock->micros();
+                    inflight[k].active = true;
+                    break;
+                }
+            }
+            pending++;
+            next++;
+        }
+        if (!stream_ok || pending == 0) break;
+        
+        size_t frame_len;
+        if (!waitFrame(&frame_len)) {
+            stream_ok = false;
+            break;
+        }
+        
+        // Asociar la respuesta a su petición por el transaction ID
+        uint16_t tid = (_rx_buffer[0] << 8) | _rx_buffer[1];
+        int slot = -1;
+        for (uint8_t k = 0; k < MAX_PIPELINE_DEPTH; k++) {
+            if (inflight[k].active && inflight[k].tid == tid) {
+                slot = k;
+                break;
+            }
+        }
+        if (slot < 0) {
+            continue; // Respuesta obsoleta o duplicada
+        }
+        
+        inflight[slot].active = false;
+        pending--;
+        recordTransaction(inflight[slot].sent_us);
+        SolarmanReadRequest *req = &requests[inflight[slot].index];
+        req->ok = parseResponse(_rx_buffer, frame_len, req->values, req->count);
+    }
+    
+    if (!stream_ok) {
+        _transport->stop();
+        _rx_len = 0;
+    }
+    
+    // Reintentar de uno en uno lo que no llegó; si la pasarela deja de
+    // responder no tiene sentido seguir esperando timeouts
+    bool all_ok = true;
+    bool retry = true;
+    for (size_t i = 0; i < n; i++) {
+        if (!requests[i].ok && retry) {
+            _stats.retries++;
+            requests[i].ok = readHoldingRegisters(requests[i].start_addr, requests[i].count, requests[i].values);
+            retry = requests[i].ok;
+        }
+        all_ok = all_ok && requests[i].ok;
+    }
+    return all_ok;
+}
+
+// ============================================================================
+// LECTURA ASÍNCRONA
+// ============================================================================
+
+void ModbusTCP::completeOp(AsyncOp *op, bool ok) {
+    op->status = ok ? OP_DONE : OP_FAILED;
+    if (op->callback) {
+        op->callback(op->handle, ok, op->ctx);
+    }
+}
+
+void ModbusTCP::failOps(uint8_t status) {
+    for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+        if (_ops[i].status == status) {
+            completeOp(&_ops[i], false);
+        }
+    }
+}
+
+int ModbusTCP::beginRead(uint16_t start_addr, uint16_t count, uint16_t *values,
+                         SolarmanReadCallback callback, void *ctx) {
+    if (count == 0 || count > MAX_REGISTERS_PER_READ || values == nullptr) {
+        return -1;
+    }
+    
+    for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+        AsyncOp *op = &_ops[i];
+        if (op->status == OP_QUEUED || op->status == OP_SENT) {
+            continue;
+        }
+        op->handle = _next_handle;
+        _next_handle = (_next_handle + 1) & 0x7FFFFFFF;
+        op->start_addr = start_addr;
+        op->count = count;
+        op->values = values;
+        op->callback = callback;
+        op->ctx = ctx;
+        op->status = OP_QUEUED;
+        return op->handle;
+    }
+    return -1;
+}
+
+SolarmanReadStatus ModbusTCP::getReadStatus(int handle) {
+    for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+        if (_ops[i].status != OP_FREE && _ops[i].handle == handle) {
+            switch (_ops[i].status) {
+                case OP_DONE: return SOLARMAN_READ_DONE;
+                case OP_FAILED: return SOLARMAN_READ_FAILED;
+                default: return SOLARMAN_READ_PENDING;
+            }
+        }
+    }
+    return SOLARMAN_READ_UNKNOWN;
+}
+
+bool ModbusTCP::isBusy() {
+    if (_async_state == ASYNC_CONNECTING) {
+        return true;
+    }
+    for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+        if (_ops[i].status == OP_QUEUED || _ops[i].status == OP_SENT) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ModbusTCP::poll() {
+    switch (_async_state) {
+        case ASYNC_IDLE: {
+            bool queued = false;
+            for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+                if (_ops[i].status == OP_QUEUED) queued = true;
+            }
+            if (!queued) {
+                return;
+            }
+            if (_transport->connected()) {
+                discardInput();
+                _rx_len = 0;
+                _async_state = ASYNC_READY;
+                break;
+            }
+            _connect_started_us = _clock->micros();
+            if (!_transport->startConnect(_host, _port)) {
+                failOps(OP_QUEUED);
+                return;
+            }
+            _async_state = ASYNC_CONNECTING;
+            _async_timer = _clock->millis();
+            return;
+        }
+        
+        case ASYNC_CONNECTING: {
+            int res = _transport->checkConnect();
+            if (res == 0 && _clock->millis() - _async_timer > CONNECT_TIMEOUT_MS) {
+                _transport->stop();
+                res = -1;
+            }
+            if (res == 0) {
+                return;
+            }
+            if (res < 0) {
+                _async_state = ASYNC_IDLE;
+                failOps(OP_QUEUED);
+                return;
+            }
+            _stats.connect.record(_clock->micros() - _connect_started_us);
+            _connect_count++;
+            _rx_len = 0;
+            _async_state = ASYNC_READY;
+            break;
+        }
+        
+        case ASYNC_READY:
+            break;
+    }
+    
+    pumpAsync();
+}
+
+void ModbusTCP::pumpAsync() {
+    if (!_transport->connected() && !_transport->available()) {
+        // La pasarela cerró la conexión: se reabrirá para lo que quede en cola
+        disconnect();
+        return;
+    }
+    
+    // Enviar lo que haya en cola respetando la profundidad del pipeline
+    uint8_t in_flight = 0;
+    for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+        if (_ops[i].status == OP_SENT) in_flight++;
+    }
+    for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE && in_flight < _pipeline_depth; i++) {
+        AsyncOp *op = &_ops[i];
+        if (op->status != OP_QUEUED) {
+            continue;
+        }
+        uint8_t request[12];
+        size_t request_len = buildRequest(request, op->start_addr, op->count);
+        if (!writeRequest(request, request_len)) {
+            disconnect();
+            return;
+        }
+        op->sent_us = _clock->micros();
+        op->tid = (request[0] << 8) | request[1];
+        op->status = OP_SENT;
+        if (in_flight == 0) {
+            _async_timer = _clock->millis();
+        }
+        in_flight++;
+    }
+    if (in_flight == 0) {
+        return;
+    }
+    
+    // Recibir lo que haya disponible sin esperar
+    int frame_len;
+    while ((frame_len = receiveFrame()) > 0) {
+        uint16_t tid = (_rx_buffer[0] << 8) | _rx_buffer[1];
+        for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+            AsyncOp *op = &_ops[i];
+            if (op->status == OP_SENT && op->tid == tid) {
+                recordTransaction(op->sent_us);
+                completeOp(op, parseResponse(_rx_buffer, frame_len, op->values, op->count));
+                break;
+            }
+        }
+        // Si no coincide con ninguna transacción es obsoleta o duplicada: se descarta
+    }
+    
+    if (frame_len == 0) {
+        bool waiting = false;
+        for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+            if (_ops[i].status == OP_SENT) waiting = true;
+        }
+        if (!waiting || _clock->millis() - _async_timer <= _response_timeout_ms) {
+            return;
+        }
+        _timeout_count++;
+        _stats.timeouts++;
+    }
+    
+    // Trama corrupta o la pasarela dejó de responder
+    disconnect();
+}
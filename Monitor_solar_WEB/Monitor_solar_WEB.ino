@@ -3,21 +3,66 @@
 #include <time.h>
 #include <WebServer.h>
 #include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <Preferences.h>
 #include "SolarmanV5.h"
+#include "SolarmanServer.h"
+#include "ModbusRTU.h"
+#include "ModbusTCP.h"
+#include "HardwareSerialPort.h"
 #include "DeyeInverter.h"
+#include "InverterSite.h"
+#include "InverterProfile.h"
 
 // CONFIGURACIÓN
 const char* ssid = "wifissid"; // SSID de la wifi
 const char* password = "wifipass"; // Pass de la wifi
-const unsigned long update_interval = 10; // Frecuencia de actualizacion en segundos
-const char* datalogger_ip = "192.168.1.10"; // IP del datalogger Solarman
-uint32_t datalogger_sn = 1234567890; // Número de serie del Solarman
+const unsigned long update_interval = 2; // Frecuencia de lectura de potencias en segundos (por RS485 admite 1)
+// Un datalogger Solarman por inversor; con varios, /data devuelve la suma de la instalación
+struct DataloggerConfig {
+  const char* ip; // IP del datalogger (un nombre se resuelve una sola vez, al conectar en setup())
+  uint32_t sn; // Número de serie del datalogger
+};
+const DataloggerConfig dataloggers[] = {
+  {"192.168.1.10", 1234567890},
+  // {"192.168.1.11", 1234567891}, // Segundo inversor (hasta 4)
+};
+const uint8_t datalogger_count = sizeof(dataloggers) / sizeof(dataloggers[0]);
+const uint8_t pipeline_depth = 3; // Peticiones simultáneas al datalogger (1 si el datalogger se atasca)
+const uint32_t keepalive_ms = 5000; // Heartbeat al datalogger si la conexión lleva este tiempo ociosa (0 = no)
+const uint16_t push_port = 0; // Puerto donde recibir los datos que envía el primer datalogger ("Server B" en su web; 0 = no)
+const unsigned long push_fresh_ms = 600000; // Mientras lleguen datos del datalogger con este margen no se le pregunta
+// Bloques de registros de las tramas que envía el datalogger, en su orden. Dependen de su firmware
+// (push_listen ayuda a averiguarlos); sin ellos las tramas no se decodifican y se le sigue preguntando
+const RegisterBlock push_layout[MAX_PLAN_BLOCKS] = {}; // p.ej. {{0x0003, 5}, {0x003B, 22}, ...}
+const size_t push_layout_count = 0; // Bloques usados de push_layout
+const int8_t rs485_rx_pin = -1; // RX del transceptor RS485 en el puerto Modbus del inversor (-1 = leer a través del datalogger)
+const int8_t rs485_tx_pin = -1; // TX del transceptor RS485
+const int8_t rs485_de_pin = -1; // DE/RE del transceptor (-1 = módulo con conmutación automática)
+const uint32_t rs485_baud = 9600; // Velocidad del puerto Modbus del inversor
+const char* modbus_tcp_host = ""; // IP de una pasarela Modbus TCP (RS485-Ethernet) en lugar del datalogger ("" = no; un nombre se resuelve una sola vez)
+const uint16_t modbus_tcp_port = 502; // Puerto de la pasarela Modbus TCP
+const uint8_t modbus_tcp_depth = 4; // Transacciones simultáneas a la pasarela
+const uint32_t update_max_age_ms = 1000; // /update sirve la última lectura si tiene menos de esto (se puede cambiar con ?max_age=MS)
+const uint32_t register_max_age_ms = 90000; // /registers contesta de la caché los registros leídos hace menos de esto (?max_age=MS)
+const unsigned long stats_report_interval = 300; // Resumen de tiempos de las peticiones por el puerto serie en segundos (0 = no)
+const char* profile_path = "/profile.yaml"; // Perfil de registros en LittleFS para otros inversores (ver profiles/; sin fichero, los de Deye)
 
 // === WEB
 WebServer server(80);
-SolarmanV5 *solarman = nullptr;
-DeyeInverter *inverter = nullptr;
-InverterData inv_data;
+SolarmanV5 *solarmans[InverterSite::MAX_UNITS] = {};
+HardwareSerialPort *rs485_port = nullptr;
+ModbusRTU *rtu = nullptr;
+ModbusTCP *gateway = nullptr;
+DeyeInverter *inverters[InverterSite::MAX_UNITS] = {};
+InverterSite *site = nullptr;
+SolarmanServer *push_server = nullptr;
+InverterProfile profile;
+bool profile_loaded = false;
+unsigned long last_push_decoded = 0; // millis() de la última trama del datalogger decodificada entera
+bool push_decoded = false;
+uint32_t saved_spans[InverterSite::MAX_UNITS] = {}; // Tamaño de petición guardado de cada datalogger (ver saveRequestSpan)
+unsigned long last_stats_report = 0;
 
 void connectWiFi() {
   WiFi.setHostname("monitor_solar");
@@ -38,60 +83,257 @@ void connectWiFi() {
   }
 }
 
+// Perfil de registros guardado en LittleFS; se compila una vez y sirve para todos los inversores
+void loadInverterProfile() {
+  if (!LittleFS.begin(false) || !LittleFS.exists(profile_path)) {
+    Serial.println("📄 Sin perfil en LittleFS: registros integrados (Deye híbrido)");
+    return;
+  }
+  File file = LittleFS.open(profile_path, "r");
+  size_t len = file.size();
+  char *text = new char[len > 0 ? len : 1];
+  len = file.read((uint8_t *)text, len);
+  file.close();
+  profile_loaded = profile.compile(text, len);
+  delete[] text;
+  if (profile_loaded) {
+    Serial.printf("📄 Perfil \"%s\": %u registros (%u con conversión, %u ignorados)\n", profile.getName(),
+                  (unsigned)profile.getRegisterCount(), (unsigned)profile.getConversionCount(), profile.getSkippedCount());
+  } else {
+    Serial.printf("⚠️ %s:%d: %s; se usan los registros integrados\n", profile_path, profile.getErrorLine(),
+                  profileErrorLabel(profile.getError()));
+  }
+}
+
+// Tamaño de petición aprendido de cada datalogger, en Preferences ("solar") con su SN en la clave:
+// la mayor petición contestada entera en los 16 bits bajos y la menor rechazada en los altos
+void requestSpanKey(uint8_t unit, char *key, size_t key_size) {
+  char sn_hex[9];
+  solarmans[unit]->getDataloggerSNHex(sn_hex);
+  snprintf(key, key_size, "span%s", sn_hex);
+}
+
+void restoreRequestSpan(uint8_t unit) {
+  char key[16];
+  requestSpanKey(unit, key, sizeof(key));
+  Preferences prefs;
+  prefs.begin("solar", true);
+  saved_spans[unit] = prefs.getUInt(key, 0);
+  prefs.end();
+  if (saved_spans[unit]) {
+    solarmans[unit]->restoreSpan(saved_spans[unit] & 0xFFFF, saved_spans[unit] >> 16);
+    Serial.printf("📏 Datalogger %u: peticiones de hasta %u registros\n", unit, solarmans[unit]->getMaxSpan());
+  }
+}
+
+// Solo se escribe cuando cambia, y cambia pocas veces: la mayor petición buena solo sube y la menor rechazada solo baja
+void saveRequestSpan(uint8_t unit) {
+  SolarmanV5 *solarman = solarmans[unit];
+  uint32_t value = ((uint32_t)solarman->getSmallestBadSpan() << 16) | solarman->getLargestGoodSpan();
+  if (value == saved_spans[unit]) return;
+  if ((value >> 16) != (saved_spans[unit] >> 16)) {
+    Serial.printf("📏 Datalogger %u: rechaza peticiones de %u registros, se usan hasta %u\n", unit,
+                  (unsigned)(value >> 16), solarman->getMaxSpan());
+  }
+  char key[16];
+  requestSpanKey(unit, key, sizeof(key));
+  Preferences prefs;
+  prefs.begin("solar", false);
+  prefs.putUInt(key, value);
+  prefs.end();
+  saved_spans[unit] = value;
+}
+
 void initializeInverter() {
-  if (solarman) delete solarman;
-  if (inverter) delete inverter;
-  solarman = new SolarmanV5(datalogger_ip, datalogger_sn);
-  inverter = new DeyeInverter(solarman);
-  solarman->begin();
+  if (site) delete site;
+  for (uint8_t i = 0; i < InverterSite::MAX_UNITS; i++) {
+    if (inverters[i]) delete inverters[i];
+    if (solarmans[i]) delete solarmans[i];
+    inverters[i] = nullptr;
+    solarmans[i] = nullptr;
+  }
+  if (rtu) delete rtu;
+  if (rs485_port) delete rs485_port;
+  if (gateway) delete gateway;
+  rtu = nullptr;
+  rs485_port = nullptr;
+  gateway = nullptr;
+  site = new InverterSite();
+  site->onRead(onUnitRead);
+  if (rs485_rx_pin >= 0) {
+    // Modbus RTU directo por RS485: sin datalogger de por medio
+    rs485_port = new HardwareSerialPort(&Serial2, rs485_rx_pin, rs485_tx_pin, rs485_de_pin);
+    rtu = new ModbusRTU(rs485_port, 1, rs485_baud);
+    rtu->begin();
+    inverters[0] = new DeyeInverter(rtu);
+    site->addUnit(inverters[0], "rs485");
+  } else if (modbus_tcp_host[0]) {
+    // Pasarela Modbus TCP: varias transacciones en vuelo sobre una conexión
+    gateway = new ModbusTCP(modbus_tcp_host, 1, modbus_tcp_port);
+    gateway->setPipelineDepth(modbus_tcp_depth);
+    inverters[0] = new DeyeInverter(gateway);
+    site->addUnit(inverters[0], modbus_tcp_host);
+  } else {
+    // Un SolarmanV5 por datalogger: cada uno con su conexión y su circuit breaker
+    for (uint8_t i = 0; i < datalogger_count && i < InverterSite::MAX_UNITS; i++) {
+      solarmans[i] = new SolarmanV5(dataloggers[i].ip, dataloggers[i].sn);
+      solarmans[i]->setPipelineDepth(pipeline_depth);
+      solarmans[i]->setKeepAlive(keepalive_ms);
+      solarmans[i]->begin();
+      restoreRequestSpan(i);
+      inverters[i] = new DeyeInverter(solarmans[i]);
+      site->addUnit(inverters[i], dataloggers[i].ip);
+    }
+  }
+  for (uint8_t i = 0; i < site->getUnitCount(); i++) {
+    if (profile_loaded && !inverters[i]->setProfile(&profile)) {
+      Serial.printf("⚠️ El perfil necesita más de %u peticiones; inversor %u con los registros integrados\n",
+                    (unsigned)MAX_PLAN_BLOCKS, i);
+    }
+    inverters[i]->setPollPeriod(POLL_LIVE, update_interval * 1000);
+  }
   Serial.println("🔌 Comunicación con inversor inicializada");
-  Serial.printf("   IP: %s\n", datalogger_ip);
-  Serial.printf("   SN: %lu\n", datalogger_sn);
+  if (rtu) {
+    Serial.printf("   RS485: %lu baudios (t3.5 = %lu ms)\n", (unsigned long)rs485_baud, (unsigned long)rtu->getSilenceMs());
+  } else if (gateway) {
+    Serial.printf("   Modbus TCP: %s:%u\n", modbus_tcp_host, modbus_tcp_port);
+  } else {
+    for (uint8_t i = 0; i < site->getUnitCount(); i++) {
+      Serial.printf("   Inversor %u: IP %s, SN %lu\n", i, dataloggers[i].ip, (unsigned long)dataloggers[i].sn);
+    }
+  }
+  Serial.printf("   Plan de lectura: %u peticiones\n", (unsigned)inverters[0]->getReadPlan().count);
 }
 
-void readInverterData() {
-  Serial.println("\n🔄 Actualizando datos del inversor...");
-  if (inverter && inverter->readAllData(&inv_data)) {
-    Serial.println("✅ Datos leídos correctamente");
-    printInverterData();
+const char *activeReaderName() {
+  if (rtu) return "rs485";
+  if (gateway) return "modbus_tcp";
+  return "solarman";
+}
+
+void printRequestStats(uint8_t unit) {
+  DeyeInverter *inverter = site->getInverter(unit);
+  RequestStats &stats = inverter->getReader()->getStats();
+  LatencyHistogram &cycles = inverter->getCycleStats();
+  Serial.printf("📊 Peticiones (%s, %s): %lu, %lu reintentos, %lu timeouts, %lu errores de CRC\n", activeReaderName(),
+                site->getName(unit), (unsigned long)stats.requests, (unsigned long)stats.retries,
+                (unsigned long)stats.timeouts, (unsigned long)stats.crc_errors);
+  Serial.printf("   Transacción: media %.1f ms, p50 %.1f ms, p95 %.1f ms, p99 %.1f ms\n",
+                stats.transaction.getMean() / 1000.0, stats.transaction.getPercentile(50) / 1000.0,
+                stats.transaction.getPercentile(95) / 1000.0, stats.transaction.getPercentile(99) / 1000.0);
+  Serial.printf("   Primer byte: p50 %.1f ms, conexión: p50 %.1f ms (%lu)\n",
+                stats.first_byte.getPercentile(50) / 1000.0, stats.connect.getPercentile(50) / 1000.0,
+                (unsigned long)stats.connect.getCount());
+  Serial.printf("   Ciclo: %lu (%lu fallidos), p50 %.1f ms, p95 %.1f ms, máx %.1f ms\n",
+                (unsigned long)cycles.getCount(), (unsigned long)inverter->getFailedCycles(),
+                cycles.getPercentile(50) / 1000.0, cycles.getPercentile(95) / 1000.0, cycles.getMax() / 1000.0);
+  Serial.printf("   Bytes: %lu enviados, %lu recibidos\n", (unsigned long)stats.bytes_sent,
+                (unsigned long)stats.bytes_received);
+}
+
+void reportReadError(uint8_t unit) {
+  Serial.printf("❌ Error leyendo datos del inversor %u (%s)\n", unit, site->getName(unit));
+  if (rtu) {
+    Serial.printf("   RS485: %lu sin respuesta, %lu respuestas no válidas\n",
+                  (unsigned long)rtu->getTimeoutCount(), (unsigned long)rtu->getErrorCount());
+    return;
+  }
+  if (gateway) {
+    Serial.printf("   Modbus TCP: %lu timeouts, última excepción %u\n",
+                  (unsigned long)gateway->getTimeoutCount(), gateway->getLastException());
+    return;
+  }
+  uint32_t wait = solarmans[unit]->getNextProbeIn();
+  if (wait > 0) {
+    Serial.printf("   Datalogger sin respuesta: próximo intento en %lu s\n", (unsigned long)(wait / 1000));
+  }
+}
+
+// Fin de cualquier lectura de un inversor: solo se informa de los errores
+void onUnitRead(uint8_t unit, InverterData *data, void *ctx) {
+  if (!data->data_valid) {
+    reportReadError(unit);
+  }
+  if (solarmans[unit]) {
+    saveRequestSpan(unit);
+  }
+}
+
+// Datos enviados por el primer datalogger por su cuenta (modo servidor): llegan a
+// los datos del inversor y a onUnitRead() como los de una lectura
+void onPushData(uint8_t frame_type, const uint8_t *data, size_t len, void *ctx) {
+  if (!site || push_layout_count == 0) return;
+  if (site->decodePush(0, data, len)) {
+    last_push_decoded = millis();
+    push_decoded = true;
   } else {
-    Serial.println("❌ Error leyendo datos del inversor");
-    inv_data.data_valid = false;
+    Serial.printf("⚠️ Trama de datos incompleta (tipo 0x%02X, %u bytes)\n", frame_type, (unsigned)len);
+  }
+}
+
+void initializePushServer() {
+  if (push_port == 0) return;
+  if (push_layout_count == 0 || !inverters[0]->setPushLayout(push_layout, push_layout_count)) {
+    Serial.println("⚠️ Sin disposición de las tramas del datalogger (push_layout): solo se cuentan");
+  }
+  push_server = new SolarmanServer(dataloggers[0].sn);
+  push_server->onData(onPushData);
+  if (push_server->begin(push_port)) {
+    Serial.printf("📥 Esperando datos del datalogger en el puerto %u\n", push_port);
+  }
+}
+
+// Lectura completa bloqueante de todos los inversores a la vez, solo al arrancar;
+// después /update la pide sin esperar y loop() la avanza
+bool readInverterData() {
+  if (!site) return false;
+  bool ok = site->refreshAll();
+  for (uint8_t i = 0; i < site->getUnitCount(); i++) {
+    if (site->getData(i).data_valid) {
+      Serial.printf("✅ Datos leídos correctamente (%s)\n", site->getName(i));
+      printInverterData(site->getData(i));
+    }
   }
+  return ok;
 }
 
-void printInverterData() {
+void printInverterData(const InverterData &inv_data) {
   if (!inv_data.data_valid) return;
   Serial.println("\n=== DATOS DEL INVERSOR ===");
   Serial.printf("🕒 Timestamp: %lu\n", inv_data.timestamp);
   Serial.println("\n🌞 SOLAR:");
-  Serial.printf("   PV1: %.1fV, %.1fA, %.0fW\n", inv_data.pv1_voltage, inv_data.pv1_current, inv_data.pv1_power);
-  Serial.printf("   PV2: %.1fV, %.1fA, %.0fW\n", inv_data.pv2_voltage, inv_data.pv2_current, inv_data.pv2_power);
-  Serial.printf("   Producción diaria: %.1f kWh\n", inv_data.daily_production);
+  Serial.printf("   PV1: %.1fV, %.1fA, %.0fW\n", inv_data.pv1_voltage.value(), inv_data.pv1_current.value(), inv_data.pv1_power.value());
+  Serial.printf("   PV2: %.1fV, %.1fA, %.0fW\n", inv_data.pv2_voltage.value(), inv_data.pv2_current.value(), inv_data.pv2_power.value());
+  Serial.printf("   Producción diaria: %.1f kWh\n", inv_data.daily_production.value());
+  Serial.printf("   Producción total: %.1f kWh\n", inv_data.total_production.value());
   Serial.println("\n🔋 BATERÍA:");
-  Serial.printf("   SOC: %.0f%%, %.2fV, %.2fA, %.0fW\n", inv_data.battery_soc, inv_data.battery_voltage,
-                inv_data.battery_current, inv_data.battery_power);
-  Serial.printf("   Estado: %s, Temp: %.1f°C\n", inv_data.battery_status.c_str(), inv_data.battery_temperature);
+  Serial.printf("   SOC: %.0f%%, %.2fV, %.2fA, %.0fW\n", inv_data.battery_soc.value(), inv_data.battery_voltage.value(),
+                inv_data.battery_current.value(), inv_data.battery_power.value());
+  Serial.printf("   Estado: %s, Temp: %.1f°C\n", batteryStatusLabel(inv_data.battery_status), inv_data.battery_temperature.value());
   Serial.println("\n⚡ RED:");
-  Serial.printf("   Potencia: %.0fW\n", inv_data.grid_power);
-  Serial.printf("   Voltaje L1: %.1fV\n", inv_data.grid_voltage_l1);
-  Serial.printf("   Corriente L1: %.2fA\n", inv_data.grid_current_l1);
-  Serial.printf("   Frecuencia: %.2f Hz\n", inv_data.grid_frequency);
-  Serial.printf("   Energía comprada hoy: %.1f kWh\n", inv_data.daily_energy_bought);
-  Serial.printf("   Energía vendida hoy: %.1f kWh\n", inv_data.daily_energy_sold);
+  Serial.printf("   Potencia: %.0fW\n", inv_data.grid_power.value());
+  Serial.printf("   Voltaje L1: %.1fV\n", inv_data.grid_voltage_l1.value());
+  Serial.printf("   Corriente L1: %.2fA\n", inv_data.grid_current_l1.value());
+  Serial.printf("   Frecuencia: %.2f Hz\n", inv_data.grid_frequency.value());
+  Serial.printf("   Energía comprada hoy: %.1f kWh\n", inv_data.daily_energy_bought.value());
+  Serial.printf("   Energía vendida hoy: %.1f kWh\n", inv_data.daily_energy_sold.value());
   Serial.println("\n🏠 CARGA:");
-  Serial.printf("   Total: %.0fW, L1: %.0fW\n", inv_data.load_power, inv_data.load_l1_power);
-  Serial.printf("   Consumo hoy: %.1f kWh\n", inv_data.daily_load_consumption);
-  Serial.printf("   Estado inversor: %s\n", inv_data.running_status.c_str());
-  Serial.printf("   Modo trabajo: %s\n", inv_data.work_mode.c_str());
-  Serial.printf("   Temp inversor: %.1f°C\n", inv_data.inverter_temperature);
+  Serial.printf("   Total: %.0fW, L1: %.0fW\n", inv_data.load_power.value(), inv_data.load_l1_power.value());
+  Serial.printf("   Consumo hoy: %.1f kWh\n", inv_data.daily_load_consumption.value());
+  Serial.printf("   Equipo: %s\n", deviceTypeLabel(inv_data.device_type));
+  Serial.printf("   Estado inversor: %s\n", runningStatusLabel(inv_data.running_status));
+  Serial.printf("   Modo trabajo: %s\n", workModeLabel(inv_data.work_mode));
+  Serial.printf("   Temp inversor: %.1f°C\n", inv_data.inverter_temperature.value());
 }
 
 void setupWebServer() {
   server.on("/", handleRoot);
   server.on("/data", handleData);
+  server.on("/site", handleSite);
   server.on("/update", handleUpdate);
   server.on("/status", handleStatus);
+  server.on("/stats", handleStats);
+  server.on("/registers", handleRegisters);
   server.on("/reboot", handleReboot);
   server.begin();
   Serial.println("🌐 Servidor web iniciado en http://" + WiFi.localIP().toString());
@@ -101,40 +343,81 @@ void handleRoot() {
   server.send(200, "text/html", getWebInterface());
 }
 
+// Campos de la interfaz web a partir de los datos sumados (o de un solo inversor)
+void addSiteFields(JsonObject obj, const SiteData &data) {
+  obj["solar"] = data.solar_power;
+  obj["home"] = data.load_power;
+  obj["grid"] = data.grid_power;
+  obj["daily_bought"] = data.daily_energy_bought;
+  obj["daily_load"] = data.daily_load_consumption;
+  obj["daily_production"] = data.daily_production;
+  obj["daily_energy_sold"] = data.daily_energy_sold;
+  obj["pv1"] = data.pv1_power;
+  obj["pv2"] = data.pv2_power;
+  obj["bat_power"] = data.battery_power;
+  obj["soc"] = (int)(data.battery_soc + 0.5f);
+  obj["bat_temp"] = data.battery_temperature;
+  obj["inv_temp"] = data.inverter_temperature;
+}
+
+// Un inversor con todos sus campos (/data?unit=N, o /data con un solo inversor);
+// con varios, /data devuelve la suma de la instalación
 void handleData() {
   DynamicJsonDocument doc(2048);
-  if (inv_data.data_valid) {
+  uint8_t unit = server.hasArg("unit") ? server.arg("unit").toInt() : 0;
+  // Último refresco terminado: el ticket de /update está servido cuando sweep lo alcanza
+  if (site) doc["sweep"] = site->getRefreshDone();
+  if (site && !server.hasArg("unit") && site->getUnitCount() > 1) {
+    SiteData total;
+    site->getSiteData(&total);
+    if (total.units_valid > 0) {
+      doc["status"] = "success";
+      doc["timestamp"] = total.timestamp;
+      doc["units"] = total.unit_count;
+      doc["units_valid"] = total.units_valid;
+      addSiteFields(doc.as<JsonObject>(), total);
+    } else {
+      doc["status"] = "error";
+      doc["message"] = "Datos no disponibles";
+    }
+    String response;
+    serializeJson(doc, response);
+    server.send(200, "application/json", response);
+    return;
+  }
+  if (site && unit < site->getUnitCount() && site->getData(unit).data_valid) {
+    InverterData &inv_data = site->getData(unit);
     doc["status"] = "success";
     doc["timestamp"] = inv_data.timestamp;
 
     // --- Campos requeridos por la interfaz web ---
-    float solar_total = inv_data.pv1_power + inv_data.pv2_power;
+    int solar_total = inv_data.pv1_power.raw + inv_data.pv2_power.raw;
     doc["solar"] = solar_total;
-    doc["home"] = inv_data.load_power;
-    doc["grid"] = inv_data.grid_power;
-    doc["daily_bought"] = inv_data.daily_energy_bought;
-    doc["daily_load"] = inv_data.daily_load_consumption;
-    doc["daily_production"] = inv_data.daily_production;
-    doc["pv1"] = inv_data.pv1_power;
-    doc["pv2"] = inv_data.pv2_power;
-    doc["bat_power"] = inv_data.battery_power;
-    doc["soc"] = inv_data.battery_soc;
-    doc["bat_temp"] = inv_data.battery_temperature;
-    doc["inv_temp"] = inv_data.inverter_temperature;
-    doc["pv1_voltage"] = inv_data.pv1_voltage;
-    doc["pv1_current"] = inv_data.pv1_current;
-    doc["pv2_voltage"] = inv_data.pv2_voltage;
-    doc["pv2_current"] = inv_data.pv2_current;
-    doc["battery_voltage"] = inv_data.battery_voltage;
-    doc["battery_current"] = inv_data.battery_current;
-    doc["battery_status"] = inv_data.battery_status;
-    doc["grid_voltage_l1"] = inv_data.grid_voltage_l1;
-    doc["grid_current_l1"] = inv_data.grid_current_l1;
-    doc["grid_frequency"] = inv_data.grid_frequency;
-    doc["daily_energy_sold"] = inv_data.daily_energy_sold;
-    doc["load_l1_power"] = inv_data.load_l1_power;
-    doc["running_status"] = inv_data.running_status;
-    doc["work_mode"] = inv_data.work_mode;
+    doc["home"] = inv_data.load_power.raw;
+    doc["grid"] = inv_data.grid_power.raw;
+    doc["daily_bought"] = inv_data.daily_energy_bought.value();
+    doc["daily_load"] = inv_data.daily_load_consumption.value();
+    doc["daily_production"] = inv_data.daily_production.value();
+    doc["pv1"] = inv_data.pv1_power.raw;
+    doc["pv2"] = inv_data.pv2_power.raw;
+    doc["bat_power"] = inv_data.battery_power.raw;
+    doc["soc"] = inv_data.battery_soc.raw;
+    doc["bat_temp"] = inv_data.battery_temperature.value();
+    doc["inv_temp"] = inv_data.inverter_temperature.value();
+    doc["pv1_voltage"] = inv_data.pv1_voltage.value();
+    doc["pv1_current"] = inv_data.pv1_current.value();
+    doc["pv2_voltage"] = inv_data.pv2_voltage.value();
+    doc["pv2_current"] = inv_data.pv2_current.value();
+    doc["battery_voltage"] = inv_data.battery_voltage.value();
+    doc["battery_current"] = inv_data.battery_current.value();
+    doc["battery_status"] = batteryStatusLabel(inv_data.battery_status);
+    doc["grid_voltage_l1"] = inv_data.grid_voltage_l1.value();
+    doc["grid_current_l1"] = inv_data.grid_current_l1.value();
+    doc["grid_frequency"] = inv_data.grid_frequency.value();
+    doc["daily_energy_sold"] = inv_data.daily_energy_sold.value();
+    doc["load_l1_power"] = inv_data.load_l1_power.raw;
+    doc["running_status"] = runningStatusLabel(inv_data.running_status);
+    doc["work_mode"] = workModeLabel(inv_data.work_mode);
   } else {
     doc["status"] = "error";
     doc["message"] = "Datos no disponibles";
@@ -144,24 +427,234 @@ void handleData() {
   server.send(200, "application/json", response);
 }
 
+// Resumen de la instalación y de cada inversor
+void handleSite() {
+  DynamicJsonDocument doc(2048);
+  if (!site) {
+    server.send(503, "application/json", "{\"error\":\"no inverters\"}");
+    return;
+  }
+  SiteData total;
+  site->getSiteData(&total);
+  doc["timestamp"] = total.timestamp;
+  doc["data_valid"] = total.data_valid;
+  doc["units_valid"] = total.units_valid;
+  addSiteFields(doc.createNestedObject("site"), total);
+  JsonArray units = doc.createNestedArray("units");
+  for (uint8_t i = 0; i < site->getUnitCount(); i++) {
+    const InverterData *data = &site->getData(i);
+    SiteData unit;
+    InverterSite::sum(&data, 1, &unit);
+    JsonObject obj = units.createNestedObject();
+    obj["name"] = site->getName(i);
+    obj["data_valid"] = data->data_valid;
+    obj["age_ms"] = site->getRefresher(i)->getAge();
+    addSiteFields(obj, unit);
+  }
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// Pide un refresco completo sin esperarlo: lo avanza loop(). Si los datos ya son
+// recientes contesta 200 con ellos; si no, 202 con el ticket que /data marcará como
+// servido en "sweep"
 void handleUpdate() {
-  readInverterData();
-  server.send(200, "application/json", "{\"status\":\"updated\"}");
+  static const char *SOURCES[] = {"cached", "joined", "started"};
+  if (!site) {
+    server.send(503, "application/json", "{\"error\":\"no inverters\"}");
+    return;
+  }
+  uint32_t max_age = server.hasArg("max_age") ? server.arg("max_age").toInt() : update_max_age_ms;
+  RefreshCoalescer::RefreshSource sources[InverterSite::MAX_UNITS];
+  uint32_t ticket = site->requestRefresh(max_age, sources);
+  // Con varios inversores se informa del caso más costoso y de los datos más antiguos
+  RefreshCoalescer::RefreshSource source = RefreshCoalescer::REFRESH_CACHED;
+  unsigned long age = 0;
+  bool valid = true;
+  for (uint8_t i = 0; i < site->getUnitCount(); i++) {
+    if (sources[i] > source) source = sources[i];
+    unsigned long unit_age = site->getRefresher(i)->getAge();
+    if (unit_age > age) age = unit_age;
+    valid = valid && site->getData(i).data_valid;
+  }
+  bool done = site->isRefreshDone(ticket);
+  String response = "{\"status\":\"";
+  response += !done ? "pending" : valid ? "updated" : "failed";
+  response += "\",\"source\":\"";
+  response += SOURCES[source];
+  response += "\",\"ticket\":";
+  response += ticket;
+  if (done && valid) {
+    response += ",\"age_ms\":";
+    response += age;
+  }
+  response += "}";
+  server.send(done ? 200 : 202, "application/json", response);
 }
 
 void handleStatus() {
-  DynamicJsonDocument doc(512);
+  DynamicJsonDocument doc(2048);
   doc["status"] = "online";
   doc["wifi_rssi"] = WiFi.RSSI();
   doc["free_heap"] = ESP.getFreeHeap();
-  doc["datalogger_ip"] = datalogger_ip;
-  doc["datalogger_sn"] = datalogger_sn;
-  doc["data_valid"] = inv_data.data_valid;
+  doc["datalogger_ip"] = dataloggers[0].ip;
+  doc["datalogger_sn"] = dataloggers[0].sn;
+  doc["profile"] = profile_loaded ? profile.getName() : "builtin";
+  if (profile.getError() != PROFILE_OK) {
+    doc["profile_error"] = profileErrorLabel(profile.getError());
+    doc["profile_error_line"] = profile.getErrorLine();
+  }
+  SiteData total;
+  if (site) site->getSiteData(&total);
+  doc["data_valid"] = site && total.data_valid;
+  if (site) {
+    uint32_t sweeps = 0, joined = 0, cached = 0;
+    for (uint8_t i = 0; i < site->getUnitCount(); i++) {
+      sweeps += site->getRefresher(i)->getSweepCount();
+      joined += site->getRefresher(i)->getJoinedCount();
+      cached += site->getRefresher(i)->getCachedCount();
+    }
+    doc["refresh_sweeps"] = sweeps;
+    doc["refresh_joined"] = joined;
+    doc["refresh_cached"] = cached;
+  }
+  if (solarmans[0]) {
+    // Un elemento por datalogger, en el orden de dataloggers[]
+    static const char *BREAKER_STATES[] = {"closed", "open", "half-open"};
+    JsonArray units = doc.createNestedArray("dataloggers");
+    for (uint8_t i = 0; i < InverterSite::MAX_UNITS && solarmans[i]; i++) {
+      SolarmanV5 *solarman = solarmans[i];
+      JsonObject obj = units.createNestedObject();
+      obj["ip"] = dataloggers[i].ip;
+      obj["data_valid"] = site->getData(i).data_valid;
+      obj["connects"] = solarman->getConnectCount();
+      obj["reuses"] = solarman->getReuseCount();
+      obj["heartbeats"] = solarman->getHeartbeatCount();
+      obj["breaker"] = BREAKER_STATES[solarman->getBreakerState()];
+      obj["failures"] = solarman->getConsecutiveFailures();
+      obj["next_probe_ms"] = solarman->getNextProbeIn();
+      obj["max_span"] = solarman->getMaxSpan();
+      obj["span_ok"] = solarman->getLargestGoodSpan();
+      if (solarman->getSmallestBadSpan() != SolarmanV5::NO_BAD_SPAN) {
+        obj["span_rejected"] = solarman->getSmallestBadSpan();
+      }
+    }
+  }
+  if (rtu) {
+    doc["rs485_requests"] = rtu->getRequestCount();
+    doc["rs485_timeouts"] = rtu->getTimeoutCount();
+    doc["rs485_errors"] = rtu->getErrorCount();
+  }
+  if (gateway) {
+    doc["modbus_tcp_connects"] = gateway->getConnectCount();
+    doc["modbus_tcp_transactions"] = gateway->getTransactionCount();
+    doc["modbus_tcp_timeouts"] = gateway->getTimeoutCount();
+  }
+  if (push_server) {
+    doc["push_connected"] = push_server->hasClient();
+    doc["push_frames"] = push_server->getDataCount();
+    doc["push_age_ms"] = push_server->getLastDataAge();
+  }
   String response;
   serializeJson(doc, response);
   server.send(200, "application/json", response);
 }
 
+// Registros en bruto: /registers?addr=0x00B8&count=4 (y ?unit=N, ?max_age=MS). Contesta
+// de la caché sin esperar al inversor: si algún registro no tiene menos de max_age encola
+// su lectura, que avanza loop(), y contesta 202 con una generación. Repitiendo la petición
+// con ?generation=N valen los registros leídos desde entonces aunque max_age sea 0: se
+// obtienen en cuanto llegan (200), o 502 una vez si su lectura ha fallado
+void handleRegisters() {
+  uint8_t unit = server.hasArg("unit") ? server.arg("unit").toInt() : 0;
+  if (!site || unit >= site->getUnitCount()) {
+    server.send(404, "application/json", "{\"error\":\"no such unit\"}");
+    return;
+  }
+  uint32_t addr = strtoul(server.arg("addr").c_str(), NULL, 0);
+  long count = server.hasArg("count") ? server.arg("count").toInt() : 1;
+  uint32_t max_age = server.hasArg("max_age") ? server.arg("max_age").toInt() : register_max_age_ms;
+  if (!server.hasArg("addr") || addr >= DeyeInverter::REGISTER_MAP_SIZE || count < 1 ||
+      count > RegisterReader::MAX_REGISTERS_PER_READ || (uint32_t)count > DeyeInverter::REGISTER_MAP_SIZE - addr) {
+    server.send(400, "application/json", "{\"error\":\"bad register range\"}");
+    return;
+  }
+  DeyeInverter *inverter = site->getInverter(unit);
+  uint32_t min_generation = server.hasArg("generation") ? strtoul(server.arg("generation").c_str(), NULL, 0)
+                                                        : inverter->getCacheGeneration() + 1;
+  DeyeInverter::RegisterRequest result = inverter->requestRegisters(addr, count, max_age, min_generation);
+  if (result == DeyeInverter::REGISTERS_PENDING) {
+    String response = "{\"status\":\"pending\",\"generation\":";
+    response += min_generation;
+    response += "}";
+    server.send(202, "application/json", response);
+    return;
+  }
+  if (result == DeyeInverter::REGISTERS_FAILED) {
+    server.send(502, "application/json", "{\"error\":\"register read failed\"}");
+    return;
+  }
+  if (result == DeyeInverter::REGISTERS_REJECTED) {
+    server.send(503, "application/json", "{\"error\":\"register queue full\"}");
+    return;
+  }
+  
+  unsigned long now = inverter->getClock()->millis();
+  String response = "{\"status\":\"success\",\"unit\":";
+  response += unit;
+  response += ",\"generation\":";
+  response += inverter->getCacheGeneration();
+  response += ",\"registers\":[";
+  for (long i = 0; i < count; i++) {
+    CachedRegister reg;
+    inverter->getCachedRegister(addr + i, &reg);
+    char item[96];
+    snprintf(item, sizeof(item), "%s{\"addr\":%lu,\"value\":%u,\"age_ms\":%lu,\"generation\":%lu}", i ? "," : "",
+             (unsigned long)(addr + i), reg.value, now - reg.timestamp, (unsigned long)reg.generation);
+    response += item;
+  }
+  response += "]}";
+  server.send(200, "application/json", response);
+}
+
+// Histogramas de tiempos de las peticiones y de los ciclos de lectura de un
+// inversor (?unit=N, por defecto el primero); /stats?reset=1 los pone a cero
+void handleStats() {
+  uint8_t unit = server.hasArg("unit") ? server.arg("unit").toInt() : 0;
+  if (!site || unit >= site->getUnitCount()) {
+    server.send(404, "application/json", "{\"error\":\"no such unit\"}");
+    return;
+  }
+  DeyeInverter *inverter = site->getInverter(unit);
+  RegisterReader *reader = inverter->getReader();
+  static char requests_json[RequestStats::JSON_MAX_LEN];
+  static char cycles_json[LatencyHistogram::JSON_MAX_LEN];
+  if (!reader->getStats().toJson(requests_json, sizeof(requests_json)) ||
+      !inverter->getCycleStats().toJson(cycles_json, sizeof(cycles_json))) {
+    server.send(500, "application/json", "{\"error\":\"stats too large\"}");
+    return;
+  }
+  String response = "{\"reader\":\"";
+  response += activeReaderName();
+  response += "\",\"unit\":\"";
+  response += site->getName(unit);
+  response += "\",\"uptime_ms\":";
+  response += millis();
+  response += ",\"requests\":";
+  response += requests_json;
+  response += ",\"cycles\":";
+  response += cycles_json;
+  response += ",\"failed_cycles\":";
+  response += inverter->getFailedCycles();
+  response += "}";
+  if (server.hasArg("reset")) {
+    reader->getStats().reset();
+    inverter->getCycleStats().reset();
+  }
+  server.send(200, "application/json", response);
+}
+
 void handleReboot() {
   server.send(200, "text/html", "<html><body><h1>Reiniciando ESP32...</h1></body></html>");
   delay(1000);
@@ -385,6 +878,8 @@ void setup() {
   Serial.begin(115200);
   Serial.println("=== MONITOR SOLAR ===");
   connectWiFi();
+  // Hora para los acks al datalogger (heartbeats y tramas de datos); hasta que llega se manda 0
+  configTime(0, 0, "pool.ntp.org", "time.nist.gov");
   delay(1000);
   if (MDNS.begin("solar")) {
     MDNS.addService("http", "tcp", 80);
@@ -392,7 +887,9 @@ void setup() {
   } else {
     Serial.println("Error al iniciar mDNS");
   }
+  loadInverterProfile();
   initializeInverter();
+  initializePushServer();
   setupWebServer();
   delay(2000);
   readInverterData();
@@ -400,9 +897,21 @@ void setup() {
 
 void loop() {
   server.handleClient();
-  static unsigned long last_read = 0;
-  if (millis() - last_read > update_interval * 1000) {
-    readInverterData();
-    last_read = millis();
+  if (push_server) push_server->poll();
+  // Cada inversor lee cada clase de registros con su periodo, todos a la vez y
+  // sin esperarse entre ellos; las clases que vencen a la vez comparten
+  // peticiones. Con un datalogger caído (breaker abierto) solo ese inversor
+  // espera a su próximo intento, y si el primer datalogger ya envía sus datos
+  // (y se saben decodificar) no hace falta preguntarle
+  bool push_fresh = push_decoded && millis() - last_push_decoded < push_fresh_ms;
+  if (site) {
+    site->setPaused(0, push_fresh);
+    site->poll();
   }
-}
\ No newline at end of file
+  if (site && stats_report_interval && millis() - last_stats_report >= stats_report_interval * 1000) {
+    last_stats_report = millis();
+    for (uint8_t i = 0; i < site->getUnitCount(); i++) {
+      printRequestStats(i);
+    }
+  }
+}
@@ -0,0 +1,57 @@
+#ifndef POSIXTRANSPORT_H
+#define POSIXTRANSPORT_H
+
+#ifndef ARDUINO
+
+#include "Transport.h"
+
+/**
+ * @brief Transporte del PC: socket TCP POSIX no bloqueante
+ */
+class PosixTransport : public Transport {
+private:
+    int _fd;
+    bool _connecting;               // connect() no bloqueante en curso
+
+public:
+    PosixTransport();
+    PosixTransport(int fd);         // Socket ya conectado (aceptado por PosixListener)
+    ~PosixTransport();
+
+    bool connect(const char *host, uint16_t port, uint32_t timeout_ms) override;
+    bool startConnect(const char *host, uint16_t port) override;
+    int checkConnect() override;
+    void stop() override;
+    bool connected() override;
+    int available() override;
+    int read(uint8_t *buffer, size_t len) override;
+    size_t write(const uint8_t *buffer, size_t len) override;
+};
+
+/**
+ * @brief Puerto a la escucha del PC: socket POSIX no bloqueante
+ */
+class PosixListener : public Listener {
+private:
+    int _fd;
+
+public:
+    PosixListener();
+    ~PosixListener();
+
+    bool begin(uint16_t port) override;
+    Transport *accept() override;
+    void stop() override;
+};
+
+// Reloj monotónico del sistema
+class PosixClock : public Clock {
+public:
+    unsigned long millis() override;
+    unsigned long micros() override;
+    void delay(unsigned long ms) override;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+#include "ReadPlanner.h"
+
+// Registro de menor dirección de la selección que termina después de `from` (-1 si no hay)
+int ReadPlanner::findNext(const RegisterDescriptor *regs, size_t reg_count, uint8_t group_mask, uint8_t poll_mask,
+                          uint32_t from) {
+    int best = -1;
+    for (size_t i = 0; i < reg_count; i++) {
+        if (!(group_mask & (1 << regs[i].group))) continue;
+        if (!(poll_mask & (1 << regs[i].poll))) continue;
+        if ((uint32_t)regs[i].address + regs[i].width <= from) continue;
+        if (best < 0 || regs[i].address < regs[best].address) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+bool ReadPlanner::build(const RegisterDescriptor *regs, size_t reg_count, uint8_t group_mask, uint8_t poll_mask,
+                        uint16_t max_span, uint16_t max_gap, ReadPlan *plan) {
+    plan->count = 0;
+    if (max_span < 2) {
+        return false;  // Un registro de 32 bits tiene que caber en una petición
+    }
+
+    uint32_t cursor = 0;  // Primera dirección aún no cubierta por el plan
+    int next = findNext(regs, reg_count, group_mask, poll_mask, cursor);
+
+    while (next >= 0) {
+        if (plan->count >= MAX_PLAN_BLOCKS) {
+            plan->count = 0;
+            return false;
+        }
+
+        uint32_t start = regs[next].address < cursor ? cursor : regs[next].address;
+        uint32_t end = (uint32_t)regs[next].address + regs[next].width;
+
+        // Alargar el bloque mientras el siguiente registro quepa y el hueco compense
+        next = findNext(regs, reg_count, group_mask, poll_mask, end);
+        while (next >= 0) {
+            uint32_t next_start = regs[next].address < end ? end : regs[next].address;
+            uint32_t next_end = (uint32_t)regs[next].address + regs[next].width;
+            if (next_start - end > max_gap || next_end - start > max_span) {
+                break;
+            }
+            end = next_end;
+            next = findNext(regs, reg_count, group_mask, poll_mask, end);
+        }
+
+        plan->blocks[plan->count].start_addr = start;
+        plan->blocks[plan->count].count = end - start;
+        plan->count++;
+        cursor = end;
+    }
+
+    return true;
+}
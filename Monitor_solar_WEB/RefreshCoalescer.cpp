@@ -0,0 +1,87 @@
+#include "RefreshCoalescer.h"
+
+RefreshCoalescer::RefreshCoalescer(DeyeInverter *inverter, InverterData *data) {
+    _inverter = inverter;
+    _data = data;
+    _callback = nullptr;
+    _ctx = nullptr;
+    _pending = false;
+    _in_flight = false;
+    _started = 0;
+    _completed = 0;
+    _joined_count = 0;
+    _cached_count = 0;
+}
+
+unsigned long RefreshCoalescer::getAge() {
+    if (!_data->data_valid) {
+        return 0xFFFFFFFF;
+    }
+    return _inverter->getClock()->millis() - _data->timestamp;
+}
+
+uint32_t RefreshCoalescer::request(uint32_t max_staleness_ms, RefreshSource *source) {
+    RefreshSource how;
+    uint32_t ticket;
+    // Sin datos válidos no hay nada que servir, por grande que sea max_staleness_ms
+    if (max_staleness_ms > 0 && _data->data_valid && getAge() <= max_staleness_ms) {
+        how = REFRESH_CACHED;
+        ticket = _completed;
+        _cached_count++;
+    } else if (_in_flight) {
+        how = REFRESH_JOINED;
+        ticket = _started;
+        _joined_count++;
+    } else if (_pending) {
+        how = REFRESH_JOINED;
+        ticket = _started + 1;
+        _joined_count++;
+    } else {
+        how = REFRESH_STARTED;
+        _pending = true;
+        ticket = _started + 1;
+        startPending();
+    }
+    if (source) {
+        *source = how;
+    }
+    return ticket;
+}
+
+bool RefreshCoalescer::refresh(uint32_t max_staleness_ms, RefreshSource *source) {
+    uint32_t ticket = request(max_staleness_ms, source);
+    Clock *clock = _inverter->getClock();
+    while (!isDone(ticket)) {
+        poll();
+        clock->delay(1);
+    }
+    return _data->data_valid;
+}
+
+void RefreshCoalescer::poll() {
+    _inverter->poll();
+    startPending();
+}
+
+void RefreshCoalescer::startPending() {
+    // Una lectura parcial en curso escribe en los mismos registros: se espera a que acabe
+    if (!_pending || _inverter->isReading()) {
+        return;
+    }
+    _pending = false;
+    _in_flight = true;
+    _started++;
+    if (!_inverter->beginReadAll(_data, onReadDone, this)) {
+        _in_flight = false;
+        _completed++;
+    }
+}
+
+void RefreshCoalescer::onReadDone(InverterData *data, void *ctx) {
+    RefreshCoalescer *self = (RefreshCoalescer *)ctx;
+    self->_in_flight = false;
+    self->_completed++;
+    if (self->_callback) {
+        self->_callback(data, self->_ctx);
+    }
+}
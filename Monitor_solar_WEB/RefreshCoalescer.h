@@ -0,0 +1,107 @@
+#ifndef REFRESHCOALESCER_H
+#define REFRESHCOALESCER_H
+
+#include "DeyeInverter.h"
+
+/**
+ * @brief Agrupa las peticiones de refresco completo en una sola lectura (single-flight)
+ * 
+ * Varias peticiones de refresco que llegan mientras hay una lectura completa
+ * en curso se unen a ella y reciben su resultado, en lugar de lanzar cada una
+ * otro barrido de todos los registros. Si lo que está en curso es una lectura
+ * parcial (las clases programadas), el barrido completo se lanza al terminar
+ * esta y todas las peticiones que lleguen mientras tanto comparten ese barrido.
+ * 
+ * Con max_staleness_ms > 0 se sirve la última lectura si es lo bastante
+ * reciente, sin preguntar al inversor.
+ * 
+ * Cada petición devuelve un ticket (el número del barrido que la satisface);
+ * la lectura avanza con poll(), igual que DeyeInverter::poll().
+ */
+class RefreshCoalescer {
+public:
+    enum RefreshSource {
+        REFRESH_CACHED,             // Servida con la lectura anterior
+        REFRESH_JOINED,             // Unida a un barrido ya en curso o pendiente
+        REFRESH_STARTED             // Ha lanzado un barrido nuevo
+    };
+
+private:
+    DeyeInverter *_inverter;
+    InverterData *_data;            // Lectura compartida (la misma que usa el resto del sketch)
+    InverterDataCallback _callback;
+    void *_ctx;
+    
+    bool _pending;                  // Barrido pedido, esperando a que termine otra lectura
+    bool _in_flight;                // Barrido propio en curso
+    uint32_t _started;              // Barridos lanzados
+    uint32_t _completed;            // Barridos terminados
+    uint32_t _joined_count;
+    uint32_t _cached_count;
+    
+    static void onReadDone(InverterData *data, void *ctx);
+    void startPending();
+
+public:
+    /**
+     * @brief Constructor
+     * 
+     * @param inverter Inversor del que leer (no pasa a ser propiedad del coalescer)
+     * @param data Estructura donde queda la lectura; debe seguir viva
+     */
+    RefreshCoalescer(DeyeInverter *inverter, InverterData *data);
+    
+    /**
+     * @brief Función a la que se llama al terminar cada barrido (una vez, no por petición)
+     */
+    void onRefresh(InverterDataCallback callback, void *ctx = nullptr) {
+        _callback = callback;
+        _ctx = ctx;
+    }
+    
+    /**
+     * @brief Pide un refresco completo sin bloquear
+     * 
+     * @param max_staleness_ms Antigüedad máxima aceptable de la lectura anterior (0 = leer siempre)
+     * @param source Si no es nulo, indica cómo se ha atendido la petición
+     * @return uint32_t Ticket: la petición está servida cuando isDone(ticket)
+     */
+    uint32_t request(uint32_t max_staleness_ms = 0, RefreshSource *source = nullptr);
+    
+    /**
+     * @brief Indica si el barrido del ticket ya ha terminado
+     */
+    bool isDone(uint32_t ticket) { return (int32_t)(_completed - ticket) >= 0; }
+    
+    /**
+     * @brief Pide un refresco y espera a que termine (bloqueante)
+     * 
+     * @return true Si la lectura que se devuelve es válida
+     */
+    bool refresh(uint32_t max_staleness_ms = 0, RefreshSource *source = nullptr);
+    
+    /**
+     * @brief Avanza la lectura en curso y lanza el barrido pendiente (no bloquea)
+     * 
+     * Sustituye a DeyeInverter::poll() en el bucle principal.
+     */
+    void poll();
+    
+    /**
+     * @brief Indica si hay un barrido completo en curso o pendiente
+     * 
+     * Mientras tanto no tiene sentido lanzar lecturas programadas.
+     */
+    bool isBusy() { return _pending || _in_flight; }
+    
+    /**
+     * @brief Antigüedad de la lectura actual en ms (0xFFFFFFFF si no es válida)
+     */
+    unsigned long getAge();
+    
+    uint32_t getSweepCount() { return _started; }
+    uint32_t getJoinedCount() { return _joined_count; }
+    uint32_t getCachedCount() { return _cached_count; }
+};
+
+#endif
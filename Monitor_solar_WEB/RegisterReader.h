@@ -0,0 +1,113 @@
+#ifndef REGISTERREADER_H
+#define REGISTERREADER_H
+
+#include "RequestStats.h"
+#include "Transport.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Petición de lectura de un bloque de registros consecutivos
+ */
+struct SolarmanReadRequest {
+    uint16_t start_addr;            // Dirección del primer registro
+    uint16_t count;                 // Número de registros
+    uint16_t *values;               // Destino de los valores leídos
+    bool ok;                        // Resultado de la lectura
+};
+
+/**
+ * @brief Estado de una lectura asíncrona
+ */
+enum SolarmanReadStatus {
+    SOLARMAN_READ_UNKNOWN,          // Handle desconocido o ya reciclado
+    SOLARMAN_READ_PENDING,          // En cola o esperando respuesta
+    SOLARMAN_READ_DONE,             // Completada con éxito
+    SOLARMAN_READ_FAILED            // Error de conexión, timeout o respuesta inválida
+};
+
+/**
+ * @brief Callback de fin de lectura asíncrona
+ * 
+ * @param handle Handle devuelto por beginRead()
+ * @param ok true si los valores se leyeron correctamente
+ * @param ctx Contexto indicado en beginRead()
+ */
+typedef void (*SolarmanReadCallback)(int handle, bool ok, void *ctx);
+
+/**
+ * @brief Lectura de registros Modbus (FC03) del inversor
+ * 
+ * DeyeInverter solo lee registros a través de esta interfaz. La implementa
+ * SolarmanV5 (Modbus encapsulado en V5 a través del datalogger WiFi) y
+ * ModbusRTU (Modbus RTU directo por el puerto RS485 del inversor).
+ */
+class RegisterReader {
+public:
+    static const uint16_t MAX_REGISTERS_PER_READ = 125;  // Límite Modbus FC03 por petición
+    static const uint8_t ASYNC_QUEUE_SIZE = 16;           // Lecturas asíncronas simultáneas (un plan de lectura entero)
+    
+    virtual ~RegisterReader() {}
+    
+    /**
+     * @brief Lee `count` registros consecutivos a partir de `start_addr` (bloqueante)
+     * 
+     * @return true Si la lectura fue exitosa
+     */
+    virtual bool readHoldingRegisters(uint16_t start_addr, uint16_t count, uint16_t *values) = 0;
+    
+    /**
+     * @brief Lee varios bloques seguidos (bloqueante), tan rápido como permita el medio
+     * 
+     * @param requests Array de peticiones; se rellena el campo `ok` de cada una
+     * @param n Número de peticiones
+     * @return true Si todos los bloques se leyeron correctamente
+     */
+    virtual bool readPipelined(SolarmanReadRequest *requests, size_t n) = 0;
+    
+    /**
+     * @brief Encola la lectura de un bloque sin bloquear; avanza con poll()
+     * 
+     * @return int Handle de la lectura, o -1 si la cola está llena o los parámetros no son válidos
+     */
+    virtual int beginRead(uint16_t start_addr, uint16_t count, uint16_t *values,
+                          SolarmanReadCallback callback = nullptr, void *ctx = nullptr) = 0;
+    
+    /**
+     * @brief Avanza las lecturas asíncronas (no bloquea)
+     */
+    virtual void poll() = 0;
+    
+    /**
+     * @brief Indica si hay lecturas asíncronas pendientes
+     */
+    virtual bool isBusy() = 0;
+    
+    /**
+     * @brief Reloj usado para los timeouts y las marcas de tiempo
+     */
+    virtual Clock *getClock() = 0;
+    
+    /**
+     * @brief Estadísticas de las peticiones (tiempos, bytes, reintentos y errores)
+     */
+    virtual RequestStats &getStats() = 0;
+    
+    /**
+     * @brief Tiempo hasta que merezca la pena volver a preguntar (ms)
+     * 
+     * Distinto de 0 mientras el lector está en pausa tras varios fallos
+     * (circuit breaker); los lectores sin esa pausa devuelven siempre 0.
+     */
+    virtual uint32_t getNextProbeIn() { return 0; }
+    
+    /**
+     * @brief Máximo de registros por petición que el equipo contesta bien
+     * 
+     * Los lectores que lo van descubriendo (SolarmanV5) devuelven el límite
+     * aprendido; los demás, el máximo de Modbus.
+     */
+    virtual uint16_t getMaxSpan() { return MAX_REGISTERS_PER_READ; }
+};
+
+#endif
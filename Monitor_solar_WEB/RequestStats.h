@@ -0,0 +1,103 @@
+#ifndef REQUESTSTATS_H
+#define REQUESTSTATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Histograma de tiempos con cubetas fijas (1-2-5 desde 250 µs hasta 5 s)
+ * 
+ * record() solo hace unas comparaciones y sumas, sin memoria dinámica, para
+ * poder llamarlo en cada petición. Los percentiles son aproximados: se
+ * devuelve el límite superior de la cubeta en la que caen.
+ */
+class LatencyHistogram {
+public:
+    static const uint8_t BUCKET_COUNT = 15;
+    static const uint32_t BUCKET_LIMITS_US[BUCKET_COUNT - 1];   // Límite superior (exclusivo) de cada cubeta salvo la última
+    static const size_t JSON_MAX_LEN = 384;                     // toJson() con todos los valores de 10 cifras
+
+private:
+    uint32_t _buckets[BUCKET_COUNT];
+    uint32_t _count;
+    uint64_t _sum_us;
+    uint32_t _min_us;
+    uint32_t _max_us;
+
+public:
+    LatencyHistogram() { reset(); }
+    
+    /**
+     * @brief Añade una muestra
+     * 
+     * @param us Duración en microsegundos
+     */
+    void record(uint32_t us) {
+        uint8_t b = 0;
+        while (b < BUCKET_COUNT - 1 && us >= BUCKET_LIMITS_US[b]) {
+            b++;
+        }
+        _buckets[b]++;
+        _count++;
+        _sum_us += us;
+        if (us < _min_us) _min_us = us;
+        if (us > _max_us) _max_us = us;
+    }
+    
+    void reset();
+    
+    uint32_t getCount() const { return _count; }
+    uint32_t getMean() const { return _count ? (uint32_t)(_sum_us / _count) : 0; }
+    uint32_t getMin() const { return _count ? _min_us : 0; }
+    uint32_t getMax() const { return _max_us; }
+    uint32_t getBucket(uint8_t b) const { return _buckets[b]; }
+    
+    /**
+     * @brief Percentil aproximado
+     * 
+     * @param pct Percentil (0..100)
+     * @return uint32_t Límite superior de la cubeta del percentil en µs (el máximo si cae en la última)
+     */
+    uint32_t getPercentile(uint8_t pct) const;
+    
+    /**
+     * @brief Escribe el histograma como objeto JSON
+     * 
+     * @return size_t Longitud escrita (sin el terminador), o 0 si no cabe
+     */
+    size_t toJson(char *buffer, size_t size) const;
+};
+
+/**
+ * @brief Instrumentación de las peticiones de un RegisterReader
+ * 
+ * Tiempos de conexión, hasta el primer byte de la respuesta y de la
+ * transacción completa, más contadores de bytes, reintentos, timeouts y
+ * respuestas con CRC o checksum incorrecto.
+ */
+struct RequestStats {
+    static const size_t JSON_MAX_LEN = 1536;
+    
+    LatencyHistogram connect;       // Apertura de la conexión
+    LatencyHistogram first_byte;    // Desde el envío de la petición hasta el primer byte de la respuesta
+    LatencyHistogram transaction;   // Desde el envío de la petición hasta la respuesta completa
+    uint32_t requests;              // Peticiones de lectura enviadas
+    uint32_t retries;               // Peticiones repetidas tras un fallo
+    uint32_t timeouts;              // Esperas de respuesta agotadas
+    uint32_t crc_errors;            // Respuestas con CRC o checksum incorrecto
+    uint32_t bytes_sent;
+    uint32_t bytes_received;
+    
+    RequestStats() { reset(); }
+    
+    void reset();
+    
+    /**
+     * @brief Escribe las estadísticas como objeto JSON
+     * 
+     * @return size_t Longitud escrita (sin el terminador), o 0 si no cabe
+     */
+    size_t toJson(char *buffer, size_t size) const;
+};
+
+#endif
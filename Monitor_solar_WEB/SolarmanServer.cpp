@@ -0,0 +1,202 @@
+#include "SolarmanServer.h"
+#include "ModbusCRC.h"
+#include <string.h>
+#include <time.h>
+
+SolarmanServer::SolarmanServer(uint32_t datalogger_sn) {
+    _datalogger_sn = datalogger_sn;
+    _listener = createDefaultListener();
+    _owns_listener = true;
+    _clock = defaultClock();
+    _client = nullptr;
+    _rx_len = 0;
+    _last_rx = 0;
+    _last_data = 0;
+    _callback = nullptr;
+    _ctx = nullptr;
+    _connect_count = 0;
+    _frame_count = 0;
+    _data_count = 0;
+    _error_count = 0;
+}
+
+SolarmanServer::~SolarmanServer() {
+    stop();
+    if (_owns_listener) {
+        delete _listener;
+    }
+}
+
+void SolarmanServer::setListener(Listener *listener, Clock *clock) {
+    stop();
+    if (_owns_listener) {
+        delete _listener;
+    }
+    _listener = listener;
+    _owns_listener = false;
+    if (clock != nullptr) {
+        _clock = clock;
+    }
+}
+
+bool SolarmanServer::begin(uint16_t port) {
+    closeClient();
+    return _listener->begin(port);
+}
+
+void SolarmanServer::stop() {
+    closeClient();
+    _listener->stop();
+}
+
+void SolarmanServer::closeClient() {
+    if (_client != nullptr) {
+        _client->stop();
+        delete _client;
+        _client = nullptr;
+    }
+    _rx_len = 0;
+}
+
+unsigned long SolarmanServer::getLastDataAge() {
+    if (_data_count == 0) {
+        return 0xFFFFFFFF;
+    }
+    return _clock->millis() - _last_data;
+}
+
+void SolarmanServer::poll() {
+    // El datalogger solo mantiene una conexión: si reconecta, la nueva sustituye a la anterior
+    Transport *incoming = _listener->accept();
+    if (incoming != nullptr) {
+        closeClient();
+        _client = incoming;
+        _last_rx = _clock->millis();
+        _connect_count++;
+    }
+    if (_client == nullptr) {
+        return;
+    }
+
+    int frame_len;
+    while ((frame_len = receiveFrame()) != 0) {
+        if (frame_len < 0) {
+            _error_count++;
+            closeClient();
+            return;
+        }
+        // Sin ack el datalogger reenvía la trama al reconectar: se cierra como conexión caída
+        if (!handleFrame(_rx_buffer, frame_len)) {
+            _error_count++;
+            closeClient();
+            return;
+        }
+    }
+
+    if (!_client->connected() && !_client->available()) {
+        closeClient();
+    } else if (_clock->millis() - _last_rx > IDLE_TIMEOUT_MS) {
+        closeClient();
+    }
+}
+
+int SolarmanServer::receiveFrame() {
+    while (_client->available() > 0) {
+        size_t wanted;
+        if (_rx_len < V5_HEADER_LEN) {
+            wanted = V5_HEADER_LEN - _rx_len;
+        } else {
+            size_t total_len = V5_HEADER_LEN + (_rx_buffer[1] | (_rx_buffer[2] << 8)) + V5_TRAILER_LEN;
+            wanted = total_len - _rx_len;
+        }
+        int n = _client->read(&_rx_buffer[_rx_len], wanted);
+        if (n <= 0) {
+            break;
+        }
+        _rx_len += n;
+        _last_rx = _clock->millis();
+
+        if (_rx_len == V5_HEADER_LEN) {
+            size_t total_len = V5_HEADER_LEN + (_rx_buffer[1] | (_rx_buffer[2] << 8)) + V5_TRAILER_LEN;
+            if (_rx_buffer[0] != 0xA5 || total_len > MAX_FRAME_LEN) {
+                return -1;
+            }
+            continue;
+        }
+        if (_rx_len < V5_HEADER_LEN || (size_t)n < wanted) {
+            continue;
+        }
+
+        // Trama completa
+        size_t frame_len = _rx_len;
+        _rx_len = 0;
+        return frame_len;
+    }
+    return 0;
+}
+
+bool SolarmanServer::handleFrame(const uint8_t *frame, size_t len) {
+    uint32_t sn = frame[7] | (frame[8] << 8) | (frame[9] << 16) | ((uint32_t)frame[10] << 24);
+    if (len < V5_HEADER_LEN + 1 + V5_TRAILER_LEN ||
+        frame[len - 1] != 0x15 ||
+        frame[len - 2] != ModbusCRC::sum(&frame[1], len - 3) ||
+        frame[3] != 0x10 ||
+        (_datalogger_sn != 0 && sn != _datalogger_sn)) {
+        _error_count++;
+        return true;
+    }
+
+    uint8_t control = frame[4];
+    if (control != V5_CONTROL_HANDSHAKE && control != V5_CONTROL_DATA && control != V5_CONTROL_INFO &&
+        control != V5_CONTROL_HEARTBEAT && control != V5_CONTROL_REPORT) {
+        _error_count++;
+        return true;
+    }
+    _frame_count++;
+
+    // Se confirma antes de procesar: el datalogger reenvía las tramas sin respuesta
+    if (!sendAck(frame)) {
+        return false;
+    }
+
+    size_t payload_len = len - V5_HEADER_LEN - V5_TRAILER_LEN;
+    if (control == V5_CONTROL_DATA && payload_len > V5_DATA_HEADER_LEN) {
+        _data_count++;
+        _last_data = _clock->millis();
+        if (_callback) {
+            _callback(frame[V5_HEADER_LEN], &frame[V5_HEADER_LEN + V5_DATA_HEADER_LEN],
+                      payload_len - V5_DATA_HEADER_LEN, _ctx);
+        }
+    }
+    return true;
+}
+
+bool SolarmanServer::sendAck(const uint8_t *frame) {
+    // Respuesta del servidor Solarman: tipo de trama, estado y hora (0 sin sincronizar:
+    // antes, time() cuenta desde el arranque)
+    time_t synced = time(nullptr);
+    uint32_t now = synced >= (time_t)MIN_SYNCED_TIME ? (uint32_t)synced : 0;
+    uint8_t ack[V5_HEADER_LEN + 10 + V5_TRAILER_LEN];
+    size_t pos = 0;
+    ack[pos++] = 0xA5;
+    ack[pos++] = 10;
+    ack[pos++] = 0x00;
+    ack[pos++] = 0x10;
+    ack[pos++] = frame[4] - 0x30;
+    ack[pos++] = frame[5];
+    ack[pos++] = frame[6];
+    memcpy(&ack[pos], &frame[7], 4);
+    pos += 4;
+    ack[pos++] = frame[V5_HEADER_LEN];
+    ack[pos++] = 0x01;
+    for (int i = 0; i < 4; i++) {
+        ack[pos++] = (now >> (8 * i)) & 0xFF;
+    }
+    for (int i = 0; i < 4; i++) {
+        ack[pos++] = 0x00;
+    }
+    ack[pos] = ModbusCRC::sum(&ack[1], pos - 1);
+    pos++;
+    ack[pos++] = 0x15;
+    return _client->write(ack, pos) == pos;
+}
@@ -0,0 +1,129 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Conexión TCP con el datalogger
+ *
+ * SolarmanV5 solo habla con la red a través de esta interfaz. En el ESP32 la
+ * implementa WiFiTransport (WiFiClient + sockets lwip) y en el PC
+ * PosixTransport (sockets POSIX), así el protocolo se puede compilar y medir
+ * fuera de la placa.
+ */
+class Transport {
+public:
+    virtual ~Transport() {}
+
+    /**
+     * @brief Abre la conexión esperando como mucho timeout_ms
+     *
+     * @return true Si la conexión quedó abierta
+     */
+    virtual bool connect(const char *host, uint16_t port, uint32_t timeout_ms) = 0;
+
+    /**
+     * @brief Empieza a abrir la conexión sin bloquear
+     *
+     * @return true Si la conexión está en curso (ver checkConnect())
+     */
+    virtual bool startConnect(const char *host, uint16_t port) = 0;
+
+    /**
+     * @brief Comprueba una conexión lanzada con startConnect() sin bloquear
+     *
+     * @return int 1 = conectado, 0 = todavía conectando, -1 = error
+     */
+    virtual int checkConnect() = 0;
+
+    /**
+     * @brief Cierra la conexión (y cualquier conexión en curso)
+     */
+    virtual void stop() = 0;
+
+    /**
+     * @brief Indica si el socket sigue abierto
+     */
+    virtual bool connected() = 0;
+
+    /**
+     * @brief Bytes recibidos pendientes de leer
+     */
+    virtual int available() = 0;
+
+    /**
+     * @brief Lee hasta len bytes de los ya recibidos (no bloquea)
+     *
+     * @return int Bytes leídos, o <= 0 si no había nada
+     */
+    virtual int read(uint8_t *buffer, size_t len) = 0;
+
+    /**
+     * @brief Envía len bytes
+     *
+     * @return size_t Bytes enviados (menos de len si la conexión falló)
+     */
+    virtual size_t write(const uint8_t *buffer, size_t len) = 0;
+};
+
+/**
+ * @brief Puerto TCP a la escucha
+ *
+ * Lo usa SolarmanServer para recibir las tramas que el datalogger envía por
+ * su cuenta al servidor que tenga configurado.
+ */
+class Listener {
+public:
+    virtual ~Listener() {}
+
+    /**
+     * @brief Empieza a escuchar en el puerto indicado
+     *
+     * @return true Si el puerto quedó abierto
+     */
+    virtual bool begin(uint16_t port) = 0;
+
+    /**
+     * @brief Acepta una conexión entrante sin bloquear
+     *
+     * @return Transport* Nueva conexión (la libera quien la recibe), o nullptr si no hay ninguna
+     */
+    virtual Transport *accept() = 0;
+
+    /**
+     * @brief Deja de escuchar
+     */
+    virtual void stop() = 0;
+};
+
+/**
+ * @brief Reloj y esperas usados por el protocolo
+ */
+class Clock {
+public:
+    virtual ~Clock() {}
+
+    /**
+     * @brief Milisegundos desde un origen fijo (puede desbordar)
+     */
+    virtual unsigned long millis() = 0;
+
+    /**
+     * @brief Microsegundos desde un origen fijo, para medir tiempos (puede desbordar)
+     */
+    virtual unsigned long micros() = 0;
+
+    /**
+     * @brief Espera ms milisegundos
+     */
+    virtual void delay(unsigned long ms) = 0;
+};
+
+// Implementaciones de la plataforma en la que se compila (WiFiTransport.cpp
+// en el ESP32, PosixTransport.cpp en el PC)
+Transport *createDefaultTransport();
+Listener *createDefaultListener();
+Clock *defaultClock();
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef WIFITRANSPORT_H
+#define WIFITRANSPORT_H
+
+#ifdef ARDUINO
+
+#include "Transport.h"
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <WiFiServer.h>
+
+/**
+ * @brief Transporte del ESP32: WiFiClient para la conexión abierta y un
+ * socket lwip no bloqueante mientras se conecta
+ */
+class WiFiTransport : public Transport {
+private:
+    WiFiClient _client;
+    int _connect_fd;                // Socket con connect() en curso
+    char _resolved_host[64];        // Último nombre resuelto ("" = ninguno): hostByName() bloquea
+    IPAddress _resolved_ip;
+
+    void closeConnect();
+
+public:
+    WiFiTransport();
+    WiFiTransport(const WiFiClient &client);    // Conexión ya abierta (aceptada por WiFiListener)
+    ~WiFiTransport();
+
+    bool connect(const char *host, uint16_t port, uint32_t timeout_ms) override;
+    bool startConnect(const char *host, uint16_t port) override;
+    int checkConnect() override;
+    void stop() override;
+    bool connected() override { return _client.connected(); }
+    int available() override { return _client.available(); }
+    int read(uint8_t *buffer, size_t len) override { return _client.read(buffer, len); }
+    size_t write(const uint8_t *buffer, size_t len) override { return _client.write(buffer, len); }
+};
+
+/**
+ * @brief Puerto a la escucha del ESP32 sobre WiFiServer
+ */
+class WiFiListener : public Listener {
+private:
+    WiFiServer *_server;
+
+public:
+    WiFiListener();
+    ~WiFiListener();
+
+    bool begin(uint16_t port) override;
+    Transport *accept() override;
+    void stop() override;
+};
+
+// Reloj de Arduino (millis/micros/delay)
+class ArduinoClock : public Clock {
+public:
+    unsigned long millis() override { return ::millis(); }
+    unsigned long micros() override { return ::micros(); }
+    void delay(unsigned long ms) override { ::delay(ms); }
+};
+
+#endif
+
+#endif
@@ -1,73 +1,520 @@
 #ifndef DEYEINVERTER_H
 #define DEYEINVERTER_H
 
-#include "SolarmanV5.h"
-#include <Arduino.h>
+#include "RegisterReader.h"
+#include <stdint.h>
+#include <string.h>
 
+/**
+ * @brief Valor en coma fija tal y como llega del registro
+ * 
+ * Se guarda el valor bruto (2 o 4 bytes) y la escala se aplica solo al
+ * mostrarlo: valor = raw / Divisor + Offset.
+ */
+template <typename Raw, int Divisor = 1, int Offset = 0>
+struct FixedPoint {
+    static const int DIVISOR = Divisor;
+    static const int OFFSET = Offset;
+    static const bool SIGNED = (Raw)-1 < (Raw)0;
+    
+    Raw raw;
+    
+    float value() const { return (float)raw / Divisor + Offset; }
+};
+
+// Estado de la batería (registro 0x00BD)
+enum BatteryStatus : uint8_t {
+    BATTERY_CHARGE,
+    BATTERY_STANDBY,
+    BATTERY_DISCHARGE
+};
+
+// Estado de funcionamiento (registro 0x003B)
+enum RunningStatus : uint8_t {
+    RUNNING_STANDBY,
+    RUNNING_SELF_CHECK,
+    RUNNING_NORMAL,
+    RUNNING_FAULT
+};
+
+// Modo de trabajo (registro 0x00F4)
+enum WorkMode : uint8_t {
+    WORK_SELLING_FIRST,
+    WORK_ZERO_EXPORT_LOAD_SOLAR_SELL,
+    WORK_ZERO_EXPORT_HOME_SOLAR_SELL,
+    WORK_ZERO_EXPORT_LOAD,
+    WORK_ZERO_EXPORT_HOME
+};
+
+// Tipo de equipo (registro 0x0000)
+enum DeviceType : uint8_t {
+    DEVICE_STRING = 2,
+    DEVICE_HYBRID_SINGLE_PHASE = 3,
+    DEVICE_MICROINVERTER = 4,
+    DEVICE_HYBRID_THREE_PHASE_LV = 5,
+    DEVICE_HYBRID_THREE_PHASE_HV = 6
+};
+
+// Código que se guarda cuando el registro trae un valor fuera de rango de uint8_t
+const uint8_t UNKNOWN_CODE = 0xFF;
+
+// Texto de cada código ("Unknown" si no está en la tabla); no reservan memoria
+const char *batteryStatusLabel(BatteryStatus code);
+const char *runningStatusLabel(RunningStatus code);
+const char *workModeLabel(WorkMode code);
+const char *deviceTypeLabel(DeviceType code);
+
+// Muestra del inversor con los valores brutos de los registros (sin String ni float)
 struct InverterData {
     // Timestamp
     unsigned long timestamp;
     
     // Solar
-    float pv1_voltage;
-    float pv1_current;
-    float pv1_power;
-    float pv2_voltage;
-    float pv2_current;
-    float pv2_power;
-    float daily_production;
-    float total_production;
+    FixedPoint<uint16_t, 10> pv1_voltage;               // V
+    FixedPoint<uint16_t, 10> pv1_current;               // A
+    FixedPoint<uint16_t> pv1_power;                     // W
+    FixedPoint<uint16_t, 10> pv2_voltage;
+    FixedPoint<uint16_t, 10> pv2_current;
+    FixedPoint<uint16_t> pv2_power;
+    FixedPoint<uint16_t, 10> daily_production;          // kWh
+    FixedPoint<uint32_t, 10> total_production;          // kWh
     
     // Battery
-    float battery_voltage;
-    float battery_current;
-    float battery_power;
-    float battery_soc;
-    float battery_temperature;
-    String battery_status;
+    FixedPoint<uint16_t, 100> battery_voltage;          // V
+    FixedPoint<int16_t, 100> battery_current;           // A (negativo = carga)
+    FixedPoint<int16_t> battery_power;                  // W (negativo = carga)
+    FixedPoint<uint16_t> battery_soc;                   // %
+    FixedPoint<uint16_t, 10, -100> battery_temperature; // °C
+    BatteryStatus battery_status;
     
     // Grid
-    float grid_voltage_l1;
-    float grid_current_l1;
-    float grid_power;
-    float grid_frequency;
-    float daily_energy_bought;
-    float daily_energy_sold;
+    FixedPoint<uint16_t, 10> grid_voltage_l1;           // V
+    FixedPoint<uint16_t, 100> grid_current_l1;          // A
+    FixedPoint<int16_t> grid_power;                     // W (negativo = venta)
+    FixedPoint<uint16_t, 100> grid_frequency;           // Hz
+    FixedPoint<uint16_t, 10> daily_energy_bought;       // kWh
+    FixedPoint<uint16_t, 10> daily_energy_sold;         // kWh
     
     // Load
-    float load_power;
-    float load_l1_power;
-    float daily_load_consumption;
+    FixedPoint<uint16_t> load_power;                    // W
+    FixedPoint<uint16_t> load_l1_power;                 // W
+    FixedPoint<uint16_t, 10> daily_load_consumption;    // kWh
     
     // Inverter
-    String running_status;
-    String work_mode;
-    float inverter_temperature;
+    DeviceType device_type;
+    RunningStatus running_status;
+    WorkMode work_mode;
+    FixedPoint<uint16_t, 10, -100> inverter_temperature; // °C
     
     // Flags
     bool data_valid;
 };
 
+/**
+ * @brief Callback de fin de lectura asíncrona de todos los datos
+ * 
+ * @param data Estructura rellenada (data_valid indica si la lectura fue correcta)
+ * @param ctx Contexto indicado en beginReadAll()
+ */
+typedef void (*InverterDataCallback)(InverterData *data, void *ctx);
+
+// Grupos de datos (uno por cada método readXData)
+enum RegisterGroup : uint8_t {
+    GROUP_SOLAR,
+    GROUP_BATTERY,
+    GROUP_GRID,
+    GROUP_LOAD,
+    GROUP_INVERTER,
+    GROUP_COUNT
+};
+
+// Máscara con todos los grupos de datos
+const uint8_t ALL_GROUPS_MASK = (1 << GROUP_COUNT) - 1;
+
+// Frecuencia de lectura de cada registro (el periodo de cada clase se configura en DeyeInverter)
+enum PollClass : uint8_t {
+    POLL_LIVE,          // Potencias, tensiones, corrientes, SOC y estados
+    POLL_THERMAL,       // Temperaturas
+    POLL_TOTALS,        // Contadores de energía y modo de trabajo
+    POLL_STATIC,        // Identificación del equipo: una vez por arranque
+    POLL_CLASS_COUNT
+};
+
+// Máscara con todas las clases de lectura
+const uint8_t ALL_POLL_MASK = (1 << POLL_CLASS_COUNT) - 1;
+
+/**
+ * @brief Descripción de un registro del inversor y del campo que rellena
+ * 
+ * El decodificador solo copia el valor bruto; la escala y el signo los
+ * fija el tipo del campo en InverterData. La tabla integrada está en
+ * DeyeRegisters.h; otros inversores se describen con un InverterProfile.
+ */
+struct RegisterDescriptor {
+    uint16_t address;               // Dirección del registro (palabra baja si width = 2)
+    uint8_t width;                  // 1 = 16 bits, 2 = 32 bits (palabra baja primero)
+    RegisterGroup group;            // Grupo de datos al que pertenece
+    PollClass poll;                 // Frecuencia de lectura
+    uint8_t field_offset;           // Posición del campo destino en InverterData
+    uint8_t field_size;             // 1 = código de enumerado, 2 = 16 bits, 4 = 32 bits
+    uint8_t conversion;             // 0 = copia directa; si no, índice + 1 en la tabla de conversiones
+};
+
+// Máximo de códigos traducidos por enumerado en una conversión
+const uint8_t MAX_LOOKUP_CODES = 16;
+
+/**
+ * @brief Conversión del valor de un registro a la escala del campo destino
+ * 
+ * Solo hace falta cuando el perfil del inversor no coincide con el tipo
+ * del campo (otra escala, otro desplazamiento, otro ancho o enumerados con
+ * otros códigos). Se calcula al compilar el perfil y se aplica con
+ * aritmética entera: campo = (registro * mul) / div + add.
+ */
+struct ValueConversion {
+    int32_t mul;
+    int32_t div;
+    int32_t add;
+    bool raw_signed;                // Registro con signo (rule 2 y 4)
+    bool field_signed;              // Campo con signo (para saturar al rango del campo)
+    uint8_t lookup_count;           // Enumerados: códigos traducidos (0 = se copia el código)
+    uint8_t lookup[MAX_LOOKUP_CODES];
+};
+
+class InverterProfile;
+
+// Bloque de registros consecutivos que se lee en una sola petición
+struct RegisterBlock {
+    uint16_t start_addr;
+    uint16_t count;
+};
+
+// Máximo de peticiones por plan (una lectura asíncrona por bloque)
+const size_t MAX_PLAN_BLOCKS = RegisterReader::ASYNC_QUEUE_SIZE;
+
+// Peticiones necesarias para leer un conjunto de registros (ver ReadPlanner)
+struct ReadPlan {
+    RegisterBlock blocks[MAX_PLAN_BLOCKS];
+    size_t count;
+};
+
+// Un registro de la caché de DeyeInverter, en bruto (sin escala ni conversión)
+struct CachedRegister {
+    uint16_t value;
+    unsigned long timestamp;        // Reloj del lector (ms) cuando se leyó
+    uint32_t generation;            // Generación de la caché en esa lectura (0 = nunca leído)
+};
+
 class DeyeInverter {
+public:
+    static const uint16_t REGISTER_MAP_SIZE = 0x0300;  // Registros 0x0000-0x02FF (monofásicos y trifásicos)
+    
 private:
-    SolarmanV5 *_solarman;
+    RegisterReader *_reader;
+    uint16_t _regs[REGISTER_MAP_SIZE];                 // Última imagen leída de los registros
     
-    // Registros signed (según YAML)
-    bool isRegisterSigned(uint16_t register_addr);
-    String getBatteryStatus(uint16_t status);
-    String getRunningStatus(uint16_t status);
-    String getWorkMode(uint16_t mode);
+    // Caché de registros: los últimos bloques guardados por el plan, una trama de
+    // datos o requestRegisters(), cada uno con su hora y su generación. Cada
+    // registro toma la del bloque más nuevo que lo contiene
+    struct CacheEntry {
+        uint16_t start_addr;
+        uint16_t count;                                // 0 = entrada libre
+        unsigned long timestamp;
+        uint32_t generation;
+    };
+    static const size_t CACHE_ENTRIES = 2 * MAX_PLAN_BLOCKS;
+    CacheEntry _cache[CACHE_ENTRIES];
+    uint32_t _generation;                              // Bloques guardados desde el arranque
+    
+    // Lectura de registros sueltos (requestRegisters()), entre lecturas del plan
+    ReadPlan _register_queue;                          // Bloques por leer
+    ReadPlan _register_reads;                          // Bloques en lectura
+    int _register_handles[MAX_PLAN_BLOCKS];
+    uint8_t _register_pending;                         // Bloques en lectura sin contestar
+    ReadPlan _register_failed;                         // Bloques cuya última lectura falló
+    
+    // Registros que se leen y decodifican (DEYE_REGISTERS o los de un perfil)
+    const InverterProfile *_profile;
+    const RegisterDescriptor *_registers;
+    size_t _register_count;
+    const ValueConversion *_conversions;
+    uint16_t _max_span;                                // Límite pedido con setReadPlanLimits()
+    uint16_t _max_gap;
+    uint16_t _plan_span;                               // Límite de los planes actuales (también el del lector)
+    
+    // Planes de lectura, calculados una vez a partir de DEYE_REGISTERS
+    ReadPlan _group_plans[GROUP_COUNT];
+    ReadPlan _poll_plans[1 << POLL_CLASS_COUNT];       // Uno por cada combinación de clases
+    ReadPlan _push_layout;                             // Bloques de registros en las tramas de datos (0 = sin indicar)
+    
+    // Planificador de lecturas por clase
+    uint32_t _poll_periods[POLL_CLASS_COUNT];          // ms, 0 = una vez por arranque
+    unsigned long _last_poll[POLL_CLASS_COUNT];        // Último intento de lectura
+    uint8_t _attempted_mask;                           // Clases que se han intentado leer
+    uint8_t _polled_mask;                              // Clases leídas bien al menos una vez
+    
+    // Lectura asíncrona en curso
+    const ReadPlan *_async_plan;
+    int _async_handles[MAX_PLAN_BLOCKS];               // Handle de cada bloque del plan (-1 = no encolado)
+    InverterData *_async_data;
+    InverterDataCallback _async_callback;
+    void *_async_ctx;
+    uint8_t _async_pending;
+    uint8_t _async_poll_mask;
+    bool _async_ok;
+    unsigned long _async_started_us;
+    
+    // Duración de los ciclos de lectura
+    LatencyHistogram _cycle_stats;
+    uint32_t _failed_cycles;
+    
+    static void onBlockRead(int handle, bool ok, void *ctx);
+    void finishAsyncRead();
+    static void onRegistersRead(int handle, bool ok, void *ctx);
+    void startRegisterReads();
+    
+    bool buildPlans(uint16_t max_span, uint16_t max_gap);
+    void followReaderSpan();
+    bool fetchPlan(const ReadPlan &plan);
+    void markPolled(uint8_t poll_mask, bool ok);
+    void storeBlock(uint16_t start_addr, uint16_t count);
+    const CacheEntry *findCached(uint16_t addr);
+    bool isCached(uint16_t addr, unsigned long now, uint32_t max_age_ms, uint32_t min_generation);
+    void decodeRegister(const RegisterDescriptor &reg, InverterData *data);
+    void convertRegister(const RegisterDescriptor &reg, uint32_t raw, uint8_t *field);
+    void decode(uint8_t group_mask, uint8_t poll_mask, InverterData *data);
     
 public:
-    DeyeInverter(SolarmanV5 *solarman);
+    static const uint16_t DEFAULT_MAX_SPAN = RegisterReader::MAX_REGISTERS_PER_READ;
+    static const uint16_t DEFAULT_MAX_GAP = 10;     // ~20 bytes de más frente a otra petición completa
+    static const uint32_t UNREAD_RETRY_MS = 5000;   // Reintento de las clases que aún no se han leído
+    
+    // Periodos por defecto de cada clase (ms)
+    static const uint32_t DEFAULT_LIVE_PERIOD = 2000;
+    static const uint32_t DEFAULT_THERMAL_PERIOD = 30000;
+    static const uint32_t DEFAULT_TOTALS_PERIOD = 60000;
+    
+    // Resultado de requestRegisters()
+    enum RegisterRequest {
+        REGISTERS_CACHED,           // Todos recientes en la caché (getCachedRegister())
+        REGISTERS_PENDING,          // Lectura encolada o en curso; la avanza poll()
+        REGISTERS_FAILED,           // Falló la última lectura de alguno (la próxima petición la repite)
+        REGISTERS_REJECTED          // Rango fuera del mapa o cola llena
+    };
+    
+    DeyeInverter(RegisterReader *reader);
     
     bool readAllData(InverterData *data);
+    
+    /**
+     * @brief Lee solo los registros de las clases indicadas
+     * 
+     * Los campos de las demás clases conservan su valor. data_valid solo es
+     * true cuando todas las clases se han leído bien al menos una vez.
+     * 
+     * @param poll_mask Clases a leer (bit 1 << PollClass), p.ej. getDueClasses()
+     * @param data Estructura a rellenar
+     * @return true Si la lectura fue correcta
+     */
+    bool readClasses(uint8_t poll_mask, InverterData *data);
     bool readSolarData(InverterData *data);
     bool readBatteryData(InverterData *data);
     bool readGridData(InverterData *data);
     bool readLoadData(InverterData *data);
     bool readInverterData(InverterData *data);
     
+    /**
+     * @brief Lanza la lectura de todos los datos sin bloquear
+     * 
+     * La lectura avanza con poll(); al terminar se rellena `data` y se llama
+     * al callback. `data` no se toca hasta que la lectura ha terminado.
+     * 
+     * @param data Estructura a rellenar (debe seguir viva hasta el final)
+     * @param callback Función a la que se llama al terminar (opcional)
+     * @param ctx Contexto que se pasa al callback
+     * @return true Si la lectura se ha lanzado
+     * @return false Si ya había una lectura en curso
+     */
+    bool beginReadAll(InverterData *data, InverterDataCallback callback = nullptr, void *ctx = nullptr);
+    
+    /**
+     * @brief Como beginReadAll(), pero solo con las clases indicadas
+     * 
+     * @param poll_mask Clases a leer (bit 1 << PollClass), p.ej. getDueClasses()
+     * @return false Si ya había una lectura en curso o la máscara está vacía
+     */
+    bool beginReadClasses(uint8_t poll_mask, InverterData *data, InverterDataCallback callback = nullptr, void *ctx = nullptr);
+    
+    /**
+     * @brief Clases cuyo periodo ha vencido
+     * 
+     * Las clases que todavía no se han leído bien se reintentan cada
+     * UNREAD_RETRY_MS (o su periodo, si es menor).
+     * 
+     * @return Máscara de clases a leer (0 si no toca leer nada)
+     */
+    uint8_t getDueClasses();
+    
+    /**
+     * @brief Cambia el periodo de lectura de una clase
+     * 
+     * @param poll_class Clase de registros
+     * @param period_ms Periodo en ms (0 = solo una vez por arranque)
+     */
+    void setPollPeriod(PollClass poll_class, uint32_t period_ms) {
+        if (poll_class < POLL_CLASS_COUNT) _poll_periods[poll_class] = period_ms;
+    }
+    
+    /**
+     * @brief Pide registros en bruto sin bloquear: de la caché si son recientes
+     * 
+     * Cada bloque que llega (por el plan de lectura, una trama de datos del
+     * datalogger o esta misma petición) queda en la caché con su hora y una
+     * generación nueva. Los registros del rango que no son recientes se
+     * encolan, agrupando los que estén cerca como ReadPlanner y sin pasar de
+     * getPlanSpan() registros por petición; poll() los lee cuando no hay una
+     * lectura del plan en curso. Se vuelve a llamar con los mismos argumentos
+     * hasta que no devuelva REGISTERS_PENDING: los bloques ya encolados no se
+     * repiten.
+     * 
+     * @param start_addr Primer registro (el rango tiene que caber en REGISTER_MAP_SIZE)
+     * @param count Número de registros
+     * @param max_age_ms Antigüedad máxima de un registro para ser reciente (0 = no cuenta la antigüedad)
+     * @param min_generation También es reciente un registro de esta generación o posterior
+     *        (0 = no cuenta la generación). Con getCacheGeneration() + 1 de la primera
+     *        llamada, las siguientes dan por buenos los registros que ha traído su lectura
+     * @return RegisterRequest
+     */
+    RegisterRequest requestRegisters(uint16_t start_addr, uint16_t count, uint32_t max_age_ms,
+                                     uint32_t min_generation = 0);
+    
+    /**
+     * @brief Copia un registro de la caché, sin preguntar al inversor
+     * 
+     * @return false Si está fuera del mapa o no está en ningún bloque de la caché
+     */
+    bool getCachedRegister(uint16_t addr, CachedRegister *out);
+    
+    /**
+     * @brief Generación actual de la caché (aumenta con cada bloque guardado)
+     */
+    uint32_t getCacheGeneration() { return _generation; }
+    
+    /**
+     * @brief Avanza la lectura asíncrona en curso y lanza la de registros encolados (no bloquea)
+     */
+    void poll();
+    
+    /**
+     * @brief Indica si hay una lectura asíncrona en curso (del plan o de requestRegisters())
+     */
+    bool isReading() { return _async_data != nullptr || _register_pending > 0; }
+    
+    /**
+     * @brief Reloj del lector de registros (el de InverterData::timestamp)
+     */
+    Clock *getClock() { return _reader->getClock(); }
+    
+    /**
+     * @brief Lector de registros del inversor
+     */
+    RegisterReader *getReader() { return _reader; }
+    
+    /**
+     * @brief Recalcula los planes de lectura con otros límites
+     * 
+     * Si el lector admite menos registros por petición (getMaxSpan()), los
+     * planes usan ese límite; readClasses() y beginReadClasses() los vuelven
+     * a calcular cuando el lector lo cambia.
+     * 
+     * @param max_span Máximo de registros por petición (hasta MAX_REGISTERS_PER_READ)
+     * @param max_gap Máximo de registros no deseados que se leen para no partir un bloque
+     * @return true Si los planes caben en MAX_PLAN_BLOCKS peticiones
+     * @return false Si no caben o hay una lectura en curso (se mantienen los anteriores)
+     */
+    bool setReadPlanLimits(uint16_t max_span, uint16_t max_gap);
+    
+    /**
+     * @brief Cambia los registros que se leen y cómo se decodifican
+     * 
+     * Recalcula los planes de lectura con los límites actuales y da por no
+     * leídas todas las clases. La disposición de las tramas de datos no
+     * cambia. El perfil tiene que seguir vivo mientras se use.
+     * 
+     * @param profile Perfil compilado, o nullptr para la tabla integrada (DEYE_REGISTERS)
+     * @return false Si hay una lectura en curso o el plan no cabe en MAX_PLAN_BLOCKS
+     *         peticiones (se mantiene el perfil anterior)
+     */
+    bool setProfile(const InverterProfile *profile);
+    
+    /**
+     * @brief Perfil en uso (nullptr = tabla integrada)
+     */
+    const InverterProfile *getProfile() { return _profile; }
+    
+    /**
+     * @brief Plan de lectura usado por readAllData() y beginReadAll()
+     */
+    const ReadPlan &getReadPlan() { return _poll_plans[ALL_POLL_MASK]; }
+    
+    /**
+     * @brief Máximo de registros por petición de los planes actuales
+     */
+    uint16_t getPlanSpan() { return _plan_span; }
+    
+    /**
+     * @brief Duración de los ciclos de lectura (readClasses() o beginReadClasses()
+     *        hasta el callback), fallen o no
+     */
+    LatencyHistogram &getCycleStats() { return _cycle_stats; }
+    
+    /**
+     * @brief Número de ciclos de lectura en los que falló algún bloque
+     */
+    uint32_t getFailedCycles() { return _failed_cycles; }
+    
+    // ============================================================================
+    // DATOS ENVIADOS POR EL DATALOGGER (SolarmanServer)
+    // ============================================================================
+    
+    /**
+     * @brief Decodifica los datos de una trama enviada por el datalogger
+     * 
+     * Los datos son registros de 16 bits big-endian, uno tras otro, en el
+     * orden de los bloques de la disposición (ver setPushLayout()). Solo se
+     * actualizan los campos cuyos registros vienen en la trama. Sin
+     * disposición no se toca nada: la trama no cuenta como datos válidos.
+     * 
+     * @param payload Datos de la trama (SolarmanDataCallback)
+     * @param len Longitud de los datos
+     * @param data Estructura a actualizar
+     * @return true Si hay disposición y la trama trae todos sus bloques
+     */
+    bool decodePush(const uint8_t *payload, size_t len, InverterData *data);
+    
+    /**
+     * @brief Cambia la disposición de los registros en las tramas de datos
+     * 
+     * Depende del firmware del datalogger y no está documentada, así que no
+     * hay ninguna por defecto: hasta que se indica, decodePush() descarta las
+     * tramas. push_listen muestra lo que envía un datalogger concreto.
+     * 
+     * @param blocks Bloques en el orden en que vienen en la trama
+     * @param count Número de bloques (hasta MAX_PLAN_BLOCKS; 0 = sin disposición)
+     * @return false Si hay demasiados bloques o alguno se sale del mapa de registros
+     */
+    bool setPushLayout(const RegisterBlock *blocks, size_t count);
+    
+    /**
+     * @brief Disposición usada por decodePush()
+     */
+    const ReadPlan &getPushLayout() { return _push_layout; }
+    
+    /**
+     * @brief Indica si se ha indicado la disposición de las tramas de datos
+     */
+    bool hasPushLayout() { return _push_layout.count > 0; }
+    
     // Métodos de utilidad
     static float applyScaleAndOffset(uint16_t value, float scale, int16_t offset = 0, bool is_signed = false);
 };
@@ -0,0 +1,100 @@
+#ifndef DEYEREGISTERS_H
+#define DEYEREGISTERS_H
+
+#include "DeyeInverter.h"
+#include <stddef.h>
+
+// Textos de los registros enumerados
+constexpr const char* DEVICE_TYPE_LABELS[] = {
+    "Unknown",                          // 0
+    "Unknown",                          // 1
+    "String",                           // 2
+    "Single-phase Hybrid",              // 3
+    "Microinverter",                    // 4
+    "Three-phase LV Hybrid",            // 5
+    "Three-phase HV Hybrid"             // 6
+};
+
+constexpr const char* BATTERY_STATUS_LABELS[] = {
+    "Charge",                           // 0
+    "Stand-by",                         // 1
+    "Discharge"                         // 2
+};
+
+constexpr const char* RUNNING_STATUS_LABELS[] = {
+    "Stand-by",                         // 0
+    "Self-checking",                    // 1
+    "Normal",                           // 2
+    "FAULT"                             // 3
+};
+
+constexpr const char* WORK_MODE_LABELS[] = {
+    "Selling First",                    // 0
+    "Zero-Export to Load&Solar Sell",   // 1
+    "Zero-Export to Home&Solar Sell",   // 2
+    "Zero-Export to Load",              // 3
+    "Zero-Export to Home"               // 4
+};
+
+// Texto de un código, o "Unknown" si no está en la tabla
+template <size_t N>
+constexpr const char *labelFor(const char* const (&labels)[N], uint8_t code) {
+    return code < N ? labels[code] : "Unknown";
+}
+
+// Registro que rellena el campo `field` de InverterData (32 bits si el campo ocupa 4 bytes)
+constexpr RegisterDescriptor deyeRegister(RegisterGroup group, PollClass poll, uint16_t address,
+                                          size_t field_offset, size_t field_size) {
+    return RegisterDescriptor{address, (uint8_t)(field_size == 4 ? 2 : 1), group, poll,
+                              (uint8_t)field_offset, (uint8_t)field_size, 0};
+}
+
+#define INVERTER_FIELD(field) offsetof(InverterData, field), sizeof(InverterData::field)
+
+static_assert(sizeof(InverterData) <= 0xFF, "field_offset no cabe en 8 bits");
+
+// Registros del inversor Deye híbrido (según YAML de HA solarman)
+constexpr RegisterDescriptor DEYE_REGISTERS[] = {
+    // Solar
+    deyeRegister(GROUP_SOLAR,    POLL_LIVE,    0x006D, INVERTER_FIELD(pv1_voltage)),
+    deyeRegister(GROUP_SOLAR,    POLL_LIVE,    0x006E, INVERTER_FIELD(pv1_current)),
+    deyeRegister(GROUP_SOLAR,    POLL_LIVE,    0x006F, INVERTER_FIELD(pv2_voltage)),
+    deyeRegister(GROUP_SOLAR,    POLL_LIVE,    0x0070, INVERTER_FIELD(pv2_current)),
+    deyeRegister(GROUP_SOLAR,    POLL_LIVE,    0x00BA, INVERTER_FIELD(pv1_power)),
+    deyeRegister(GROUP_SOLAR,    POLL_LIVE,    0x00BB, INVERTER_FIELD(pv2_power)),
+    deyeRegister(GROUP_SOLAR,    POLL_TOTALS,  0x006C, INVERTER_FIELD(daily_production)),
+    // 32 bits (0x0060-0x0061): el campo ya estaba en InverterData pero no se leía
+    deyeRegister(GROUP_SOLAR,    POLL_TOTALS,  0x0060, INVERTER_FIELD(total_production)),
+    
+    // Battery
+    deyeRegister(GROUP_BATTERY,  POLL_LIVE,    0x00B7, INVERTER_FIELD(battery_voltage)),
+    deyeRegister(GROUP_BATTERY,  POLL_LIVE,    0x00B8, INVERTER_FIELD(battery_soc)),
+    deyeRegister(GROUP_BATTERY,  POLL_LIVE,    0x00BE, INVERTER_FIELD(battery_power)),
+    deyeRegister(GROUP_BATTERY,  POLL_LIVE,    0x00BF, INVERTER_FIELD(battery_current)),
+    deyeRegister(GROUP_BATTERY,  POLL_LIVE,    0x00BD, INVERTER_FIELD(battery_status)),
+    deyeRegister(GROUP_BATTERY,  POLL_THERMAL, 0x00B6, INVERTER_FIELD(battery_temperature)),
+    
+    // Grid
+    deyeRegister(GROUP_GRID,     POLL_LIVE,    0x00A9, INVERTER_FIELD(grid_power)),
+    deyeRegister(GROUP_GRID,     POLL_LIVE,    0x0096, INVERTER_FIELD(grid_voltage_l1)),
+    deyeRegister(GROUP_GRID,     POLL_LIVE,    0x00A0, INVERTER_FIELD(grid_current_l1)),
+    deyeRegister(GROUP_GRID,     POLL_LIVE,    0x004F, INVERTER_FIELD(grid_frequency)),
+    deyeRegister(GROUP_GRID,     POLL_TOTALS,  0x004C, INVERTER_FIELD(daily_energy_bought)),
+    deyeRegister(GROUP_GRID,     POLL_TOTALS,  0x004D, INVERTER_FIELD(daily_energy_sold)),
+    
+    // Load
+    deyeRegister(GROUP_LOAD,     POLL_LIVE,    0x00B2, INVERTER_FIELD(load_power)),
+    deyeRegister(GROUP_LOAD,     POLL_LIVE,    0x00B0, INVERTER_FIELD(load_l1_power)),
+    deyeRegister(GROUP_LOAD,     POLL_TOTALS,  0x0054, INVERTER_FIELD(daily_load_consumption)),
+    
+    // Inverter
+    // Tipo de equipo: una petición más al arrancar, aparte del resto de tramos
+    deyeRegister(GROUP_INVERTER, POLL_STATIC,  0x0000, INVERTER_FIELD(device_type)),
+    deyeRegister(GROUP_INVERTER, POLL_LIVE,    0x003B, INVERTER_FIELD(running_status)),
+    deyeRegister(GROUP_INVERTER, POLL_TOTALS,  0x00F4, INVERTER_FIELD(work_mode)),
+    deyeRegister(GROUP_INVERTER, POLL_THERMAL, 0x005A, INVERTER_FIELD(inverter_temperature)),
+};
+
+constexpr size_t DEYE_REGISTER_COUNT = sizeof(DEYE_REGISTERS) / sizeof(DEYE_REGISTERS[0]);
+
+#endif
@@ -0,0 +1,36 @@
+#ifdef ARDUINO
+
+#include "HardwareSerialPort.h"
+
+HardwareSerialPort::HardwareSerialPort(HardwareSerial *serial, int8_t rx_pin, int8_t tx_pin, int8_t de_pin) {
+    _serial = serial;
+    _rx_pin = rx_pin;
+    _tx_pin = tx_pin;
+    _de_pin = de_pin;
+}
+
+bool HardwareSerialPort::begin(uint32_t baud) {
+    if (_de_pin >= 0) {
+        pinMode(_de_pin, OUTPUT);
+        digitalWrite(_de_pin, LOW);
+    }
+    _serial->begin(baud, SERIAL_8N1, _rx_pin, _tx_pin);
+    // Entregar cada byte en cuanto llega, sin esperar a llenar la FIFO de la UART
+    _serial->setRxFIFOFull(1);
+    return true;
+}
+
+size_t HardwareSerialPort::write(const uint8_t *buffer, size_t len) {
+    if (_de_pin >= 0) {
+        digitalWrite(_de_pin, HIGH);
+    }
+    size_t sent = _serial->write(buffer, len);
+    // flush() espera a que el último bit salga del registro de desplazamiento
+    _serial->flush();
+    if (_de_pin >= 0) {
+        digitalWrite(_de_pin, LOW);
+    }
+    return sent;
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef HARDWARESERIALPORT_H
+#define HARDWARESERIALPORT_H
+
+#ifdef ARDUINO
+
+#include "SerialPort.h"
+#include <Arduino.h>
+#include <HardwareSerial.h>
+
+/**
+ * @brief Puerto serie del ESP32: UART hardware con transceptor RS485
+ *
+ * Si el transceptor (MAX485 y similares) tiene los pines DE/RE unidos a un
+ * GPIO, se activa la transmisión solo mientras se envía. Con módulos de
+ * conmutación automática se indica de_pin = -1.
+ */
+class HardwareSerialPort : public SerialPort {
+private:
+    HardwareSerial *_serial;
+    int8_t _rx_pin;
+    int8_t _tx_pin;
+    int8_t _de_pin;                 // Pin DE/RE del transceptor (-1 = automático)
+
+public:
+    HardwareSerialPort(HardwareSerial *serial, int8_t rx_pin, int8_t tx_pin, int8_t de_pin = -1);
+
+    bool begin(uint32_t baud) override;
+    int available() override { return _serial->available(); }
+    int read(uint8_t *buffer, size_t len) override { return _serial->read(buffer, len); }
+    size_t write(const uint8_t *buffer, size_t len) override;
+};
+
+#endif
+
+#endif
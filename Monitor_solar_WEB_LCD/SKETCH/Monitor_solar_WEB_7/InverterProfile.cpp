@@ -0,0 +1,589 @@
+#include "InverterProfile.h"
+#include "DeyeRegisters.h"
+#include <stdlib.h>
+
+/**
+ * @brief Campo de InverterData al que puede apuntar un elemento del perfil
+ *
+ * La escala, el desplazamiento y el signo salen del tipo FixedPoint del
+ * campo; los enumerados llevan su tabla de textos.
+ */
+struct ProfileField {
+    const char *name;
+    uint8_t offset;
+    uint8_t size;
+    int16_t divisor;
+    int16_t value_offset;
+    bool is_signed;
+    const char *const *labels;
+    uint8_t label_count;
+};
+
+#define NUMERIC_FIELD(field) \
+    {#field, offsetof(InverterData, field), sizeof(InverterData::field), decltype(InverterData::field)::DIVISOR, \
+     decltype(InverterData::field)::OFFSET, decltype(InverterData::field)::SIGNED, nullptr, 0}
+#define ENUM_FIELD(field, labels) \
+    {#field, offsetof(InverterData, field), 1, 1, 0, false, labels, sizeof(labels) / sizeof(labels[0])}
+
+static const ProfileField PROFILE_FIELDS[] = {
+    NUMERIC_FIELD(pv1_voltage),
+    NUMERIC_FIELD(pv1_current),
+    NUMERIC_FIELD(pv1_power),
+    NUMERIC_FIELD(pv2_voltage),
+    NUMERIC_FIELD(pv2_current),
+    NUMERIC_FIELD(pv2_power),
+    NUMERIC_FIELD(daily_production),
+    NUMERIC_FIELD(total_production),
+    NUMERIC_FIELD(battery_voltage),
+    NUMERIC_FIELD(battery_current),
+    NUMERIC_FIELD(battery_power),
+    NUMERIC_FIELD(battery_soc),
+    NUMERIC_FIELD(battery_temperature),
+    ENUM_FIELD(battery_status, BATTERY_STATUS_LABELS),
+    NUMERIC_FIELD(grid_voltage_l1),
+    NUMERIC_FIELD(grid_current_l1),
+    NUMERIC_FIELD(grid_power),
+    NUMERIC_FIELD(grid_frequency),
+    NUMERIC_FIELD(daily_energy_bought),
+    NUMERIC_FIELD(daily_energy_sold),
+    NUMERIC_FIELD(load_power),
+    NUMERIC_FIELD(load_l1_power),
+    NUMERIC_FIELD(daily_load_consumption),
+    ENUM_FIELD(device_type, DEVICE_TYPE_LABELS),
+    ENUM_FIELD(running_status, RUNNING_STATUS_LABELS),
+    ENUM_FIELD(work_mode, WORK_MODE_LABELS),
+    NUMERIC_FIELD(inverter_temperature),
+};
+
+static const size_t PROFILE_FIELD_COUNT = sizeof(PROFILE_FIELDS) / sizeof(PROFILE_FIELDS[0]);
+
+static_assert(PROFILE_FIELD_COUNT <= InverterProfile::MAX_REGISTERS, "MAX_REGISTERS menor que el número de campos");
+
+// Nombres de los descriptores de HA que no coinciden con el del campo
+static const char *const PROFILE_ALIASES[][2] = {
+    {"total_grid_power", "grid_power"},
+    {"total_load_power", "load_power"},
+    {"dc_temperature", "inverter_temperature"},
+};
+
+static const char *const GROUP_NAMES[GROUP_COUNT] = {"solar", "battery", "grid", "load", "inverter"};
+static const char *const POLL_NAMES[POLL_CLASS_COUNT] = {"live", "thermal", "totals", "static"};
+
+const char *profileErrorLabel(ProfileError error) {
+    switch (error) {
+        case PROFILE_OK: return "OK";
+        case PROFILE_BAD_NUMBER: return "Número no válido";
+        case PROFILE_BAD_REGISTERS: return "Registros no válidos para la regla";
+        case PROFILE_BAD_ADDRESS: return "Registro fuera del mapa";
+        case PROFILE_BAD_LOOKUP: return "Código de enumerado no válido";
+        case PROFILE_BAD_SCALE: return "Escala no válida";
+        case PROFILE_EMPTY: return "Ningún registro reconocido";
+    }
+    return "Unknown";
+}
+
+// ============================================================================
+// UTILIDADES DE TEXTO
+// ============================================================================
+
+static char lowerChar(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char *skipSpaces(const char *p, const char *end) {
+    while (p < end && isSpace(*p)) p++;
+    return p;
+}
+
+static const char *trimEnd(const char *begin, const char *end) {
+    while (end > begin && isSpace(end[-1])) end--;
+    return end;
+}
+
+// Quita las comillas de un valor ya recortado
+static void unquote(const char **begin, const char **end) {
+    if (*end - *begin >= 2 && (**begin == '"' || **begin == '\'') && (*end)[-1] == **begin) {
+        (*begin)++;
+        (*end)--;
+    }
+}
+
+static bool equalsIgnoreCase(const char *a, size_t a_len, const char *b) {
+    size_t i = 0;
+    for (; i < a_len && b[i]; i++) {
+        if (lowerChar(a[i]) != lowerChar(b[i])) return false;
+    }
+    return i == a_len && b[i] == '\0';
+}
+
+static bool keyIs(const char *key, size_t key_len, const char *name) {
+    return equalsIgnoreCase(key, key_len, name);
+}
+
+// "PV1 Power" → "pv1_power"
+static void normalizeName(const char *begin, const char *end, char *out, size_t size) {
+    size_t pos = 0;
+    bool pending_sep = false;
+    for (const char *p = begin; p < end && pos + 1 < size; p++) {
+        char c = lowerChar(*p);
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) {
+            if (pending_sep && pos > 0 && pos + 2 < size) out[pos++] = '_';
+            out[pos++] = c;
+            pending_sep = false;
+        } else {
+            pending_sep = true;
+        }
+    }
+    out[pos] = '\0';
+}
+
+// Entero decimal o hexadecimal (0x..), con signo opcional
+static bool parseInt(const char *begin, const char *end, int32_t *out) {
+    begin = skipSpaces(begin, end);
+    end = trimEnd(begin, end);
+    bool negative = false;
+    if (begin < end && (*begin == '-' || *begin == '+')) {
+        negative = *begin == '-';
+        begin++;
+    }
+    int base = 10;
+    if (end - begin > 2 && begin[0] == '0' && lowerChar(begin[1]) == 'x') {
+        base = 16;
+        begin += 2;
+    }
+    if (begin == end) return false;
+    int64_t value = 0;
+    for (const char *p = begin; p < end; p++) {
+        char c = lowerChar(*p);
+        int digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (base == 16 && c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else return false;
+        value = value * base + digit;
+        if (value > 0x7FFFFFFF) return false;
+    }
+    *out = negative ? -value : value;
+    return true;
+}
+
+// Número decimal como fracción exacta: "0.1" → 1/10, "-2.5" → -25/10
+static bool parseDecimal(const char *begin, const char *end, int32_t *num, int32_t *den) {
+    begin = skipSpaces(begin, end);
+    end = trimEnd(begin, end);
+    const char *dot = begin;
+    while (dot < end && *dot != '.') dot++;
+    if (dot == end) {
+        *den = 1;
+        return parseInt(begin, end, num);
+    }
+
+    int32_t integer = 0;
+    bool negative = begin < dot && *begin == '-';
+    if (dot > begin + (negative || *begin == '+') && !parseInt(begin, dot, &integer)) return false;
+    int64_t value = integer < 0 ? -integer : integer;
+    int64_t scale = 1;
+    for (const char *p = dot + 1; p < end; p++) {
+        if (*p < '0' || *p > '9' || scale >= 1000000) return false;
+        value = value * 10 + (*p - '0');
+        scale *= 10;
+    }
+    if (value > 0x7FFFFFFF) return false;
+    *num = negative ? -value : value;
+    *den = scale;
+    return true;
+}
+
+static int64_t gcd(int64_t a, int64_t b) {
+    if (a < 0) a = -a;
+    if (b < 0) b = -b;
+    while (b != 0) {
+        int64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a == 0 ? 1 : a;
+}
+
+static const ProfileField *findField(const char *name) {
+    for (size_t a = 0; a < sizeof(PROFILE_ALIASES) / sizeof(PROFILE_ALIASES[0]); a++) {
+        if (strcmp(name, PROFILE_ALIASES[a][0]) == 0) {
+            name = PROFILE_ALIASES[a][1];
+            break;
+        }
+    }
+    for (size_t f = 0; f < PROFILE_FIELD_COUNT; f++) {
+        if (strcmp(name, PROFILE_FIELDS[f].name) == 0) return &PROFILE_FIELDS[f];
+    }
+    return nullptr;
+}
+
+// Grupo y clase del campo en la tabla integrada (valores por defecto del perfil)
+static const RegisterDescriptor *findBuiltin(uint8_t field_offset) {
+    for (size_t i = 0; i < DEYE_REGISTER_COUNT; i++) {
+        if (DEYE_REGISTERS[i].field_offset == field_offset) return &DEYE_REGISTERS[i];
+    }
+    return nullptr;
+}
+
+static int8_t findName(const char *const *names, size_t count, const char *begin, const char *end) {
+    for (size_t i = 0; i < count; i++) {
+        if (equalsIgnoreCase(begin, end - begin, names[i])) return i;
+    }
+    return -1;
+}
+
+// ============================================================================
+// COMPILACIÓN
+// ============================================================================
+
+InverterProfile::InverterProfile() {
+    strcpy(_name, "custom");
+    _register_count = 0;
+    _conversion_count = 0;
+    _skipped_count = 0;
+    _error = PROFILE_OK;
+    _error_line = 0;
+    _item.active = false;
+    _group = -1;
+    _lookup_indent = -1;
+    _lookup_key = -1;
+}
+
+bool InverterProfile::fail(ProfileError error, int line) {
+    _error = error;
+    _error_line = line;
+    _register_count = 0;
+    _conversion_count = 0;
+    return false;
+}
+
+bool InverterProfile::compile(const char *text, size_t len) {
+    strcpy(_name, "custom");
+    _register_count = 0;
+    _conversion_count = 0;
+    _skipped_count = 0;
+    _error = PROFILE_OK;
+    _error_line = 0;
+    _item.active = false;
+    _group = -1;
+    _lookup_indent = -1;
+    _lookup_key = -1;
+
+    const char *end = text + len;
+    int line_number = 0;
+    for (const char *line = text; line < end;) {
+        const char *line_end = line;
+        while (line_end < end && *line_end != '\n') line_end++;
+        line_number++;
+        if (!parseLine(line, line_end, line_number)) {
+            return false;
+        }
+        line = line_end + 1;
+    }
+    if (!finishItem()) {
+        return false;
+    }
+    if (_register_count == 0) {
+        return fail(PROFILE_EMPTY, 0);
+    }
+    return true;
+}
+
+bool InverterProfile::parseLine(const char *line, const char *end, int line_number) {
+    // Comentarios: '#' al principio o tras un espacio, fuera de comillas
+    char quote = 0;
+    for (const char *p = line; p < end; p++) {
+        if (quote) {
+            if (*p == quote) quote = 0;
+        } else if (*p == '"' || *p == '\'') {
+            quote = *p;
+        } else if (*p == '#' && (p == line || isSpace(p[-1]))) {
+            end = p;
+            break;
+        }
+    }
+    end = trimEnd(line, end);
+
+    const char *key = skipSpaces(line, end);
+    if (key == end) {
+        return true;
+    }
+    if (*key == '-') {
+        key = skipSpaces(key + 1, end);     // Elemento de lista: la clave empieza tras el guion
+    }
+    int indent = key - line;
+
+    const char *colon = key;
+    while (colon < end && *colon != ':') colon++;
+    if (colon == end) {
+        return true;                        // Sin clave (lista en bloque u otra sintaxis que no se usa)
+    }
+    size_t key_len = trimEnd(key, colon) - key;
+    const char *value = skipSpaces(colon + 1, end);
+
+    // Dentro de `lookup` todo lo que esté más a la derecha son códigos
+    if (_lookup_indent >= 0) {
+        if (indent > _lookup_indent) {
+            return parseLookupEntry(key, key_len, value, end) || fail(_error, line_number);
+        }
+        _lookup_indent = -1;
+    }
+
+    if (indent == 0) {
+        if (keyIs(key, key_len, "name")) {
+            unquote(&value, &end);
+            size_t n = end - value;
+            if (n > MAX_NAME_LEN - 1) n = MAX_NAME_LEN - 1;
+            memcpy(_name, value, n);
+            _name[n] = '\0';
+        }
+        return finishItem();                // Sección nueva (parameters, requests...)
+    }
+
+    if (keyIs(key, key_len, "group")) {
+        if (!finishItem()) return false;
+        unquote(&value, &end);
+        _group = findName(GROUP_NAMES, GROUP_COUNT, value, end);
+        return true;
+    }
+    if (keyIs(key, key_len, "name")) {
+        if (!finishItem()) return false;
+        unquote(&value, &end);
+        memset(&_item, 0, sizeof(_item));
+        _item.active = true;
+        _item.line = line_number;
+        _item.scale_num = 1;
+        _item.scale_den = 1;
+        _item.poll = -1;
+        _item.group = _group;
+        normalizeName(value, end, _item.field, sizeof(_item.field));
+        return true;
+    }
+    if (!_item.active) {
+        return true;
+    }
+    if (keyIs(key, key_len, "lookup") && value == end) {
+        _lookup_indent = indent;
+        _lookup_key = -1;
+        return true;
+    }
+    return parseItemKey(key, key_len, value, end) || fail(_error, line_number);
+}
+
+bool InverterProfile::parseItemKey(const char *key, size_t key_len, const char *value, const char *end) {
+    int32_t number;
+    if (keyIs(key, key_len, "rule")) {
+        if (!parseInt(value, end, &number) || number < 0 || number > 0xFF) {
+            _error = PROFILE_BAD_NUMBER;
+            return false;
+        }
+        _item.rule = number;
+    } else if (keyIs(key, key_len, "registers")) {
+        // Lista en línea: [0x0060, 0x0061]
+        if (value == end || *value != '[' || end[-1] != ']') {
+            _error = PROFILE_BAD_REGISTERS;
+            return false;
+        }
+        const char *p = value + 1;
+        const char *list_end = end - 1;
+        _item.register_count = 0;
+        while (p < list_end) {
+            const char *comma = p;
+            while (comma < list_end && *comma != ',') comma++;
+            if (!parseInt(p, comma, &number) || number < 0 || number > 0xFFFF) {
+                _error = PROFILE_BAD_NUMBER;
+                return false;
+            }
+            // Solo se guardan dos: más registros solo tienen sentido en reglas de texto, que se ignoran
+            if (_item.register_count < 2) _item.registers[_item.register_count] = number;
+            if (_item.register_count < 0xFF) _item.register_count++;
+            p = comma + 1;
+        }
+    } else if (keyIs(key, key_len, "scale")) {
+        if (!parseDecimal(value, end, &_item.scale_num, &_item.scale_den)) {
+            _error = PROFILE_BAD_NUMBER;
+            return false;
+        }
+    } else if (keyIs(key, key_len, "offset")) {
+        if (!parseInt(value, end, &_item.offset)) {
+            _error = PROFILE_BAD_NUMBER;
+            return false;
+        }
+    } else if (keyIs(key, key_len, "field")) {
+        unquote(&value, &end);
+        normalizeName(value, end, _item.field, sizeof(_item.field));
+    } else if (keyIs(key, key_len, "poll")) {
+        unquote(&value, &end);
+        _item.poll = findName(POLL_NAMES, POLL_CLASS_COUNT, value, end);
+    } else if (keyIs(key, key_len, "lookup")) {
+        // Tabla en línea: {0: "Charge", 1: "Stand-by"}
+        if (*value != '{' || end[-1] != '}') {
+            _error = PROFILE_BAD_LOOKUP;
+            return false;
+        }
+        const char *p = value + 1;
+        const char *map_end = end - 1;
+        while (p < map_end) {
+            const char *comma = p;
+            char quote = 0;
+            while (comma < map_end && (quote || *comma != ',')) {
+                if (quote && *comma == quote) quote = 0;
+                else if (!quote && (*comma == '"' || *comma == '\'')) quote = *comma;
+                comma++;
+            }
+            const char *colon = p;
+            while (colon < comma && *colon != ':') colon++;
+            if (colon == comma || !parseInt(p, colon, &number) || !addLookup(number, colon + 1, comma)) {
+                if (_error == PROFILE_OK) _error = PROFILE_BAD_LOOKUP;
+                return false;
+            }
+            p = comma + 1;
+        }
+    }
+    return true;
+}
+
+bool InverterProfile::parseLookupEntry(const char *key, size_t key_len, const char *value, const char *end) {
+    int32_t code;
+    if (keyIs(key, key_len, "key")) {
+        // Forma de lista: `- key: N` seguido de `value: texto`
+        if (!parseInt(value, end, &code)) {
+            _error = PROFILE_BAD_NUMBER;
+            return false;
+        }
+        _lookup_key = code;
+        return true;
+    }
+    if (keyIs(key, key_len, "value")) {
+        if (_lookup_key < 0) {
+            _error = PROFILE_BAD_LOOKUP;
+            return false;
+        }
+        code = _lookup_key;
+        _lookup_key = -1;
+        return addLookup(code, value, end);
+    }
+    if (!parseInt(key, key + key_len, &code)) {
+        _error = PROFILE_BAD_NUMBER;
+        return false;
+    }
+    return addLookup(code, value, end);
+}
+
+bool InverterProfile::addLookup(int32_t code, const char *text, const char *end) {
+    text = skipSpaces(text, end);
+    end = trimEnd(text, end);
+    unquote(&text, &end);
+    if (code < 0 || code >= MAX_LOOKUP_CODES || _item.lookup_count >= MAX_LOOKUP_CODES || end - text > 0xFF) {
+        _error = PROFILE_BAD_LOOKUP;
+        return false;
+    }
+    _item.lookup_codes[_item.lookup_count] = code;
+    _item.lookup_text[_item.lookup_count] = text;
+    _item.lookup_len[_item.lookup_count] = end - text;
+    _item.lookup_count++;
+    return true;
+}
+
+bool InverterProfile::finishItem() {
+    if (!_item.active) {
+        return true;
+    }
+    _item.active = false;
+    _lookup_indent = -1;
+
+    const ProfileField *field = findField(_item.field);
+    bool used = false;
+    for (size_t i = 0; field && i < _register_count; i++) {
+        used = used || _registers[i].field_offset == field->offset;
+    }
+    uint8_t rule = _item.rule;
+    if (rule == 0 && field) {
+        rule = (field->size == 4 ? 3 : 1) + (field->is_signed ? 1 : 0);
+    }
+    if (field == nullptr || used || rule < 1 || rule > 4) {
+        _skipped_count++;                   // Sin campo, repetido o regla no numérica (texto, bits, fechas)
+        return true;
+    }
+
+    uint8_t width = rule >= 3 ? 2 : 1;
+    if (_item.register_count != width || (width == 2 && _item.registers[1] != _item.registers[0] + 1)) {
+        return fail(PROFILE_BAD_REGISTERS, _item.line);
+    }
+    if ((uint32_t)_item.registers[0] + width > DeyeInverter::REGISTER_MAP_SIZE) {
+        return fail(PROFILE_BAD_ADDRESS, _item.line);
+    }
+
+    ValueConversion conv;
+    memset(&conv, 0, sizeof(conv));
+    conv.raw_signed = rule == 2 || rule == 4;
+    conv.field_signed = field->is_signed;
+    bool direct;
+
+    if (field->labels != nullptr) {
+        // Enumerado: los códigos del perfil se traducen por texto a los de la tabla
+        direct = true;
+        for (uint8_t e = 0; e < _item.lookup_count; e++) {
+            uint8_t code = _item.lookup_codes[e];
+            uint8_t mapped = UNKNOWN_CODE;
+            for (uint8_t l = 0; l < field->label_count; l++) {
+                if (equalsIgnoreCase(_item.lookup_text[e], _item.lookup_len[e], field->labels[l])) {
+                    mapped = l;
+                    break;
+                }
+            }
+            if (code >= conv.lookup_count) {
+                for (uint8_t c = conv.lookup_count; c < code; c++) {
+                    conv.lookup[c] = UNKNOWN_CODE;
+                }
+                conv.lookup_count = code + 1;
+            }
+            conv.lookup[code] = mapped;
+            direct = direct && mapped == code;
+        }
+        if (direct) {
+            conv.lookup_count = 0;
+        }
+        direct = direct && width == 1;
+    } else {
+        // campo = ((registro - offset) * scale - OFFSET) * DIVISOR
+        if (_item.scale_den <= 0) {
+            return fail(PROFILE_BAD_SCALE, _item.line);
+        }
+        int64_t mul = (int64_t)_item.scale_num * field->divisor;
+        int64_t div = _item.scale_den;
+        int64_t common = gcd(mul, div);
+        mul /= common;
+        div /= common;
+        int64_t add = -(int64_t)field->value_offset * field->divisor;
+        int64_t shifted = -(int64_t)_item.offset * mul;
+        add += (shifted >= 0 ? shifted + div / 2 : shifted - div / 2) / div;
+        if (mul == 0 || mul > 0x7FFFFFFF || mul < -0x7FFFFFFF || div > 0x7FFFFFFF ||
+            add > 0x7FFFFFFF || add < -0x7FFFFFFF) {
+            return fail(PROFILE_BAD_SCALE, _item.line);
+        }
+        conv.mul = mul;
+        conv.div = div;
+        conv.add = add;
+        direct = mul == 1 && div == 1 && add == 0 && field->size == width * 2 && conv.raw_signed == conv.field_signed;
+    }
+
+    const RegisterDescriptor *builtin = findBuiltin(field->offset);
+    RegisterDescriptor &reg = _registers[_register_count++];
+    reg.address = _item.registers[0];
+    reg.width = width;
+    reg.group = _item.group >= 0 ? (RegisterGroup)_item.group : builtin ? builtin->group : GROUP_INVERTER;
+    reg.poll = _item.poll >= 0 ? (PollClass)_item.poll : builtin ? builtin->poll : POLL_LIVE;
+    reg.field_offset = field->offset;
+    reg.field_size = field->size;
+    reg.conversion = 0;
+    if (!direct) {
+        _conversions[_conversion_count++] = conv;
+        reg.conversion = _conversion_count;
+    }
+    return true;
+}
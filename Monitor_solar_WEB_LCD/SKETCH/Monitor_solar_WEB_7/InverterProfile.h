@@ -0,0 +1,130 @@
+#ifndef INVERTERPROFILE_H
+#define INVERTERPROFILE_H
+
+#include "DeyeInverter.h"
+
+// Motivo por el que no se pudo compilar un perfil
+enum ProfileError : uint8_t {
+    PROFILE_OK,
+    PROFILE_BAD_NUMBER,             // Número mal escrito (rule, registers, scale, offset o código)
+    PROFILE_BAD_REGISTERS,          // Registros que no cuadran con la regla (32 bits = dos consecutivos)
+    PROFILE_BAD_ADDRESS,            // Registro fuera del mapa de DeyeInverter
+    PROFILE_BAD_LOOKUP,             // Código de enumerado fuera de rango o demasiados códigos
+    PROFILE_BAD_SCALE,              // Escala que no se puede aplicar con aritmética entera
+    PROFILE_EMPTY                   // Ningún elemento corresponde a un campo de InverterData
+};
+
+// Texto de cada error; no reserva memoria
+const char *profileErrorLabel(ProfileError error);
+
+/**
+ * @brief Perfil de registros de un inversor, cargado en tiempo de ejecución
+ *
+ * Se escribe con el mismo formato que los descriptores YAML de HA solarman
+ * (parameters → group → items con name, rule, registers, scale, offset y
+ * lookup), así que un fichero de HA sirve tal cual: los elementos que no
+ * corresponden a ningún campo de InverterData, o con reglas que no son
+ * números (texto, bits, fechas), se ignoran. Admite además dos claves
+ * propias por elemento: `field` (campo de InverterData, si el nombre no
+ * coincide) y `poll` (live, thermal, totals o static; por defecto la clase
+ * del campo en DEYE_REGISTERS). La sección `requests` no se usa: las
+ * peticiones las calcula ReadPlanner.
+ *
+ * compile() lo traduce una sola vez a una tabla plana de RegisterDescriptor
+ * como DEYE_REGISTERS, más una tabla de conversiones enteras para los
+ * registros cuya escala, desplazamiento o códigos no coinciden con los del
+ * campo. En cada lectura DeyeInverter recorre esa tabla sin analizar texto.
+ */
+class InverterProfile {
+public:
+    static const size_t MAX_NAME_LEN = 32;
+    static const size_t MAX_REGISTERS = 32;     // Uno por campo de InverterData como mucho
+
+private:
+    // Elemento de `items` mientras se analiza
+    struct Item {
+        bool active;
+        int line;
+        char field[MAX_NAME_LEN];
+        uint8_t rule;                   // 0 = la que corresponde al tipo del campo
+        uint16_t registers[2];
+        uint8_t register_count;
+        int32_t scale_num;
+        int32_t scale_den;
+        int32_t offset;
+        int8_t poll;                    // -1 = por defecto
+        int8_t group;                   // -1 = por defecto
+        uint8_t lookup_count;
+        uint8_t lookup_codes[MAX_LOOKUP_CODES];
+        const char *lookup_text[MAX_LOOKUP_CODES];
+        uint8_t lookup_len[MAX_LOOKUP_CODES];
+    };
+
+    char _name[MAX_NAME_LEN];
+    RegisterDescriptor _registers[MAX_REGISTERS];
+    ValueConversion _conversions[MAX_REGISTERS];
+    size_t _register_count;
+    size_t _conversion_count;
+    uint16_t _skipped_count;
+    ProfileError _error;
+    int _error_line;
+
+    // Estado del análisis
+    Item _item;
+    int8_t _group;
+    int _lookup_indent;                 // Sangría de la clave `lookup` (-1 = fuera de la tabla)
+    int32_t _lookup_key;                // Código pendiente en la forma `- key: N` / `value: texto`
+
+    bool parseLine(const char *line, const char *end, int line_number);
+    bool parseItemKey(const char *key, size_t key_len, const char *value, const char *end);
+    bool parseLookupEntry(const char *key, size_t key_len, const char *value, const char *end);
+    bool addLookup(int32_t code, const char *text, const char *end);
+    bool finishItem();
+    bool fail(ProfileError error, int line);
+
+public:
+    InverterProfile();
+
+    InverterProfile(const InverterProfile &) = delete;
+    InverterProfile &operator=(const InverterProfile &) = delete;
+
+    /**
+     * @brief Compila el texto de un perfil
+     *
+     * El texto no hace falta que siga vivo después. Si falla, el perfil
+     * queda vacío y getError()/getErrorLine() dicen por qué.
+     *
+     * @param text Contenido del fichero (no hace falta que acabe en '\0')
+     * @param len Longitud del texto
+     * @return true Si se ha reconocido al menos un registro
+     */
+    bool compile(const char *text, size_t len);
+
+    /**
+     * @brief Nombre del perfil (clave `name`, "custom" si no la tiene)
+     */
+    const char *getName() const { return _name; }
+
+    const RegisterDescriptor *getRegisters() const { return _registers; }
+    size_t getRegisterCount() const { return _register_count; }
+    const ValueConversion *getConversions() const { return _conversions; }
+
+    /**
+     * @brief Registros que necesitan conversión (el resto se copian tal cual)
+     */
+    size_t getConversionCount() const { return _conversion_count; }
+
+    /**
+     * @brief Elementos ignorados (sin campo en InverterData, repetidos o con regla no numérica)
+     */
+    uint16_t getSkippedCount() const { return _skipped_count; }
+
+    ProfileError getError() const { return _error; }
+
+    /**
+     * @brief Línea del error (empezando en 1; 0 si no es de una línea concreta)
+     */
+    int getErrorLine() const { return _error_line; }
+};
+
+#endif
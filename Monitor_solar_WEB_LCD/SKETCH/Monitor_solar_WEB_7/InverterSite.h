@@ -0,0 +1,193 @@
+#ifndef INVERTERSITE_H
+#define INVERTERSITE_H
+
+#include "DeyeInverter.h"
+#include "RefreshCoalescer.h"
+
+/**
+ * @brief Vista sumada de todos los inversores de la instalación
+ * 
+ * Potencias en W y energías en kWh, con el mismo signo que InverterData
+ * (red negativa = venta, batería negativa = carga). Solo se suman los
+ * inversores con datos válidos.
+ */
+struct SiteData {
+    unsigned long timestamp;        // Lectura más antigua de las sumadas
+    int32_t solar_power;
+    int32_t pv1_power;
+    int32_t pv2_power;
+    int32_t grid_power;
+    int32_t load_power;
+    int32_t battery_power;
+    float battery_soc;              // Media de los inversores con datos (%)
+    float battery_temperature;      // La más alta (°C)
+    float inverter_temperature;     // La más alta (°C)
+    float daily_production;
+    float daily_energy_bought;
+    float daily_energy_sold;
+    float daily_load_consumption;
+    uint8_t unit_count;
+    uint8_t units_valid;
+    bool data_valid;                // Todos los inversores tienen datos válidos
+};
+
+/**
+ * @brief Callback de fin de lectura de uno de los inversores
+ * 
+ * @param unit Índice del inversor (orden de addUnit())
+ * @param data Datos del inversor (data_valid indica si la lectura fue correcta)
+ * @param ctx Contexto indicado en onRead()
+ */
+typedef void (*InverterSiteCallback)(uint8_t unit, InverterData *data, void *ctx);
+
+/**
+ * @brief Varios inversores leídos a la vez desde un único bucle
+ * 
+ * Cada inversor tiene su propio lector (con su conexión y su circuit
+ * breaker), su plan de lectura y su copia de los datos. poll() avanza las
+ * lecturas asíncronas de todos sin bloquear, así que un datalogger lento o
+ * caído no retrasa a los demás: cada uno lanza sus clases programadas en
+ * cuanto le tocan y su lector está libre.
+ */
+class InverterSite {
+public:
+    static const uint8_t MAX_UNITS = 4;
+
+private:
+    struct Unit {
+        InverterSite *site;
+        uint8_t index;
+        const char *name;
+        DeyeInverter *inverter;
+        RefreshCoalescer *refresher;
+        InverterData data;
+        bool paused;                // Sin lecturas programadas (p.ej. el datalogger ya envía sus datos)
+    };
+    
+    Unit _units[MAX_UNITS];
+    uint8_t _unit_count;
+    InverterSiteCallback _callback;
+    void *_ctx;
+    
+    // Refresco completo de todos los inversores (ver requestRefresh())
+    uint32_t _unit_tickets[MAX_UNITS];  // Barrido de cada inversor que espera el refresco pedido
+    uint32_t _refresh_ticket;           // Último refresco pedido
+    uint32_t _refresh_done;             // Último refresco terminado
+    
+    static void onUnitRead(InverterData *data, void *ctx);
+    void updateRefresh();
+
+public:
+    InverterSite();
+    ~InverterSite();
+    
+    InverterSite(const InverterSite &) = delete;
+    InverterSite &operator=(const InverterSite &) = delete;
+    
+    /**
+     * @brief Añade un inversor
+     * 
+     * @param inverter Inversor ya configurado (no pasa a ser propiedad de InverterSite)
+     * @param name Nombre para los informes (debe seguir vivo)
+     * @return int Índice del inversor, o -1 si ya hay MAX_UNITS
+     */
+    int addUnit(DeyeInverter *inverter, const char *name);
+    
+    /**
+     * @brief Función a la que se llama al terminar cada lectura de cada inversor
+     */
+    void onRead(InverterSiteCallback callback, void *ctx = nullptr) {
+        _callback = callback;
+        _ctx = ctx;
+    }
+    
+    /**
+     * @brief Avanza las lecturas de todos los inversores y lanza las programadas (no bloquea)
+     */
+    void poll();
+    
+    /**
+     * @brief Pide un refresco completo de todos los inversores sin bloquear
+     * 
+     * Cada inversor pasa por su RefreshCoalescer: se une al barrido en curso
+     * o sirve los datos si tienen menos de max_staleness_ms. Los barridos
+     * avanzan con poll(), en paralelo. Si mientras tanto otra petición lanza
+     * un barrido nuevo, el refresco anterior se da por terminado con él.
+     * 
+     * @param max_staleness_ms Antigüedad máxima aceptable de los datos (0 = leer siempre)
+     * @param sources Si no es nulo, cómo se ha atendido cada inversor (getUnitCount() elementos)
+     * @return uint32_t Ticket: el refresco está hecho cuando isRefreshDone(ticket)
+     */
+    uint32_t requestRefresh(uint32_t max_staleness_ms = 0, RefreshCoalescer::RefreshSource *sources = nullptr);
+    
+    /**
+     * @brief Indica si el refresco del ticket ya ha terminado en todos los inversores
+     */
+    bool isRefreshDone(uint32_t ticket) { return (int32_t)(_refresh_done - ticket) >= 0; }
+    
+    /**
+     * @brief Último refresco terminado (el ticket que devolvió requestRefresh())
+     */
+    uint32_t getRefreshDone() { return _refresh_done; }
+    
+    /**
+     * @brief Refresco completo de todos los inversores a la vez (bloqueante)
+     * 
+     * Como requestRefresh(), pero espera a que termine: tarda lo que el
+     * inversor más lento.
+     * 
+     * @return true Si todos los inversores tienen datos válidos
+     */
+    bool refreshAll(uint32_t max_staleness_ms = 0, RefreshCoalescer::RefreshSource *sources = nullptr);
+    
+    /**
+     * @brief Decodifica una trama de datos enviada por el datalogger de un inversor
+     * 
+     * Si la trama es válida (ver DeyeInverter::decodePush()) los datos quedan
+     * en los del inversor y se avisa con el mismo callback que las lecturas.
+     * 
+     * @param unit Índice del inversor
+     * @param payload Datos de la trama (SolarmanDataCallback)
+     * @param len Longitud de los datos
+     * @return true Si la trama se ha decodificado entera
+     */
+    bool decodePush(uint8_t unit, const uint8_t *payload, size_t len);
+    
+    /**
+     * @brief Indica si algún inversor tiene una lectura en curso o pendiente
+     */
+    bool isBusy();
+    
+    /**
+     * @brief Suma los datos de todos los inversores
+     */
+    void getSiteData(SiteData *site);
+    
+    /**
+     * @brief Suma los datos de varios inversores (o resume uno solo, con count = 1)
+     * 
+     * @param units Datos de cada inversor
+     * @param count Número de inversores
+     * @param site Resultado
+     */
+    static void sum(const InverterData *const *units, uint8_t count, SiteData *site);
+    
+    /**
+     * @brief Deja de lanzar lecturas programadas de un inversor (o las reanuda)
+     */
+    void setPaused(uint8_t unit, bool paused) {
+        if (unit < _unit_count) _units[unit].paused = paused;
+    }
+    
+    uint8_t getUnitCount() { return _unit_count; }
+    const char *getName(uint8_t unit) { return _units[unit].name; }
+    DeyeInverter *getInverter(uint8_t unit) { return _units[unit].inverter; }
+    RefreshCoalescer *getRefresher(uint8_t unit) { return _units[unit].refresher; }
+    
+    /**
+     * @brief Últimos datos de un inversor
+     */
+    InverterData &getData(uint8_t unit) { return _units[unit].data; }
+};
+
+#endif
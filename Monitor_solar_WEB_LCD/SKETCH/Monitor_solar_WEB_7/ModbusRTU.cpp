@@ -0,0 +1,279 @@
+#include "ModbusRTU.h"
+#include "ModbusCRC.h"
+#include <string.h>
+
+ModbusRTU::ModbusRTU(SerialPort *port, uint8_t slave_id, uint32_t baud_rate) {
+    _port = port;
+    _clock = defaultClock();
+    _slave_id = slave_id;
+    _baud_rate = baud_rate;
+    _response_timeout_ms = DEFAULT_RESPONSE_TIMEOUT_MS;
+    _last_activity = 0;
+    _last_frame_error = SOLARMAN_FRAME_OK;
+    _last_exception = 0;
+    _request_count = 0;
+    _timeout_count = 0;
+    _error_count = 0;
+    _sent_us = 0;
+    
+    // t3.5: 3,5 caracteres de 11 bits; por encima de 19200 baudios el estándar lo fija en 1,75 ms
+    if (baud_rate > 19200) {
+        _silence_ms = 2;
+    } else {
+        _silence_ms = (38500 + baud_rate - 1) / baud_rate;
+    }
+    
+    memset(_ops, 0, sizeof(_ops));
+    _next_handle = 0;
+    _current = -1;
+    _async_timer = 0;
+    _rx_len = 0;
+}
+
+bool ModbusRTU::begin() {
+    if (!_port->begin(_baud_rate)) {
+        return false;
+    }
+    _last_activity = _clock->millis();
+    return true;
+}
+
+void ModbusRTU::discardInput() {
+    uint8_t scratch[32];
+    while (_port->available() > 0 && _port->read(scratch, sizeof(scratch)) > 0) {
+    }
+}
+
+bool ModbusRTU::silenceElapsed() {
+    // Con un reloj de 1 ms, "mayor que" garantiza al menos _silence_ms completos
+    return _clock->millis() - _last_activity > _silence_ms;
+}
+
+bool ModbusRTU::sendRequest(uint16_t start_addr, uint16_t count) {
+    uint8_t frame[8];
+    frame[0] = _slave_id;
+    frame[1] = 0x03;
+    frame[2] = start_addr >> 8;
+    frame[3] = start_addr & 0xFF;
+    frame[4] = count >> 8;
+    frame[5] = count & 0xFF;
+    uint16_t crc = ModbusCRC::compute(frame, 6);
+    frame[6] = crc & 0xFF;
+    frame[7] = crc >> 8;
+    
+    // Lo que quede en el buffer es ruido o una respuesta que llegó tarde
+    discardInput();
+    _rx_len = 0;
+    _request_count++;
+    _stats.requests++;
+    _sent_us = _clock->micros();
+    size_t sent = _port->write(frame, sizeof(frame));
+    _stats.bytes_sent += sent;
+    _last_activity = _clock->millis();
+    _async_timer = _last_activity;
+    return sent == sizeof(frame);
+}
+
+int ModbusRTU::receiveResponse(uint16_t *values, uint16_t count) {
+    while (_port->available() > 0) {
+        // Excepción: slave + función | 0x80 + código + CRC; lectura: 5 + 2 bytes por registro
+        size_t expected = 5 + (size_t)count * 2;
+        if (_rx_len >= 2 && (_rx_buffer[1] & 0x80)) {
+            expected = 5;
+        }
+        int n = _port->read(&_rx_buffer[_rx_len], expected - _rx_len);
+        if (n <= 0) {
+            break;
+        }
+        if (_rx_len == 0) {
+            _stats.first_byte.record(_clock->micros() - _sent_us);
+        }
+        _rx_len += n;
+        _last_activity = _clock->millis();
+        _async_timer = _last_activity;
+        
+        if (_rx_len >= 2 && (_rx_buffer[1] & 0x80)) {
+            expected = 5;
+        }
+        if (_rx_len >= expected) {
+            _stats.bytes_received += _rx_len;
+            if (parseResponse(_rx_buffer, _rx_len, values, count)) {
+                _stats.transaction.record(_clock->micros() - _sent_us);
+                return 1;
+            }
+            if (_last_frame_error != SOLARMAN_FRAME_EXCEPTION) {
+                _error_count++;
+            }
+            return -1;
+        }
+    }
+    
+    if (_clock->millis() - _async_timer > _response_timeout_ms) {
+        _timeout_count++;
+        _stats.timeouts++;
+        return -1;
+    }
+    return 0;
+}
+
+bool ModbusRTU::parseResponse(const uint8_t *response, size_t len, uint16_t *values, uint16_t count) {
+    _last_exception = 0;
+    _last_frame_error = SOLARMAN_FRAME_OK;
+    if (len < 5) {
+        _last_frame_error = SOLARMAN_FRAME_BAD_LENGTH;
+        return false;
+    }
+    if (response[0] != _slave_id) {
+        _last_frame_error = SOLARMAN_FRAME_BAD_SLAVE;
+        return false;
+    }
+    if (response[1] == 0x83) {
+        if (ModbusCRC::compute(response, 3) != (response[3] | (response[4] << 8))) {
+            _stats.crc_errors++;
+            _last_frame_error = SOLARMAN_FRAME_BAD_CRC;
+            return false;
+        }
+        _last_exception = response[2];
+        _last_frame_error = SOLARMAN_FRAME_EXCEPTION;
+        return false;
+    }
+    if (response[1] != 0x03) {
+        _last_frame_error = SOLARMAN_FRAME_BAD_FUNCTION;
+        return false;
+    }
+    
+    size_t data_bytes = (size_t)count * 2;
+    if (response[2] != data_bytes || len != 5 + data_bytes) {
+        _last_frame_error = SOLARMAN_FRAME_BAD_LENGTH;
+        return false;
+    }
+    uint16_t received_crc = response[3 + data_bytes] | (response[4 + data_bytes] << 8);
+    if (ModbusCRC::compute(response, 3 + data_bytes) != received_crc) {
+        _stats.crc_errors++;
+        _last_frame_error = SOLARMAN_FRAME_BAD_CRC;
+        return false;
+    }
+    
+    for (uint16_t r = 0; r < count; r++) {
+        values[r] = (response[3 + r * 2] << 8) | response[4 + r * 2];
+    }
+    return true;
+}
+
+bool ModbusRTU::readHoldingRegisters(uint16_t start_addr, uint16_t count, uint16_t *values) {
+    if (count == 0 || count > MAX_REGISTERS_PER_READ || isBusy()) {
+        return false;
+    }
+    
+    while (!silenceElapsed()) {
+        _clock->delay(1);
+    }
+    if (!sendRequest(start_addr, count)) {
+        return false;
+    }
+    
+    int res;
+    while ((res = receiveResponse(values, count)) == 0) {
+        _clock->delay(1);
+    }
+    return res > 0;
+}
+
+bool ModbusRTU::readPipelined(SolarmanReadRequest *requests, size_t n) {
+    bool all_ok = true;
+    for (size_t i = 0; i < n; i++) {
+        requests[i].ok = readHoldingRegisters(requests[i].start_addr, requests[i].count, requests[i].values);
+        if (!requests[i].ok) {
+            all_ok = false;
+        }
+    }
+    return all_ok;
+}
+
+// ============================================================================
+// LECTURA ASÍNCRONA
+// ============================================================================
+
+void ModbusRTU::completeOp(AsyncOp *op, bool ok) {
+    op->status = ok ? OP_DONE : OP_FAILED;
+    if (op->callback) {
+        op->callback(op->handle, ok, op->ctx);
+    }
+}
+
+int ModbusRTU::beginRead(uint16_t start_addr, uint16_t count, uint16_t *values,
+                         SolarmanReadCallback callback, void *ctx) {
+    if (count == 0 || count > MAX_REGISTERS_PER_READ || values == nullptr) {
+        return -1;
+    }
+    
+    for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+        AsyncOp *op = &_ops[i];
+        if (op->status == OP_QUEUED || op->status == OP_SENT) {
+            continue;
+        }
+        op->handle = _next_handle;
+        _next_handle = (_next_handle + 1) & 0x7FFFFFFF;
+        op->start_addr = start_addr;
+        op->count = count;
+        op->values = values;
+        op->callback = callback;
+        op->ctx = ctx;
+        op->status = OP_QUEUED;
+        return op->handle;
+    }
+    return -1;
+}
+
+SolarmanReadStatus ModbusRTU::getReadStatus(int handle) {
+    for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+        if (_ops[i].status != OP_FREE && _ops[i].handle == handle) {
+            switch (_ops[i].status) {
+                case OP_DONE: return SOLARMAN_READ_DONE;
+                case OP_FAILED: return SOLARMAN_READ_FAILED;
+                default: return SOLARMAN_READ_PENDING;
+            }
+        }
+    }
+    return SOLARMAN_READ_UNKNOWN;
+}
+
+bool ModbusRTU::isBusy() {
+    for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+        if (_ops[i].status == OP_QUEUED || _ops[i].status == OP_SENT) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ModbusRTU::poll() {
+    if (_current < 0) {
+        // Siguiente lectura en cola, cuando el bus lleve t3.5 en silencio
+        int next = -1;
+        for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE && next < 0; i++) {
+            if (_ops[i].status == OP_QUEUED) {
+                next = i;
+            }
+        }
+        if (next < 0 || !silenceElapsed()) {
+            return;
+        }
+        AsyncOp *op = &_ops[next];
+        if (!sendRequest(op->start_addr, op->count)) {
+            completeOp(op, false);
+            return;
+        }
+        op->status = OP_SENT;
+        _current = next;
+        return;
+    }
+    
+    AsyncOp *op = &_ops[_current];
+    int res = receiveResponse(op->values, op->count);
+    if (res == 0) {
+        return;
+    }
+    _current = -1;
+    completeOp(op, res > 0);
+}
@@ -0,0 +1,216 @@
+#ifndef MODBUSRTU_H
+#define MODBUSRTU_H
+
+#include "RegisterReader.h"
+#include "SerialPort.h"
+#include "SolarmanV5.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Maestro Modbus RTU directo sobre el puerto RS485 del inversor
+ * 
+ * Lee los mismos registros que SolarmanV5 pero sin pasar por el datalogger:
+ * las tramas Modbus (función 0x03) van tal cual por el bus, separadas por el
+ * silencio de 3,5 caracteres que exige el estándar. Sin la latencia de la
+ * WiFi y del datalogger, un ciclo completo de lectura cabe en bastante menos
+ * de un segundo incluso a 9600 baudios.
+ * 
+ * El bus es half-duplex y solo admite una petición en vuelo, así que las
+ * lecturas de varios bloques se hacen una detrás de otra.
+ */
+class ModbusRTU : public RegisterReader {
+public:
+    static const uint32_t DEFAULT_BAUD_RATE = 9600;       // Velocidad por defecto del puerto BMS/RS485 de Deye
+    static const uint32_t DEFAULT_RESPONSE_TIMEOUT_MS = 500; // Espera máxima del primer byte y entre bytes
+    static const size_t MAX_FRAME_LEN = 5 + 2 * MAX_REGISTERS_PER_READ; // Respuesta más larga (255 bytes)
+
+private:
+    enum AsyncOpStatus {
+        OP_FREE,
+        OP_QUEUED,
+        OP_SENT,
+        OP_DONE,
+        OP_FAILED
+    };
+    
+    struct AsyncOp {
+        int handle;
+        uint16_t start_addr;
+        uint16_t count;
+        uint16_t *values;
+        SolarmanReadCallback callback;
+        void *ctx;
+        uint8_t status;
+    };
+    
+    SerialPort *_port;
+    Clock *_clock;
+    uint8_t _slave_id;              // Slave ID del inversor (normalmente 1)
+    uint32_t _baud_rate;
+    uint32_t _silence_ms;           // Silencio entre tramas (t3.5) redondeado hacia arriba
+    uint32_t _response_timeout_ms;
+    unsigned long _last_activity;   // Último byte enviado o recibido
+    
+    SolarmanFrameError _last_frame_error;
+    uint8_t _last_exception;        // Código de la última excepción Modbus (0 = ninguna)
+    uint32_t _request_count;
+    uint32_t _timeout_count;
+    uint32_t _error_count;          // Respuestas descartadas por no ser válidas
+    RequestStats _stats;
+    unsigned long _sent_us;         // Envío de la petición en curso (estadísticas)
+    
+    // Lectura asíncrona
+    AsyncOp _ops[ASYNC_QUEUE_SIZE];
+    int _next_handle;
+    int _current;                   // Índice de la lectura esperando respuesta (-1 = ninguna)
+    unsigned long _async_timer;     // Último progreso de la respuesta en curso
+    uint8_t _rx_buffer[MAX_FRAME_LEN];
+    size_t _rx_len;
+    
+    void discardInput();
+    bool silenceElapsed();
+    bool sendRequest(uint16_t start_addr, uint16_t count);
+    int receiveResponse(uint16_t *values, uint16_t count);
+    bool parseResponse(const uint8_t *response, size_t len, uint16_t *values, uint16_t count);
+    void completeOp(AsyncOp *op, bool ok);
+
+public:
+    /**
+     * @brief Constructor del maestro Modbus RTU
+     * 
+     * @param port Puerto serie conectado al bus (no pasa a ser propiedad de ModbusRTU)
+     * @param slave_id Slave ID del inversor (por defecto 1)
+     * @param baud_rate Velocidad del bus (por defecto 9600)
+     */
+    ModbusRTU(SerialPort *port, uint8_t slave_id = 1, uint32_t baud_rate = DEFAULT_BAUD_RATE);
+    
+    ModbusRTU(const ModbusRTU &) = delete;
+    ModbusRTU &operator=(const ModbusRTU &) = delete;
+    
+    /**
+     * @brief Abre el puerto serie a la velocidad configurada
+     * 
+     * @return true Si el puerto quedó abierto
+     */
+    bool begin();
+    
+    /**
+     * @brief Lee múltiples registros consecutivos del inversor (bloqueante)
+     * 
+     * @param start_addr Dirección inicial del primer registro
+     * @param count Número de registros a leer (1..MAX_REGISTERS_PER_READ)
+     * @param values Array donde se almacenarán los valores leídos
+     * @return true Si la lectura fue exitosa
+     */
+    bool readHoldingRegisters(uint16_t start_addr, uint16_t count, uint16_t *values) override;
+    
+    /**
+     * @brief Lee varios bloques seguidos, respetando el silencio entre tramas
+     * 
+     * Un bloque que falla no detiene la lectura de los siguientes.
+     * 
+     * @param requests Array de peticiones; se rellena el campo `ok` de cada una
+     * @param n Número de peticiones
+     * @return true Si todos los bloques se leyeron correctamente
+     */
+    bool readPipelined(SolarmanReadRequest *requests, size_t n) override;
+    
+    /**
+     * @brief Encola la lectura de un bloque de registros sin bloquear
+     * 
+     * @return int Handle de la lectura, o -1 si la cola está llena o los parámetros no son válidos
+     */
+    int beginRead(uint16_t start_addr, uint16_t count, uint16_t *values,
+                  SolarmanReadCallback callback = nullptr, void *ctx = nullptr) override;
+    
+    /**
+     * @brief Avanza las lecturas asíncronas (envío, recepción y parseo)
+     * 
+     * No bloquea: debe llamarse periódicamente desde loop() o desde la tarea de lectura.
+     */
+    void poll() override;
+    
+    /**
+     * @brief Consulta el estado de una lectura asíncrona
+     * 
+     * @param handle Handle devuelto por beginRead()
+     * @return SolarmanReadStatus Estado de la lectura
+     */
+    SolarmanReadStatus getReadStatus(int handle);
+    
+    /**
+     * @brief Indica si hay lecturas asíncronas pendientes
+     */
+    bool isBusy() override;
+    
+    Clock *getClock() override { return _clock; }
+    
+    /**
+     * @brief Obtiene las estadísticas de las peticiones por el bus
+     * 
+     * El tiempo hasta el primer byte incluye el envío de la petición por el
+     * cable; no hay tiempos de conexión.
+     */
+    RequestStats &getStats() override { return _stats; }
+    
+    // ============================================================================
+    // MÉTODOS DE CONFIGURACIÓN
+    // ============================================================================
+    
+    /**
+     * @brief Sustituye el reloj de la plataforma
+     */
+    void setClock(Clock *clock) { _clock = clock; }
+    
+    /**
+     * @brief Establece el Slave ID del inversor
+     */
+    void setSlaveId(uint8_t slave_id) { _slave_id = slave_id; }
+    
+    /**
+     * @brief Establece la espera máxima del primer byte de la respuesta y entre bytes
+     */
+    void setResponseTimeout(uint32_t timeout_ms) { _response_timeout_ms = timeout_ms; }
+    
+    // ============================================================================
+    // MÉTODOS DE INFORMACIÓN
+    // ============================================================================
+    
+    uint8_t getSlaveId() { return _slave_id; }
+    uint32_t getBaudRate() { return _baud_rate; }
+    
+    /**
+     * @brief Obtiene el silencio que se deja entre tramas (t3.5, en ms)
+     */
+    uint32_t getSilenceMs() { return _silence_ms; }
+    
+    /**
+     * @brief Obtiene el resultado de validar la última respuesta recibida
+     * 
+     * @return SolarmanFrameError SOLARMAN_FRAME_OK o el primer campo que no cuadró
+     */
+    SolarmanFrameError getLastFrameError() { return _last_frame_error; }
+    
+    /**
+     * @brief Obtiene el código de la última excepción Modbus del inversor
+     */
+    uint8_t getLastException() { return _last_exception; }
+    
+    /**
+     * @brief Obtiene el número de peticiones enviadas desde el arranque
+     */
+    uint32_t getRequestCount() { return _request_count; }
+    
+    /**
+     * @brief Obtiene el número de peticiones que se quedaron sin respuesta
+     */
+    uint32_t getTimeoutCount() { return _timeout_count; }
+    
+    /**
+     * @brief Obtiene el número de respuestas descartadas por no ser válidas
+     */
+    uint32_t getErrorCount() { return _error_count; }
+};
+
+#endif
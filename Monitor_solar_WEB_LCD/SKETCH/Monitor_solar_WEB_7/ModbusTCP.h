@@ -0,0 +1,242 @@
+#ifndef MODBUSTCP_H
+#define MODBUSTCP_H
+
+#include "RegisterReader.h"
+#include "SolarmanV5.h"
+#include "Transport.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Cliente Modbus TCP para pasarelas RS485-Ethernet
+ * 
+ * Algunas instalaciones tienen una pasarela que habla Modbus TCP estándar
+ * (cabecera MBAP + unit ID) en lugar de Solarman V5. Cada petición lleva un
+ * transaction ID propio, así que se pueden tener varias en vuelo sobre la
+ * misma conexión persistente y asociar cada respuesta a la suya aunque
+ * lleguen desordenadas.
+ */
+class ModbusTCP : public RegisterReader {
+public:
+    static const uint16_t DEFAULT_PORT = 502;
+    static const uint8_t MAX_PIPELINE_DEPTH = ASYNC_QUEUE_SIZE;   // Transacciones simultáneas en vuelo
+    static const uint8_t DEFAULT_PIPELINE_DEPTH = 4;
+    static const size_t MBAP_HEADER_LEN = 7;              // Transaction ID + protocolo + longitud + unit ID
+    static const size_t MAX_RESPONSE_LEN = MBAP_HEADER_LEN + 2 + 2 * MAX_REGISTERS_PER_READ; // 259 bytes
+    static const uint32_t CONNECT_TIMEOUT_MS = 5000;
+    static const uint32_t DEFAULT_RESPONSE_TIMEOUT_MS = 2000;  // La pasarela aún tiene que pasar por el bus RS485
+
+private:
+    enum AsyncState {
+        ASYNC_IDLE,                 // Sin conexión en curso
+        ASYNC_CONNECTING,           // connect() no bloqueante en curso
+        ASYNC_READY                 // Conectado: enviando y recibiendo
+    };
+    
+    enum AsyncOpStatus {
+        OP_FREE,
+        OP_QUEUED,
+        OP_SENT,
+        OP_DONE,
+        OP_FAILED
+    };
+    
+    struct AsyncOp {
+        int handle;
+        uint16_t start_addr;
+        uint16_t count;
+        uint16_t *values;
+        SolarmanReadCallback callback;
+        void *ctx;
+        unsigned long sent_us;      // Envío de la petición (estadísticas)
+        uint16_t tid;
+        uint8_t status;
+    };
+    
+    const char *_host;
+    uint16_t _port;
+    uint8_t _unit_id;               // Unit ID del inversor detrás de la pasarela
+    uint16_t _transaction_id;       // Próximo transaction ID
+    uint8_t _pipeline_depth;
+    uint32_t _response_timeout_ms;
+    
+    Transport *_transport;
+    Clock *_clock;
+    bool _owns_transport;           // El transporte por defecto se libera en el destructor
+    uint32_t _connect_count;
+    uint32_t _transaction_count;
+    uint32_t _timeout_count;
+    SolarmanFrameError _last_frame_error;
+    uint8_t _last_exception;        // Código de la última excepción Modbus (0 = ninguna)
+    RequestStats _stats;
+    unsigned long _connect_started_us;  // Inicio del connect() no bloqueante
+    unsigned long _frame_start_us;      // Llegada del primer byte de la última trama
+    
+    // Cliente asíncrono
+    AsyncOp _ops[ASYNC_QUEUE_SIZE];
+    int _next_handle;
+    AsyncState _async_state;
+    unsigned long _async_timer;     // Inicio de la espera actual (conexión o respuesta)
+    uint8_t _rx_buffer[MAX_RESPONSE_LEN];
+    size_t _rx_len;
+    
+    size_t buildRequest(uint8_t *frame, uint16_t start_addr, uint16_t count);
+    bool ensureConnected();
+    bool writeRequest(const uint8_t *request, size_t len);
+    void recordTransaction(unsigned long sent_us);
+    void discardInput();
+    int receiveFrame();
+    bool waitFrame(size_t *frame_len);
+    bool parseResponse(const uint8_t *response, size_t len, uint16_t *values, uint16_t count);
+    void completeOp(AsyncOp *op, bool ok);
+    void failOps(uint8_t status);
+    void pumpAsync();
+
+public:
+    /**
+     * @brief Constructor del cliente Modbus TCP
+     * 
+     * @param host IP o nombre de la pasarela
+     * @param unit_id Unit ID del inversor (por defecto 1)
+     * @param port Puerto TCP de la pasarela (por defecto 502)
+     */
+    ModbusTCP(const char *host, uint8_t unit_id = 1, uint16_t port = DEFAULT_PORT);
+    ~ModbusTCP();
+    
+    ModbusTCP(const ModbusTCP &) = delete;
+    ModbusTCP &operator=(const ModbusTCP &) = delete;
+    
+    /**
+     * @brief Cierra la conexión; las lecturas que esperaban respuesta se dan por fallidas
+     */
+    void disconnect();
+    
+    /**
+     * @brief Lee múltiples registros consecutivos del inversor (bloqueante)
+     * 
+     * @param start_addr Dirección inicial del primer registro
+     * @param count Número de registros a leer (1..MAX_REGISTERS_PER_READ)
+     * @param values Array donde se almacenarán los valores leídos
+     * @return true Si la lectura fue exitosa
+     */
+    bool readHoldingRegisters(uint16_t start_addr, uint16_t count, uint16_t *values) override;
+    
+    /**
+     * @brief Lee varios bloques manteniendo hasta `pipeline_depth` transacciones en vuelo
+     * 
+     * Cada respuesta se asocia a su petición por el transaction ID. Los
+     * bloques que se quedan sin respuesta se reintentan uno a uno.
+     * 
+     * @param requests Array de peticiones; se rellena el campo `ok` de cada una
+     * @param n Número de peticiones
+     * @return true Si todos los bloques se leyeron correctamente
+     */
+    bool readPipelined(SolarmanReadRequest *requests, size_t n) override;
+    
+    /**
+     * @brief Encola la lectura de un bloque de registros sin bloquear
+     * 
+     * @return int Handle de la lectura, o -1 si la cola está llena o los parámetros no son válidos
+     */
+    int beginRead(uint16_t start_addr, uint16_t count, uint16_t *values,
+                  SolarmanReadCallback callback = nullptr, void *ctx = nullptr) override;
+    
+    /**
+     * @brief Avanza las lecturas asíncronas (conexión, envío, recepción y parseo)
+     * 
+     * No bloquea: debe llamarse periódicamente desde loop().
+     */
+    void poll() override;
+    
+    /**
+     * @brief Consulta el estado de una lectura asíncrona
+     * 
+     * @param handle Handle devuelto por beginRead()
+     * @return SolarmanReadStatus Estado de la lectura
+     */
+    SolarmanReadStatus getReadStatus(int handle);
+    
+    /**
+     * @brief Indica si hay lecturas asíncronas pendientes
+     */
+    bool isBusy() override;
+    
+    Clock *getClock() override { return _clock; }
+    
+    /**
+     * @brief Obtiene las estadísticas de las transacciones con la pasarela
+     * 
+     * Modbus TCP no lleva CRC, así que crc_errors se queda siempre a cero.
+     */
+    RequestStats &getStats() override { return _stats; }
+    
+    // ============================================================================
+    // MÉTODOS DE CONFIGURACIÓN
+    // ============================================================================
+    
+    /**
+     * @brief Sustituye el transporte y el reloj de la plataforma
+     * 
+     * El transporte indicado no pasa a ser propiedad de ModbusTCP.
+     * 
+     * @param transport Nuevo transporte
+     * @param clock Nuevo reloj (nullptr = mantener el actual)
+     */
+    void setTransport(Transport *transport, Clock *clock = nullptr);
+    
+    /**
+     * @brief Establece cuántas transacciones pueden estar en vuelo a la vez
+     * 
+     * @param depth Profundidad del pipeline (1..MAX_PIPELINE_DEPTH, 1 = desactivado)
+     */
+    void setPipelineDepth(uint8_t depth) {
+        _pipeline_depth = depth < 1 ? 1 : (depth > MAX_PIPELINE_DEPTH ? MAX_PIPELINE_DEPTH : depth);
+    }
+    
+    /**
+     * @brief Establece la espera máxima de cada respuesta
+     */
+    void setResponseTimeout(uint32_t timeout_ms) { _response_timeout_ms = timeout_ms; }
+    
+    void setUnitId(uint8_t unit_id) { _unit_id = unit_id; }
+    void setHost(const char *host) { disconnect(); _host = host; }
+    
+    // ============================================================================
+    // MÉTODOS DE INFORMACIÓN
+    // ============================================================================
+    
+    const char *getHost() { return _host; }
+    uint16_t getPort() { return _port; }
+    uint8_t getUnitId() { return _unit_id; }
+    uint8_t getPipelineDepth() { return _pipeline_depth; }
+    bool isConnected() { return _transport->connected(); }
+    
+    /**
+     * @brief Obtiene el número de conexiones TCP abiertas desde el arranque
+     */
+    uint32_t getConnectCount() { return _connect_count; }
+    
+    /**
+     * @brief Obtiene el número de transacciones enviadas desde el arranque
+     */
+    uint32_t getTransactionCount() { return _transaction_count; }
+    
+    /**
+     * @brief Obtiene el número de veces que la pasarela dejó de responder
+     */
+    uint32_t getTimeoutCount() { return _timeout_count; }
+    
+    /**
+     * @brief Obtiene el resultado de validar la última respuesta recibida
+     * 
+     * @return SolarmanFrameError SOLARMAN_FRAME_OK o el primer campo que no cuadró
+     */
+    SolarmanFrameError getLastFrameError() { return _last_frame_error; }
+    
+    /**
+     * @brief Obtiene el código de la última excepción Modbus del inversor
+     */
+    uint8_t getLastException() { return _last_exception; }
+};
+
+#endif
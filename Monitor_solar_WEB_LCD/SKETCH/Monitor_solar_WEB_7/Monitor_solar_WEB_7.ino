@@ -3,22 +3,59 @@
 #include <ESPmDNS.h>
 #include <DNSServer.h>
 #include <Preferences.h>
+#include <LittleFS.h>
 #include <time.h>
 #define LV_CONF_INCLUDE_SIMPLE 1
 #include "lv_conf.h"
 #include "lvgl.h"
 #include "Waveshare_ST7262_LVGL.h"
 #include "SolarmanV5.h"
+#include "SolarmanServer.h"
+#include "ModbusRTU.h"
+#include "ModbusTCP.h"
+#include "HardwareSerialPort.h"
 #include "DeyeInverter.h"
+#include "InverterSite.h"
+#include "InverterProfile.h"
+#include "Seqlock.h"
 
 // ===== CONFIGURACIÓN POR DEFECTO
 const char* DEFAULT_SSID = "wifissid";               // nombre de la wifi
 const char* DEFAULT_PASS = "wifipass";               // pass de la wifi
 const uint32_t DEFAULT_DATALOGGER_SN = 1234567890;   // SN del datalogger
-const char* DEFAULT_DATALOGGER_IP = "192.168.1.10";  // ip del datalogger
+const char* DEFAULT_DATALOGGER_IP = "192.168.1.10";  // ip del datalogger (un nombre se resuelve una sola vez, en la primera conexión)
 const int16_t DEFAULT_POTENCIA = 6000;               // potencia del inversor, W
 const int16_t DEFAULT_ESPERA = 15;                   // espera hasta apagar pantalla,minutos
-const uint32_t DEFAULT_READ_INTERVAL = 10;           // intervalo entre lecturas del inversor, segundos
+const uint32_t DEFAULT_READ_INTERVAL = 2;            // intervalo entre lecturas de potencias, segundos
+const uint32_t POLL_TICK_MS = 250;                   // cada cuánto se mira qué datos toca leer
+const uint32_t BUSY_POLL_MS = 2;                     // cada cuánto se avanzan las lecturas en curso
+const uint8_t PIPELINE_DEPTH = 3;                    // peticiones simultáneas al datalogger (1 si se atasca)
+const uint32_t KEEPALIVE_MS = 5000;                  // heartbeat si la conexión lleva este tiempo ociosa (0 = no)
+const uint16_t PUSH_SERVER_PORT = 0;                 // puerto donde recibir los datos que envía el datalogger (0 = no)
+const unsigned long PUSH_FRESH_MS = 600000;          // mientras lleguen datos del datalogger no se le pregunta
+// bloques de registros de las tramas del datalogger, en su orden; dependen de su firmware (ver push_listen)
+const RegisterBlock PUSH_LAYOUT[MAX_PLAN_BLOCKS] = {}; // p.ej. {{0x0003, 5}, {0x003B, 22}, ...}
+const size_t PUSH_LAYOUT_COUNT = 0;                  // bloques usados (0 = las tramas no se decodifican)
+const int8_t RS485_RX_PIN = -1;                      // RX del RS485 al puerto Modbus del inversor (-1 = usar el datalogger)
+const int8_t RS485_TX_PIN = -1;                      // TX del RS485
+const int8_t RS485_DE_PIN = -1;                      // DE/RE del transceptor (-1 = conmutación automática)
+const uint32_t RS485_BAUD = 9600;                    // velocidad del puerto Modbus del inversor
+const char* MODBUS_TCP_HOST = "";                    // IP de una pasarela Modbus TCP en lugar del datalogger ("" = no; un nombre se resuelve una sola vez)
+const uint16_t MODBUS_TCP_PORT = 502;                // puerto de la pasarela Modbus TCP
+const uint8_t MODBUS_TCP_DEPTH = 4;                  // transacciones simultáneas a la pasarela
+// Inversores adicionales, cada uno con su datalogger (el primero es el de /setup); hasta 4 en total
+struct DataloggerConfig {
+    const char* ip;
+    uint32_t sn;
+};
+const DataloggerConfig EXTRA_DATALOGGERS[] = {
+    // {"192.168.1.11", 1234567891},
+    {nullptr, 0}                                     // fin de la lista
+};
+const uint32_t STATS_REPORT_MS = 300000;             // resumen de tiempos de las peticiones por el puerto serie (0 = no)
+const uint32_t REGISTER_MAX_AGE_MS = 90000;          // /registers contesta de la caché lo leído hace menos de esto (?max_age=MS)
+const uint32_t REGISTER_ANSWER_MS = 10000;           // /registers guarda lo que contesta la tarea para la siguiente llamada
+const char* PROFILE_PATH = "/profile.yaml";          // perfil de registros en LittleFS (ver profiles/; sin fichero, los de Deye)
 
 // ===== VARIABLES DE CONFIGURACIÓN
 String config_ssid = DEFAULT_SSID;
@@ -40,9 +77,53 @@ const char* AP_SSID = "MonitorSolar";
 bool inApMode = false;
 DNSServer dnsServer;
 
-SolarmanV5* solarman = nullptr;
-DeyeInverter* inverter = nullptr;
-InverterData inv_data;
+SolarmanV5* solarmans[InverterSite::MAX_UNITS] = {};
+HardwareSerialPort* rs485_port = nullptr;
+ModbusRTU* rtu = nullptr;
+ModbusTCP* gateway = nullptr;
+InverterSite* site = nullptr;            // Solo lo usa inverterReadTask
+SolarmanServer* push_server = nullptr;   // Solo lo usa inverterReadTask
+Seqlock<InverterData> inv_snapshots[InverterSite::MAX_UNITS];   // Última lectura de cada inversor
+Seqlock<SiteData> site_snapshot;         // Suma de todos los inversores
+uint8_t unit_count = 0;                  // Inversores configurados (fijo tras setup)
+InverterProfile profile;                 // Perfil de PROFILE_PATH, compilado en setup
+bool profile_loaded = false;
+uint32_t saved_spans[InverterSite::MAX_UNITS] = {};   // Tamaño de petición guardado de cada datalogger
+
+// Estadísticas de las peticiones y de los ciclos, publicadas por inverterReadTask
+struct StatsSnapshot {
+    RequestStats requests;
+    LatencyHistogram cycles;
+    uint32_t failed_cycles;
+    uint16_t max_span;                   // Registros por petición (aprendido en SolarmanV5)
+};
+Seqlock<StatsSnapshot> stats_snapshots[InverterSite::MAX_UNITS];
+std::atomic<bool> stats_reset_requested(false);
+
+// Petición de /registers a inverterReadTask, la única que usa los inversores
+enum RegisterQueryState : uint8_t {
+    QUERY_IDLE,                          // Libre
+    QUERY_PENDING                        // Rellenada por el servidor web; la tarea la repite hasta resolverla
+};
+struct RegisterQuery {
+    uint8_t unit;
+    uint16_t start_addr;
+    uint16_t count;
+    uint32_t max_age_ms;
+    uint32_t min_generation;             // También valen los registros de esta generación o posteriores
+};
+// Lo que ha contestado la tarea a la última petición resuelta
+struct RegisterAnswer {
+    RegisterQuery query;
+    DeyeInverter::RegisterRequest result;
+    uint32_t generation;
+    unsigned long now;
+    CachedRegister regs[RegisterReader::MAX_REGISTERS_PER_READ];
+};
+RegisterQuery register_query;
+std::atomic<uint8_t> register_query_state(QUERY_IDLE);
+Seqlock<RegisterAnswer> register_answer;
+std::atomic<uint32_t> cache_generations[InverterSite::MAX_UNITS];  // getCacheGeneration() de cada inversor
 bool systemRunning = true;
 
 lv_obj_t *arc_solar = nullptr;
@@ -174,8 +255,8 @@ void handleSetupPage() {
         <input name="potencia" type="number" value=")rawliteral" + String(potencia_val) + R"rawliteral(" min="1000" max="20000" required>
         <label>Apagado pantalla (minutos):</label>
         <input name="espera" type="number" value=")rawliteral" + String(espera_val) + R"rawliteral(" min="1" max="60" required>
-        <label>Intervalo entre lectura (segundos):</label>
-        <input name="interval" type="number" value=")rawliteral" + String(interval_val) + R"rawliteral(" min="5" max="60" required>
+        <label>Intervalo entre lecturas de potencia (segundos):</label>
+        <input name="interval" type="number" value=")rawliteral" + String(interval_val) + R"rawliteral(" min="2" max="60" required>
         <button type="submit">Guardar y Reiniciar</button>
     </form>
 </body>
@@ -488,133 +569,455 @@ void create_ui() {
 }
 
 // === LECTURA DEL DATALOGGER
+// Perfil de registros guardado en LittleFS; se compila una vez y sirve para todos los inversores
+void loadInverterProfile() {
+    if (!LittleFS.begin(false) || !LittleFS.exists(PROFILE_PATH)) {
+        Serial.println("Sin perfil en LittleFS: registros integrados (Deye híbrido)");
+        return;
+    }
+    File file = LittleFS.open(PROFILE_PATH, "r");
+    size_t len = file.size();
+    char* text = new char[len > 0 ? len : 1];
+    len = file.read((uint8_t*)text, len);
+    file.close();
+    profile_loaded = profile.compile(text, len);
+    delete[] text;
+    if (profile_loaded) {
+        Serial.printf("Perfil \"%s\": %u registros (%u con conversión, %u ignorados)\n", profile.getName(),
+                      (unsigned)profile.getRegisterCount(), (unsigned)profile.getConversionCount(),
+                      profile.getSkippedCount());
+    } else {
+        Serial.printf("%s:%d: %s; se usan los registros integrados\n", PROFILE_PATH, profile.getErrorLine(),
+                      profileErrorLabel(profile.getError()));
+    }
+}
+
+// Tamaño de petición aprendido de cada datalogger, en Preferences ("solar") con su SN en la clave:
+// la mayor petición contestada entera en los 16 bits bajos y la menor rechazada en los altos
+void requestSpanKey(uint8_t unit, char* key, size_t key_size) {
+    char sn_hex[9];
+    solarmans[unit]->getDataloggerSNHex(sn_hex);
+    snprintf(key, key_size, "span%s", sn_hex);
+}
+
+void restoreRequestSpan(uint8_t unit) {
+    char key[16];
+    requestSpanKey(unit, key, sizeof(key));
+    Preferences prefs;
+    prefs.begin("solar", true);
+    saved_spans[unit] = prefs.getUInt(key, 0);
+    prefs.end();
+    if (saved_spans[unit]) {
+        solarmans[unit]->restoreSpan(saved_spans[unit] & 0xFFFF, saved_spans[unit] >> 16);
+        Serial.printf("Datalogger %u: peticiones de hasta %u registros\n", unit, solarmans[unit]->getMaxSpan());
+    }
+}
+
+// Solo se escribe cuando cambia, y cambia pocas veces: la mayor petición buena solo sube y la menor rechazada solo baja
+void saveRequestSpan(uint8_t unit) {
+    SolarmanV5* solarman = solarmans[unit];
+    uint32_t value = ((uint32_t)solarman->getSmallestBadSpan() << 16) | solarman->getLargestGoodSpan();
+    if (value == saved_spans[unit]) return;
+    if ((value >> 16) != (saved_spans[unit] >> 16)) {
+        Serial.printf("Datalogger %u: rechaza peticiones de %u registros, se usan hasta %u\n", unit,
+                      (unsigned)(value >> 16), solarman->getMaxSpan());
+    }
+    char key[16];
+    requestSpanKey(unit, key, sizeof(key));
+    Preferences prefs;
+    prefs.begin("solar", false);
+    prefs.putUInt(key, value);
+    prefs.end();
+    saved_spans[unit] = value;
+}
+
+// Última trama del datalogger decodificada entera (solo inverterReadTask)
+unsigned long last_push_decoded = 0;
+bool push_decoded = false;
+
+// Datos enviados por el primer datalogger por su cuenta (modo servidor): pasan por
+// onUnitRead() y se publican igual que los de una lectura
+void onPushData(uint8_t frame_type, const uint8_t *data, size_t len, void *ctx) {
+    if (site && site->decodePush(0, data, len)) {
+        last_push_decoded = millis();
+        push_decoded = true;
+    }
+}
+
+const char* activeReaderName() {
+    if (rtu) return "rs485";
+    if (gateway) return "modbus_tcp";
+    return "solarman";
+}
+
+void printRequestStats(uint8_t unit, const StatsSnapshot &stats) {
+    const LatencyHistogram &tx = stats.requests.transaction;
+    Serial.printf("Peticiones (%s, %s): %lu, %lu reintentos, %lu timeouts, %lu errores de CRC\n", activeReaderName(),
+                  site->getName(unit), (unsigned long)stats.requests.requests, (unsigned long)stats.requests.retries,
+                  (unsigned long)stats.requests.timeouts, (unsigned long)stats.requests.crc_errors);
+    Serial.printf("  Transacción: media %.1f ms, p50 %.1f ms, p95 %.1f ms, p99 %.1f ms\n", tx.getMean() / 1000.0,
+                  tx.getPercentile(50) / 1000.0, tx.getPercentile(95) / 1000.0, tx.getPercentile(99) / 1000.0);
+    Serial.printf("  Ciclo: %lu (%lu fallidos), p50 %.1f ms, p95 %.1f ms, máx %.1f ms\n",
+                  (unsigned long)stats.cycles.getCount(), (unsigned long)stats.failed_cycles,
+                  stats.cycles.getPercentile(50) / 1000.0, stats.cycles.getPercentile(95) / 1000.0,
+                  stats.cycles.getMax() / 1000.0);
+}
+
+// Pinta la suma de todos los inversores (con uno solo, sus propios datos)
+void updateUi(const SiteData &data) {
+    int solar = data.solar_power;
+    int pv1 = data.pv1_power;
+    int pv2 = data.pv2_power;
+    int soc = (int)(data.battery_soc + 0.5f);
+    int bat_power = data.battery_power;
+    int home = data.load_power;
+    int grid = data.grid_power;
+    float daily_bought = data.daily_energy_bought;
+    float daily_load = data.daily_load_consumption;
+
+    if (lvgl_port_lock(20)) {
+        time_t now = time(nullptr);
+        struct tm local_time;
+        localtime_r(&now, &local_time);
+        char datetime_str[32];
+        strftime(datetime_str, sizeof(datetime_str), "%d/%m/%Y %H:%M", &local_time);
+        if (label_datetime) lv_label_set_text(label_datetime, datetime_str);
+        if (label_inverter_temp) {
+            char temp_str[16];
+            snprintf(temp_str, sizeof(temp_str), "T.Inv %.1f°C ", data.inverter_temperature);
+            lv_label_set_text(label_inverter_temp, temp_str);
+        }
+
+        if (arc_solar) lv_arc_set_value(arc_solar, solar);
+        if (label_solar) {
+            String val = String(solar / 1000.0f, 2);
+            lv_label_set_text(label_solar, val.c_str());
+        }
+
+        if (label_pv1_pv2) {
+            char buf[80];
+            snprintf(buf, sizeof(buf), "%dW y %dW - Hoy: %.2f kWh", pv1, pv2, data.daily_production);
+            lv_label_set_text(label_pv1_pv2, buf);
+        }
+
+        if (arc_bat) {
+            lv_arc_set_value(arc_bat, soc);
+            lv_color_t bat_color = soc > 70 ? color_success : soc > 30 ? color_warn : color_danger;
+            lv_obj_set_style_arc_color(arc_bat, bat_color, LV_PART_INDICATOR);
+        }
+        if (label_bat) {
+            String val = String(soc);
+            lv_label_set_text(label_bat, val.c_str());
+        }
+        if (label_bat_power) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%d W", bat_power);
+            lv_label_set_text(label_bat_power, buf);
+            lv_color_t pwr_color = (bat_power < 0) ? color_success : color_danger;
+            lv_obj_set_style_text_color(label_bat_power, pwr_color, 0);
+        }
+        if (label_bat_temp) {
+            char temp_str[16];
+            snprintf(temp_str, sizeof(temp_str), "%.1f°C ", data.battery_temperature);
+            lv_label_set_text(label_bat_temp, temp_str);
+        }
+        if (arc_red) {
+            lv_arc_set_value(arc_red, abs(grid));
+            lv_color_t grid_color = (grid > 0) ? color_danger : color_success;
+            lv_obj_set_style_arc_color(arc_red, grid_color, LV_PART_INDICATOR);
+        }
+        if (label_red) {
+            String val = String(grid / 1000.0f, 2);
+            lv_label_set_text(label_red, val.c_str());
+            lv_color_t num_color = (grid > 0) ? color_danger : color_success;
+            lv_obj_set_style_text_color(label_red, num_color, 0);
+        }
+        if (label_red_daily) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "Hoy: %.2f kWh", daily_bought);
+            lv_label_set_text(label_red_daily, buf);
+            lv_color_t daily_color = (daily_bought > 0) ? color_danger : lv_color_hex(0xAAAAAA);
+            lv_obj_set_style_text_color(label_red_daily, daily_color, 0);
+        }
+
+        if (arc_home) lv_arc_set_value(arc_home, home);
+        if (label_home) {
+            String val = String(home / 1000.0f, 2);
+            lv_label_set_text(label_home, val.c_str());
+        }
+        if (label_casa_daily) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "Hoy: %.2f kWh", daily_load);
+            lv_label_set_text(label_casa_daily, buf);
+        }
+
+        lvgl_port_unlock();
+        Serial.printf("✓ UI actualizada - Solar: %dW, Bat: %d%%, Casa: %dW\n", solar, soc, home);
+    }
+}
+
+void reportReadError(uint8_t unit) {
+    Serial.printf("✗ Error leyendo datos del inversor %u (%s)\n", unit, site->getName(unit));
+    if (rtu) {
+        Serial.printf("  RS485: %lu sin respuesta, %lu respuestas no válidas\n",
+                      (unsigned long)rtu->getTimeoutCount(), (unsigned long)rtu->getErrorCount());
+    } else if (gateway) {
+        Serial.printf("  Modbus TCP: %lu timeouts, última excepción %u\n",
+                      (unsigned long)gateway->getTimeoutCount(), gateway->getLastException());
+    } else if (solarmans[unit]->getNextProbeIn() > 0) {
+        Serial.printf("  Datalogger sin respuesta: próximo intento en %lu s\n",
+                      (unsigned long)(solarmans[unit]->getNextProbeIn() / 1000));
+    }
+}
+
+// Inversores con una lectura terminada desde la última vuelta (solo inverterReadTask)
+uint8_t updated_units = 0;
+
+void onUnitRead(uint8_t unit, InverterData *data, void *ctx) {
+    updated_units |= 1 << unit;
+    if (!data->data_valid) reportReadError(unit);
+    if (solarmans[unit]) saveRequestSpan(unit);
+}
+
 void inverterReadTask(void *parameter) {
     Serial.println("Tarea de lectura del inversor iniciada en core " + String(xPortGetCoreID()));
+    if (push_server) push_server->onData(onPushData);
+    static StatsSnapshot stats[InverterSite::MAX_UNITS];
+    SiteData site_data;
+    unsigned long last_stats_report = millis();
     while (systemRunning) {
-        if (inverter) {
-            bool success = inverter->readAllData(&inv_data);
-            if (success) {
-                int solar = (int)(inv_data.pv1_power + inv_data.pv2_power);
-                int pv1 = (int)inv_data.pv1_power;
-                int pv2 = (int)inv_data.pv2_power;
-                int soc = (int)inv_data.battery_soc;
-                int bat_power = (int)inv_data.battery_power;
-                int home = (int)inv_data.load_power;
-                int grid = (int)inv_data.grid_power;
-                float daily_bought = inv_data.daily_energy_bought;
-                float daily_load = inv_data.daily_load_consumption;
-
-                if (lvgl_port_lock(20)) {
-                    time_t now = time(nullptr);
-                    struct tm local_time;
-                    localtime_r(&now, &local_time);
-                    char datetime_str[32];
-                    strftime(datetime_str, sizeof(datetime_str), "%d/%m/%Y %H:%M", &local_time);
-                    if (label_datetime) lv_label_set_text(label_datetime, datetime_str);
-                    if (label_inverter_temp) {
-                        char temp_str[16];
-                        snprintf(temp_str, sizeof(temp_str), "T.Inv %.1f°C ", inv_data.inverter_temperature);
-                        lv_label_set_text(label_inverter_temp, temp_str);
-                    }
+        updated_units = 0;
+        if (push_server) push_server->poll();
+        bool push_fresh = push_decoded && millis() - last_push_decoded < PUSH_FRESH_MS;
 
-                    if (arc_solar) lv_arc_set_value(arc_solar, solar);
-                    if (label_solar) {
-                        String val = String(solar / 1000.0f, 2);
-                        lv_label_set_text(label_solar, val.c_str());
-                    }
+        // Cada inversor lee sus clases cuando le tocan (las temperaturas y los
+        // contadores con menos frecuencia que las potencias), todos a la vez y
+        // sin esperarse entre ellos. Un datalogger caído (breaker abierto) solo
+        // retrasa a su inversor, y si el primer datalogger ya envía sus datos no
+        // hace falta preguntarle. site->poll() también manda los heartbeats
+        site->setPaused(0, push_fresh);
+        site->poll();
 
-                    if (label_pv1_pv2) {
-                        char buf[80];
-                        snprintf(buf, sizeof(buf), "%dW y %dW - Hoy: %.2f kWh", pv1, pv2, inv_data.daily_production);
-                        lv_label_set_text(label_pv1_pv2, buf);
-                    }
-
-                    if (arc_bat) {
-                        lv_arc_set_value(arc_bat, soc);
-                        lv_color_t bat_color = soc > 70 ? color_success : soc > 30 ? color_warn : color_danger;
-                        lv_obj_set_style_arc_color(arc_bat, bat_color, LV_PART_INDICATOR);
-                    }
-                    if (label_bat) {
-                        String val = String(soc);
-                        lv_label_set_text(label_bat, val.c_str());
-                    }
-                    if (label_bat_power) {
-                        char buf[32];
-                        snprintf(buf, sizeof(buf), "%d W", bat_power);
-                        lv_label_set_text(label_bat_power, buf);
-                        lv_color_t pwr_color = (bat_power < 0) ? color_success : color_danger;
-                        lv_obj_set_style_text_color(label_bat_power, pwr_color, 0);
-                    }
-                    if (label_bat_temp) {
-                        char temp_str[16];
-                        snprintf(temp_str, sizeof(temp_str), "%.1f°C ", inv_data.battery_temperature);
-                        lv_label_set_text(label_bat_temp, temp_str);
-                    }
-                    if (arc_red) {
-                        lv_arc_set_value(arc_red, abs(grid));
-                        lv_color_t grid_color = (grid > 0) ? color_danger : color_success;
-                        lv_obj_set_style_arc_color(arc_red, grid_color, LV_PART_INDICATOR);
-                    }
-                    if (label_red) {
-                        String val = String(grid / 1000.0f, 2);
-                        lv_label_set_text(label_red, val.c_str());
-                        lv_color_t num_color = (grid > 0) ? color_danger : color_success;
-                        lv_obj_set_style_text_color(label_red, num_color, 0);
-                    }
-                    if (label_red_daily) {
-                        char buf[32];
-                        snprintf(buf, sizeof(buf), "Hoy: %.2f kWh", daily_bought);
-                        lv_label_set_text(label_red_daily, buf);
-                        lv_color_t daily_color = (daily_bought > 0) ? color_danger : lv_color_hex(0xAAAAAA);
-                        lv_obj_set_style_text_color(label_red_daily, daily_color, 0);
+        // Registros pedidos por /registers: se encolan los que no son recientes y se
+        // vuelve a preguntar en cada vuelta, hasta que la caché los tiene todos (los de
+        // min_generation en adelante valen aunque max_age sea 0) o falla su lectura
+        for (uint8_t i = 0; i < unit_count; i++) {
+            cache_generations[i].store(site->getInverter(i)->getCacheGeneration(), std::memory_order_relaxed);
+        }
+        if (register_query_state.load(std::memory_order_acquire) == QUERY_PENDING) {
+            static RegisterAnswer answer;
+            const RegisterQuery& query = register_query;
+            DeyeInverter* inverter = site->getInverter(query.unit);
+            DeyeInverter::RegisterRequest result = inverter->requestRegisters(
+                query.start_addr, query.count, query.max_age_ms, query.min_generation);
+            if (result != DeyeInverter::REGISTERS_PENDING) {
+                answer.query = query;
+                answer.result = result;
+                answer.generation = inverter->getCacheGeneration();
+                answer.now = inverter->getClock()->millis();
+                for (uint16_t i = 0; i < query.count; i++) {
+                    if (!inverter->getCachedRegister(query.start_addr + i, &answer.regs[i])) {
+                        answer.regs[i].generation = 0;
                     }
+                }
+                register_answer.publish(answer);
+                register_query_state.store(QUERY_IDLE, std::memory_order_release);
+            }
+        }
 
-                    if (arc_home) lv_arc_set_value(arc_home, home);
-                    if (label_home) {
-                        String val = String(home / 1000.0f, 2);
-                        lv_label_set_text(label_home, val.c_str());
-                    }
-                    if (label_casa_daily) {
-                        char buf[32];
-                        snprintf(buf, sizeof(buf), "Hoy: %.2f kWh", daily_load);
-                        lv_label_set_text(label_casa_daily, buf);
-                    }
+        if (updated_units) {
+            for (uint8_t i = 0; i < unit_count; i++) {
+                if (updated_units & (1 << i)) inv_snapshots[i].publish(site->getData(i));
+            }
+            site->getSiteData(&site_data);
+            site_snapshot.publish(site_data);
+            if (site_data.units_valid > 0) updateUi(site_data);
+        }
 
-                    lvgl_port_unlock();
-                    Serial.printf("✓ UI actualizada - Solar: %dW, Bat: %d%%, Casa: %dW\n", solar, soc, home);
-                }
-            } else {
-                Serial.println("✗ Error leyendo datos del inversor");
+        // Las estadísticas solo las toca esta tarea; /stats lee la copia publicada
+        bool stats_reset = stats_reset_requested.exchange(false);
+        for (uint8_t i = 0; i < unit_count; i++) {
+            DeyeInverter* inverter = site->getInverter(i);
+            if (stats_reset) {
+                inverter->getReader()->getStats().reset();
+                inverter->getCycleStats().reset();
+            }
+            if ((updated_units & (1 << i)) || stats_reset) {
+                stats[i].requests = inverter->getReader()->getStats();
+                stats[i].cycles = inverter->getCycleStats();
+                stats[i].failed_cycles = inverter->getFailedCycles();
+                stats[i].max_span = inverter->getPlanSpan();
+                stats_snapshots[i].publish(stats[i]);
             }
         }
-        vTaskDelay((config_read_interval  * 1000) / portTICK_PERIOD_MS);
+        if (STATS_REPORT_MS && millis() - last_stats_report >= STATS_REPORT_MS) {
+            last_stats_report = millis();
+            for (uint8_t i = 0; i < unit_count; i++) {
+                printRequestStats(i, stats[i]);
+            }
+        }
+        // Con lecturas en curso se vuelve enseguida para avanzarlas
+        bool busy = site->isBusy() || register_query_state.load(std::memory_order_relaxed) == QUERY_PENDING;
+        vTaskDelay((busy ? BUSY_POLL_MS : POLL_TICK_MS) / portTICK_PERIOD_MS);
     }
     vTaskDelete(NULL);
 }
 
 // === JSON
+// Suma de todos los inversores; /json?unit=N da los datos de uno solo
 void handleJson() {
-    if (!inv_data.data_valid) {
+    SiteData data;
+    if (server.hasArg("unit")) {
+        int unit = server.arg("unit").toInt();
+        if (unit < 0 || unit >= unit_count) {
+            server.send(404, "application/json", "{\"error\":\"Inversor no encontrado\"}");
+            return;
+        }
+        InverterData inv_data;
+        inv_snapshots[unit].read(&inv_data);
+        const InverterData *units[] = {&inv_data};
+        InverterSite::sum(units, 1, &data);
+    } else {
+        site_snapshot.read(&data);
+    }
+    if (!data.data_valid) {
         server.send(503, "application/json", "{\"error\":\"Datos no disponibles\"}");
         return;
     }
     String json = "{";
-    json += "\"inv_temp\":" + String(inv_data.inverter_temperature, 1) + ",";
-    json += "\"solar\":" + String((int)(inv_data.pv1_power + inv_data.pv2_power)) + ",";
-    json += "\"pv1\":" + String((int)inv_data.pv1_power) + ",";
-    json += "\"pv2\":" + String((int)inv_data.pv2_power) + ",";
-    json += "\"daily_production\":" + String(inv_data.daily_production, 2) + ",";
-    json += "\"soc\":" + String((int)inv_data.battery_soc) + ",";
-    json += "\"bat_power\":" + String((int)inv_data.battery_power) + ",";
-    json += "\"bat_temp\":" + String(inv_data.battery_temperature, 1) + ",";
-    json += "\"home\":" + String((int)inv_data.load_power) + ",";
-    json += "\"grid\":" + String((int)inv_data.grid_power) + ",";
-    json += "\"daily_bought\":" + String(inv_data.daily_energy_bought, 2) + ",";
-    json += "\"daily_load\":" + String(inv_data.daily_load_consumption, 2);
+    json += "\"inv_temp\":" + String(data.inverter_temperature, 1) + ",";
+    json += "\"solar\":" + String(data.solar_power) + ",";
+    json += "\"pv1\":" + String(data.pv1_power) + ",";
+    json += "\"pv2\":" + String(data.pv2_power) + ",";
+    json += "\"daily_production\":" + String(data.daily_production, 2) + ",";
+    json += "\"soc\":" + String((int)(data.battery_soc + 0.5f)) + ",";
+    json += "\"bat_power\":" + String(data.battery_power) + ",";
+    json += "\"bat_temp\":" + String(data.battery_temperature, 1) + ",";
+    json += "\"home\":" + String(data.load_power) + ",";
+    json += "\"grid\":" + String(data.grid_power) + ",";
+    json += "\"daily_bought\":" + String(data.daily_energy_bought, 2) + ",";
+    json += "\"daily_load\":" + String(data.daily_load_consumption, 2) + ",";
+    json += "\"units\":" + String(data.unit_count) + ",";
+    json += "\"units_valid\":" + String(data.units_valid);
+    json += "}";
+    server.send(200, "application/json", json);
+}
+
+// Histogramas de tiempos de las peticiones y de los ciclos de lectura de un
+// inversor (/stats?unit=N, el primero por defecto); /stats?reset=1 los pone a cero
+void handleStats() {
+    static StatsSnapshot stats;
+    static char requests_json[RequestStats::JSON_MAX_LEN];
+    static char cycles_json[LatencyHistogram::JSON_MAX_LEN];
+    int unit = server.hasArg("unit") ? server.arg("unit").toInt() : 0;
+    if (unit < 0 || unit >= unit_count) {
+        server.send(404, "application/json", "{\"error\":\"Inversor no encontrado\"}");
+        return;
+    }
+    stats_snapshots[unit].read(&stats);
+    if (!stats.requests.toJson(requests_json, sizeof(requests_json)) ||
+        !stats.cycles.toJson(cycles_json, sizeof(cycles_json))) {
+        server.send(500, "application/json", "{\"error\":\"stats too large\"}");
+        return;
+    }
+    String json = "{";
+    json += "\"reader\":\"" + String(activeReaderName()) + "\",";
+    json += "\"unit\":" + String(unit) + ",";
+    json += "\"name\":\"" + String(site->getName(unit)) + "\",";
+    json += "\"uptime_ms\":" + String(millis()) + ",";
+    json += "\"requests\":" + String(requests_json) + ",";
+    json += "\"cycles\":" + String(cycles_json) + ",";
+    json += "\"failed_cycles\":" + String(stats.failed_cycles) + ",";
+    json += "\"max_span\":" + String(stats.max_span);
     json += "}";
+    if (server.hasArg("reset")) stats_reset_requested = true;
     server.send(200, "application/json", json);
 }
 
+// Registros en bruto: /registers?addr=0x00B8&count=4 (y ?unit=N, ?max_age=MS). Solo
+// inverterReadTask usa los inversores: aquí no se espera. Si la última respuesta publicada
+// por la tarea es de este rango y sus registros son recientes se contesta con ella; si no,
+// se deja la petición a la tarea y se contesta 202 con una generación. Repitiendo la
+// petición con ?generation=N valen los registros leídos desde entonces aunque max_age sea
+// 0: se obtienen en cuanto llegan (200), o 502 una vez si su lectura ha fallado
+void handleRegisters() {
+    static RegisterAnswer answer;        // Fuera de la pila del servidor web
+    static uint32_t served = 0;          // Último fallo de la tarea ya informado (nº de publicación)
+    int unit = server.hasArg("unit") ? server.arg("unit").toInt() : 0;
+    if (unit < 0 || unit >= unit_count) {
+        server.send(404, "application/json", "{\"error\":\"Inversor no encontrado\"}");
+        return;
+    }
+    uint32_t addr = strtoul(server.arg("addr").c_str(), NULL, 0);
+    long count = server.hasArg("count") ? server.arg("count").toInt() : 1;
+    uint32_t max_age = server.hasArg("max_age") ? server.arg("max_age").toInt() : REGISTER_MAX_AGE_MS;
+    if (!server.hasArg("addr") || addr >= DeyeInverter::REGISTER_MAP_SIZE || count < 1 ||
+        count > RegisterReader::MAX_REGISTERS_PER_READ || (uint32_t)count > DeyeInverter::REGISTER_MAP_SIZE - addr) {
+        server.send(400, "application/json", "{\"error\":\"Rango de registros no válido\"}");
+        return;
+    }
+    uint32_t min_generation = server.hasArg("generation")
+        ? strtoul(server.arg("generation").c_str(), NULL, 0)
+        : cache_generations[unit].load(std::memory_order_relaxed) + 1;
+
+    uint32_t published = register_answer.read(&answer);
+    const RegisterQuery& asked = answer.query;
+    bool same = published > 0 && asked.unit == unit && asked.start_addr == addr && asked.count == count &&
+                asked.max_age_ms == max_age;
+    unsigned long now = millis();
+    if (same && answer.result != DeyeInverter::REGISTERS_CACHED && published != served &&
+        now - answer.now < REGISTER_ANSWER_MS) {
+        served = published;
+        if (answer.result == DeyeInverter::REGISTERS_FAILED) {
+            server.send(502, "application/json", "{\"error\":\"Fallo al leer los registros\"}");
+        } else {
+            server.send(503, "application/json", "{\"error\":\"Cola de lecturas llena\"}");
+        }
+        return;
+    }
+    bool fresh = same && answer.result == DeyeInverter::REGISTERS_CACHED;
+    for (long i = 0; fresh && i < count; i++) {
+        const CachedRegister& reg = answer.regs[i];
+        fresh = reg.generation >= min_generation || now - reg.timestamp <= max_age;
+    }
+    if (fresh) {
+        String json = "{";
+        json += "\"status\":\"success\",";
+        json += "\"unit\":" + String(unit) + ",";
+        json += "\"generation\":" + String(answer.generation) + ",";
+        json += "\"registers\":[";
+        for (long i = 0; i < count; i++) {
+            const CachedRegister& reg = answer.regs[i];
+            if (i > 0) json += ",";
+            json += "{\"addr\":" + String(addr + i) + ",";
+            json += "\"value\":" + String(reg.value) + ",";
+            json += "\"age_ms\":" + String(now - reg.timestamp) + ",";
+            json += "\"generation\":" + String(reg.generation) + "}";
+        }
+        json += "]}";
+        server.send(200, "application/json", json);
+        return;
+    }
+
+    // La tarea solo atiende una petición a la vez; a la misma se le contesta que sigue pendiente
+    if (register_query_state.load(std::memory_order_acquire) == QUERY_PENDING) {
+        const RegisterQuery& query = register_query;
+        if (query.unit != unit || query.start_addr != addr || query.count != count || query.max_age_ms != max_age) {
+            server.send(503, "application/json", "{\"error\":\"Lectura anterior en curso\"}");
+            return;
+        }
+    } else {
+        RegisterQuery& query = register_query;
+        query.unit = unit;
+        query.start_addr = addr;
+        query.count = count;
+        query.max_age_ms = max_age;
+        query.min_generation = min_generation;
+        register_query_state.store(QUERY_PENDING, std::memory_order_release);
+    }
+    server.send(202, "application/json", "{\"status\":\"pending\",\"generation\":" + String(min_generation) + "}");
+}
+
 // === WEB
 const char WEBSITE[] PROGMEM = R"rawliteral(
 <!DOCTYPE html>
@@ -856,6 +1259,8 @@ void setup() {
     }
 
     server.on("/data", HTTP_GET, handleJson);
+    server.on("/stats", HTTP_GET, handleStats);
+    server.on("/registers", HTTP_GET, handleRegisters);
     server.on("/reset", HTTP_POST, []() {
         server.send(200, "text/plain", "Reiniciando...");
         delay(100);
@@ -886,9 +1291,54 @@ void setup() {
 
     create_ui();
     const char* datalogger_ip_used = config_datalogger_ip.c_str();
-    solarman = new SolarmanV5(config_datalogger_ip.c_str(), config_datalogger_sn);
-    inverter = new DeyeInverter(solarman);
-    solarman->begin();
+    loadInverterProfile();
+    site = new InverterSite();
+    site->onRead(onUnitRead);
+    if (RS485_RX_PIN >= 0) {
+        // Modbus RTU directo por RS485: sin datalogger de por medio
+        rs485_port = new HardwareSerialPort(&Serial2, RS485_RX_PIN, RS485_TX_PIN, RS485_DE_PIN);
+        rtu = new ModbusRTU(rs485_port, 1, RS485_BAUD);
+        rtu->begin();
+        site->addUnit(new DeyeInverter(rtu), "rs485");
+        Serial.printf("Inversor por RS485 a %lu baudios\n", (unsigned long)RS485_BAUD);
+    } else if (MODBUS_TCP_HOST[0]) {
+        gateway = new ModbusTCP(MODBUS_TCP_HOST, 1, MODBUS_TCP_PORT);
+        gateway->setPipelineDepth(MODBUS_TCP_DEPTH);
+        site->addUnit(new DeyeInverter(gateway), MODBUS_TCP_HOST);
+        Serial.printf("Inversor por Modbus TCP en %s:%u\n", MODBUS_TCP_HOST, MODBUS_TCP_PORT);
+    } else {
+        // Un SolarmanV5 por datalogger: el de /setup y los de EXTRA_DATALOGGERS,
+        // cada uno con su conexión y su circuit breaker
+        DataloggerConfig first = {datalogger_ip_used, config_datalogger_sn};
+        for (uint8_t i = 0; i < InverterSite::MAX_UNITS; i++) {
+            const DataloggerConfig &config = i == 0 ? first : EXTRA_DATALOGGERS[i - 1];
+            if (config.ip == nullptr) break;
+            solarmans[i] = new SolarmanV5(config.ip, config.sn);
+            solarmans[i]->setPipelineDepth(PIPELINE_DEPTH);
+            solarmans[i]->setKeepAlive(KEEPALIVE_MS);
+            solarmans[i]->begin();
+            restoreRequestSpan(i);
+            site->addUnit(new DeyeInverter(solarmans[i]), config.ip);
+            Serial.printf("Inversor %u: datalogger %s, SN %lu\n", i, config.ip, (unsigned long)config.sn);
+        }
+    }
+    unit_count = site->getUnitCount();
+    for (uint8_t i = 0; i < unit_count; i++) {
+        if (profile_loaded && !site->getInverter(i)->setProfile(&profile)) {
+            Serial.printf("El perfil necesita más de %u peticiones; inversor %u con los registros integrados\n",
+                          (unsigned)MAX_PLAN_BLOCKS, i);
+        }
+        site->getInverter(i)->setPollPeriod(POLL_LIVE, config_read_interval * 1000);
+    }
+    if (PUSH_SERVER_PORT) {
+        if (PUSH_LAYOUT_COUNT == 0 || !site->getInverter(0)->setPushLayout(PUSH_LAYOUT, PUSH_LAYOUT_COUNT)) {
+            Serial.println("Sin disposición de las tramas del datalogger (PUSH_LAYOUT): solo se cuentan");
+        }
+        push_server = new SolarmanServer(config_datalogger_sn);
+        if (push_server->begin(PUSH_SERVER_PORT)) {
+            Serial.printf("Esperando datos del datalogger en el puerto %u\n", PUSH_SERVER_PORT);
+        }
+    }
 
     xTaskCreatePinnedToCore(inverterReadTask, "InverterReader", 10000, NULL, 1, NULL, 1);
     Serial.println("=== SISTEMA LISTO ===");
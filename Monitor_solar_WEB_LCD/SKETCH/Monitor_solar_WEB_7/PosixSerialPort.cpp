@@ -0,0 +1,110 @@
+#ifndef ARDUINO
+
+#include "PosixSerialPort.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+static speed_t baudToSpeed(uint32_t baud) {
+    switch (baud) {
+        case 1200: return B1200;
+        case 2400: return B2400;
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        default: return 0;
+    }
+}
+
+PosixSerialPort::PosixSerialPort(const char *device) {
+    _device = device;
+    _fd = -1;
+}
+
+PosixSerialPort::~PosixSerialPort() {
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+bool PosixSerialPort::begin(uint32_t baud) {
+    speed_t speed = baudToSpeed(baud);
+    if (speed == 0) {
+        return false;
+    }
+    if (_fd >= 0) {
+        close(_fd);
+    }
+    _fd = open(_device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (_fd < 0) {
+        return false;
+    }
+
+    struct termios tio;
+    if (tcgetattr(_fd, &tio) != 0) {
+        close(_fd);
+        _fd = -1;
+        return false;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+    tio.c_cflag |= CS8 | CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(_fd, TCSANOW, &tio) != 0) {
+        close(_fd);
+        _fd = -1;
+        return false;
+    }
+    tcflush(_fd, TCIOFLUSH);
+    return true;
+}
+
+int PosixSerialPort::available() {
+    if (_fd < 0) {
+        return 0;
+    }
+    int n = 0;
+    if (ioctl(_fd, FIONREAD, &n) < 0) {
+        return 0;
+    }
+    return n;
+}
+
+int PosixSerialPort::read(uint8_t *buffer, size_t len) {
+    if (_fd < 0) {
+        return -1;
+    }
+    return ::read(_fd, buffer, len);
+}
+
+size_t PosixSerialPort::write(const uint8_t *buffer, size_t len) {
+    if (_fd < 0) {
+        return 0;
+    }
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = ::write(_fd, buffer + sent, len - sent);
+        if (n > 0) {
+            sent += n;
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            break;
+        }
+        struct pollfd pfd = {_fd, POLLOUT, 0};
+        poll(&pfd, 1, 100);
+    }
+    tcdrain(_fd);
+    return sent;
+}
+
+#endif
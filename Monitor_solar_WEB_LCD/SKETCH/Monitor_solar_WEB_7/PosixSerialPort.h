@@ -0,0 +1,31 @@
+#ifndef POSIXSERIALPORT_H
+#define POSIXSERIALPORT_H
+
+#ifndef ARDUINO
+
+#include "SerialPort.h"
+
+/**
+ * @brief Puerto serie del PC: dispositivo tty en modo raw no bloqueante
+ *
+ * Sirve para un adaptador USB-RS485 (/dev/ttyUSB0) o para el pty que crea
+ * el simulador modbus_rtu_sim.
+ */
+class PosixSerialPort : public SerialPort {
+private:
+    const char *_device;
+    int _fd;
+
+public:
+    PosixSerialPort(const char *device);
+    ~PosixSerialPort();
+
+    bool begin(uint32_t baud) override;
+    int available() override;
+    int read(uint8_t *buffer, size_t len) override;
+    size_t write(const uint8_t *buffer, size_t len) override;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,265 @@
+#ifndef ARDUINO
+
+#include "PosixTransport.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+PosixTransport::PosixTransport() {
+    _fd = -1;
+    _connecting = false;
+}
+
+PosixTransport::PosixTransport(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    _fd = fd;
+    _connecting = false;
+}
+
+PosixTransport::~PosixTransport() {
+    stop();
+}
+
+bool PosixTransport::connect(const char *host, uint16_t port, uint32_t timeout_ms) {
+    if (!startConnect(host, port)) {
+        return false;
+    }
+
+    fd_set wfds;
+    FD_ZERO(&wfds);
+    FD_SET(_fd, &wfds);
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    if (select(_fd + 1, NULL, &wfds, NULL, &tv) <= 0) {
+        stop();
+        return false;
+    }
+    return checkConnect() == 1;
+}
+
+bool PosixTransport::startConnect(const char *host, uint16_t port) {
+    stop();
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(host, NULL, &hints, &res) != 0 || res == NULL) {
+        return false;
+    }
+    struct sockaddr_in addr;
+    memcpy(&addr, res->ai_addr, sizeof(addr));
+    freeaddrinfo(res);
+    addr.sin_port = htons(port);
+
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        return false;
+    }
+    // El socket se queda no bloqueante: read() nunca espera
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    if (::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return false;
+    }
+
+    _fd = fd;
+    _connecting = true;
+    return true;
+}
+
+int PosixTransport::checkConnect() {
+    if (_fd < 0) {
+        return -1;
+    }
+    if (!_connecting) {
+        return 1;
+    }
+
+    fd_set wfds;
+    FD_ZERO(&wfds);
+    FD_SET(_fd, &wfds);
+    struct timeval tv = {0, 0};
+
+    int res = select(_fd + 1, NULL, &wfds, NULL, &tv);
+    if (res == 0) {
+        return 0; // Todavía conectando
+    }
+
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (res < 0 || getsockopt(_fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
+        stop();
+        return -1;
+    }
+
+    int nodelay = 1;
+    setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    _connecting = false;
+    return 1;
+}
+
+void PosixTransport::stop() {
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+    _connecting = false;
+}
+
+bool PosixTransport::connected() {
+    if (_fd < 0 || _connecting) {
+        return false;
+    }
+
+    // recv() con MSG_PEEK devuelve 0 cuando el otro extremo ha cerrado
+    uint8_t byte;
+    ssize_t n = recv(_fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        return false;
+    }
+    return true;
+}
+
+int PosixTransport::available() {
+    if (_fd < 0 || _connecting) {
+        return 0;
+    }
+    int count = 0;
+    if (ioctl(_fd, FIONREAD, &count) < 0) {
+        return 0;
+    }
+    return count;
+}
+
+int PosixTransport::read(uint8_t *buffer, size_t len) {
+    if (_fd < 0 || _connecting) {
+        return -1;
+    }
+    return recv(_fd, buffer, len, MSG_DONTWAIT);
+}
+
+size_t PosixTransport::write(const uint8_t *buffer, size_t len) {
+    if (_fd < 0 || _connecting) {
+        return 0;
+    }
+
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = send(_fd, buffer + sent, len - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            // Buffer de envío lleno: esperar a que se vacíe
+            fd_set wfds;
+            FD_ZERO(&wfds);
+            FD_SET(_fd, &wfds);
+            struct timeval tv = {1, 0};
+            if (select(_fd + 1, NULL, &wfds, NULL, &tv) > 0) {
+                continue;
+            }
+        }
+        break;
+    }
+    return sent;
+}
+
+PosixListener::PosixListener() {
+    _fd = -1;
+}
+
+PosixListener::~PosixListener() {
+    stop();
+}
+
+bool PosixListener::begin(uint16_t port) {
+    stop();
+
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 2) < 0) {
+        close(fd);
+        return false;
+    }
+
+    _fd = fd;
+    return true;
+}
+
+Transport *PosixListener::accept() {
+    if (_fd < 0) {
+        return nullptr;
+    }
+    int fd = ::accept(_fd, NULL, NULL);
+    if (fd < 0) {
+        return nullptr;
+    }
+    return new PosixTransport(fd);
+}
+
+void PosixListener::stop() {
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+unsigned long PosixClock::millis() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+unsigned long PosixClock::micros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void PosixClock::delay(unsigned long ms) {
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (ms % 1000) * 1000000;
+    nanosleep(&ts, NULL);
+}
+
+Transport *createDefaultTransport() {
+    return new PosixTransport();
+}
+
+Listener *createDefaultListener() {
+    return new PosixListener();
+}
+
+Clock *defaultClock() {
+    static PosixClock clock;
+    return &clock;
+}
+
+#endif
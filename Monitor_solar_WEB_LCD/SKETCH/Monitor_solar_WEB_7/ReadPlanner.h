@@ -0,0 +1,37 @@
+#ifndef READPLANNER_H
+#define READPLANNER_H
+
+#include "DeyeInverter.h"
+
+/**
+ * @brief Agrupa los registros deseados en el mínimo número de lecturas FC03
+ *
+ * Los registros se recorren por dirección y se van uniendo en bloques
+ * consecutivos. Un hueco de registros no deseados se lee igualmente si no
+ * supera max_gap (sale más barato que otra petición), y ningún bloque supera
+ * max_span registros. Un registro de 32 bits nunca se parte entre dos bloques.
+ */
+class ReadPlanner {
+public:
+    /**
+     * @brief Calcula el plan de lectura de los grupos indicados
+     *
+     * @param regs Tabla de registros
+     * @param reg_count Número de registros de la tabla
+     * @param group_mask Grupos a incluir (bit 1 << RegisterGroup)
+     * @param poll_mask Clases de lectura a incluir (bit 1 << PollClass)
+     * @param max_span Máximo de registros por petición
+     * @param max_gap Máximo de registros no deseados que se leen para no partir un bloque
+     * @param plan Plan resultante
+     * @return true Si el plan cabe en MAX_PLAN_BLOCKS peticiones
+     * @return false Si no cabe o los límites no son válidos (plan queda vacío)
+     */
+    static bool build(const RegisterDescriptor *regs, size_t reg_count, uint8_t group_mask, uint8_t poll_mask,
+                      uint16_t max_span, uint16_t max_gap, ReadPlan *plan);
+
+private:
+    static int findNext(const RegisterDescriptor *regs, size_t reg_count, uint8_t group_mask, uint8_t poll_mask,
+                        uint32_t from);
+};
+
+#endif
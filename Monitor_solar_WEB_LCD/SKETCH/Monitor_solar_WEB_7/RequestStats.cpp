@@ -0,0 +1,114 @@
+#include "RequestStats.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+const uint32_t LatencyHistogram::BUCKET_LIMITS_US[LatencyHistogram::BUCKET_COUNT - 1] = {
+    250, 500, 1000, 2000, 5000, 10000, 20000, 50000,
+    100000, 200000, 500000, 1000000, 2000000, 5000000
+};
+
+void LatencyHistogram::reset() {
+    memset(_buckets, 0, sizeof(_buckets));
+    _count = 0;
+    _sum_us = 0;
+    _min_us = 0xFFFFFFFF;
+    _max_us = 0;
+}
+
+uint32_t LatencyHistogram::getPercentile(uint8_t pct) const {
+    if (_count == 0) {
+        return 0;
+    }
+    uint32_t target = ((uint64_t)_count * pct + 99) / 100;
+    if (target == 0) {
+        target = 1;
+    }
+    uint32_t seen = 0;
+    for (uint8_t b = 0; b < BUCKET_COUNT - 1; b++) {
+        seen += _buckets[b];
+        if (seen >= target) {
+            // El máximo es más preciso que el límite si la cubeta es la última ocupada
+            return BUCKET_LIMITS_US[b] < _max_us ? BUCKET_LIMITS_US[b] : _max_us;
+        }
+    }
+    return _max_us;
+}
+
+// Añade texto con formato al buffer; devuelve false si no cabe
+static bool append(char *buffer, size_t size, size_t *pos, const char *fmt, ...) {
+    if (*pos >= size) {
+        return false;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(&buffer[*pos], size - *pos, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= size - *pos) {
+        return false;
+    }
+    *pos += n;
+    return true;
+}
+
+size_t LatencyHistogram::toJson(char *buffer, size_t size) const {
+    size_t pos = 0;
+    if (!append(buffer, size, &pos, "{\"count\":%lu,\"mean_us\":%lu,\"min_us\":%lu,\"max_us\":%lu,"
+                                    "\"p50_us\":%lu,\"p95_us\":%lu,\"p99_us\":%lu,\"buckets\":[",
+                (unsigned long)_count, (unsigned long)getMean(), (unsigned long)getMin(), (unsigned long)_max_us,
+                (unsigned long)getPercentile(50), (unsigned long)getPercentile(95), (unsigned long)getPercentile(99))) {
+        return 0;
+    }
+    for (uint8_t b = 0; b < BUCKET_COUNT; b++) {
+        if (!append(buffer, size, &pos, b ? ",%lu" : "%lu", (unsigned long)_buckets[b])) {
+            return 0;
+        }
+    }
+    if (!append(buffer, size, &pos, "]}")) {
+        return 0;
+    }
+    return pos;
+}
+
+void RequestStats::reset() {
+    connect.reset();
+    first_byte.reset();
+    transaction.reset();
+    requests = 0;
+    retries = 0;
+    timeouts = 0;
+    crc_errors = 0;
+    bytes_sent = 0;
+    bytes_received = 0;
+}
+
+size_t RequestStats::toJson(char *buffer, size_t size) const {
+    size_t pos = 0;
+    if (!append(buffer, size, &pos, "{\"requests\":%lu,\"retries\":%lu,\"timeouts\":%lu,\"crc_errors\":%lu,"
+                                    "\"bytes_sent\":%lu,\"bytes_received\":%lu,\"bucket_limits_us\":[",
+                (unsigned long)requests, (unsigned long)retries, (unsigned long)timeouts,
+                (unsigned long)crc_errors, (unsigned long)bytes_sent, (unsigned long)bytes_received)) {
+        return 0;
+    }
+    for (uint8_t b = 0; b < LatencyHistogram::BUCKET_COUNT - 1; b++) {
+        if (!append(buffer, size, &pos, b ? ",%lu" : "%lu", (unsigned long)LatencyHistogram::BUCKET_LIMITS_US[b])) {
+            return 0;
+        }
+    }
+    const char *names[] = {"connect", "first_byte", "transaction"};
+    const LatencyHistogram *histograms[] = {&connect, &first_byte, &transaction};
+    for (uint8_t h = 0; h < 3; h++) {
+        if (!append(buffer, size, &pos, h ? ",\"%s\":" : "],\"%s\":", names[h])) {
+            return 0;
+        }
+        size_t n = histograms[h]->toJson(&buffer[pos], size - pos);
+        if (n == 0) {
+            return 0;
+        }
+        pos += n;
+    }
+    if (!append(buffer, size, &pos, "}")) {
+        return 0;
+    }
+    return pos;
+}
@@ -0,0 +1,60 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <string.h>
+#include <type_traits>
+
+/**
+ * @brief Publica una copia coherente de T entre tareas sin mutex
+ *
+ * Un único escritor llama a publish(); cualquier número de lectores, en
+ * cualquier core, llama a read(). El escritor nunca espera: el contador de
+ * secuencia es impar mientras copia, y el lector repite la copia si el
+ * contador ha cambiado o era impar, así que nunca ve un dato a medias.
+ *
+ * T tiene que poder copiarse con memcpy (sin String ni punteros a heap).
+ */
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock necesita un tipo copiable con memcpy");
+
+private:
+    std::atomic<uint32_t> _seq;
+    T _value;
+
+public:
+    Seqlock() : _seq(0) {
+        memset(&_value, 0, sizeof(_value));
+    }
+
+    /**
+     * @brief Publica un nuevo valor (un solo escritor)
+     */
+    void publish(const T &value) {
+        uint32_t seq = _seq.load(std::memory_order_relaxed);
+        _seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&_value, &value, sizeof(T));
+        _seq.store(seq + 2, std::memory_order_release);
+    }
+
+    /**
+     * @brief Copia el último valor publicado
+     *
+     * @param out Destino de la copia
+     * @return Número de publicaciones hasta ahora (0 = aún no se ha publicado nada)
+     */
+    uint32_t read(T *out) const {
+        uint32_t before, after;
+        do {
+            before = _seq.load(std::memory_order_acquire);
+            memcpy(out, &_value, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = _seq.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        return before / 2;
+    }
+};
+
+#endif
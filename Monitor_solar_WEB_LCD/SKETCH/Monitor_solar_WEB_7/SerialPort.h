@@ -0,0 +1,49 @@
+#ifndef SERIALPORT_H
+#define SERIALPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Puerto serie (RS485) conectado al bus Modbus del inversor
+ *
+ * ModbusRTU solo habla con el bus a través de esta interfaz. En el ESP32 la
+ * implementa HardwareSerialPort (UART + pin DE/RE del transceptor) y en el PC
+ * PosixSerialPort (adaptador USB-RS485 o pty del simulador).
+ */
+class SerialPort {
+public:
+    virtual ~SerialPort() {}
+
+    /**
+     * @brief Abre el puerto en modo 8N1
+     *
+     * @param baud Velocidad en baudios
+     * @return true Si el puerto quedó abierto
+     */
+    virtual bool begin(uint32_t baud) = 0;
+
+    /**
+     * @brief Bytes recibidos pendientes de leer
+     */
+    virtual int available() = 0;
+
+    /**
+     * @brief Lee hasta len bytes de los ya recibidos (no bloquea)
+     *
+     * @return int Bytes leídos, o <= 0 si no había nada
+     */
+    virtual int read(uint8_t *buffer, size_t len) = 0;
+
+    /**
+     * @brief Envía len bytes y espera a que salga el último
+     *
+     * No vuelve hasta que la trama ha salido por la línea, así el
+     * transceptor RS485 puede pasar a recepción justo después.
+     *
+     * @return size_t Bytes enviados
+     */
+    virtual size_t write(const uint8_t *buffer, size_t len) = 0;
+};
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef SOLARMANSERVER_H
+#define SOLARMANSERVER_H
+
+#include "Transport.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Callback de trama de datos recibida del datalogger
+ *
+ * @param frame_type Tipo de trama indicado por el datalogger
+ * @param data Datos de la trama, tras la cabecera (tipo, sensor y tiempos)
+ * @param len Longitud de los datos
+ * @param ctx Contexto indicado en onData()
+ */
+typedef void (*SolarmanDataCallback)(uint8_t frame_type, const uint8_t *data, size_t len, void *ctx);
+
+/**
+ * @brief Servidor V5 que hace de "nube" para el datalogger
+ *
+ * El datalogger abre por su cuenta una conexión con el servidor que tenga
+ * configurado (en su web, "Server B") y le envía handshake, heartbeats y
+ * tramas de datos con la cadencia que tenga programada. Este servidor
+ * acepta esa conexión, contesta cada trama como lo haría el servidor
+ * Solarman y entrega las tramas de datos al callback, sin hacer ninguna
+ * petición al datalogger.
+ */
+class SolarmanServer {
+public:
+    static const uint16_t DEFAULT_PORT = 10000;           // Puerto del servidor Solarman
+    static const size_t MAX_FRAME_LEN = 512;              // Trama de datos más larga aceptada
+    static const size_t V5_HEADER_LEN = 11;               // Inicio + longitud + control + secuencia + SN
+    static const size_t V5_TRAILER_LEN = 2;               // Checksum + fin
+    static const size_t V5_DATA_HEADER_LEN = 15;          // Tipo + sensor + tiempos, antes de los datos
+    static const uint32_t IDLE_TIMEOUT_MS = 600000;       // Sin tramas en este tiempo se cierra la conexión
+    static const uint32_t MIN_SYNCED_TIME = 1577836800;   // time() anterior a 2020: reloj sin sincronizar (configTime())
+
+    // Códigos de control V5 (byte alto) que envía el datalogger; la respuesta es el código - 0x30
+    static const uint8_t V5_CONTROL_HANDSHAKE = 0x41;
+    static const uint8_t V5_CONTROL_DATA = 0x42;
+    static const uint8_t V5_CONTROL_INFO = 0x43;
+    static const uint8_t V5_CONTROL_HEARTBEAT = 0x47;
+    static const uint8_t V5_CONTROL_REPORT = 0x48;
+
+private:
+    Listener *_listener;
+    bool _owns_listener;            // El listener por defecto se libera en el destructor
+    Clock *_clock;
+    Transport *_client;             // Conexión del datalogger (solo una a la vez)
+    uint32_t _datalogger_sn;        // SN esperado (0 = cualquiera)
+
+    uint8_t _rx_buffer[MAX_FRAME_LEN];
+    size_t _rx_len;
+    unsigned long _last_rx;
+    unsigned long _last_data;
+
+    SolarmanDataCallback _callback;
+    void *_ctx;
+
+    uint32_t _connect_count;
+    uint32_t _frame_count;
+    uint32_t _data_count;
+    uint32_t _error_count;
+
+    void closeClient();
+    int receiveFrame();
+    bool handleFrame(const uint8_t *frame, size_t len);
+    bool sendAck(const uint8_t *frame);
+
+public:
+    /**
+     * @brief Constructor del servidor
+     *
+     * @param datalogger_sn Número de serie del datalogger del que se aceptan tramas (0 = cualquiera)
+     */
+    SolarmanServer(uint32_t datalogger_sn = 0);
+    ~SolarmanServer();
+
+    SolarmanServer(const SolarmanServer &) = delete;
+    SolarmanServer &operator=(const SolarmanServer &) = delete;
+
+    /**
+     * @brief Sustituye el listener y el reloj de la plataforma
+     *
+     * El listener indicado no pasa a ser propiedad del servidor.
+     *
+     * @param listener Nuevo listener
+     * @param clock Nuevo reloj (nullptr = mantener el actual)
+     */
+    void setListener(Listener *listener, Clock *clock = nullptr);
+
+    /**
+     * @brief Indica la función a la que se entregan las tramas de datos
+     *
+     * @param callback Función llamada desde poll() con cada trama de datos válida
+     * @param ctx Contexto que se pasa al callback
+     */
+    void onData(SolarmanDataCallback callback, void *ctx = nullptr) { _callback = callback; _ctx = ctx; }
+
+    /**
+     * @brief Empieza a escuchar
+     *
+     * @param port Puerto TCP configurado como servidor en el datalogger
+     * @return true Si el puerto quedó abierto
+     */
+    bool begin(uint16_t port = DEFAULT_PORT);
+
+    /**
+     * @brief Cierra la conexión del datalogger y deja de escuchar
+     */
+    void stop();
+
+    /**
+     * @brief Acepta conexiones, recibe tramas y las contesta (no bloquea)
+     *
+     * Debe llamarse periódicamente desde loop() o desde la tarea de lectura.
+     */
+    void poll();
+
+    /**
+     * @brief Indica si el datalogger está conectado
+     */
+    bool hasClient() { return _client != nullptr; }
+
+    /**
+     * @brief Obtiene el tiempo desde la última trama de datos
+     *
+     * @return unsigned long Milisegundos desde la última trama de datos (0xFFFFFFFF si no ha llegado ninguna)
+     */
+    unsigned long getLastDataAge();
+
+    /**
+     * @brief Obtiene el número de conexiones aceptadas desde el arranque
+     */
+    uint32_t getConnectCount() { return _connect_count; }
+
+    /**
+     * @brief Obtiene el número de tramas válidas recibidas (de cualquier tipo)
+     */
+    uint32_t getFrameCount() { return _frame_count; }
+
+    /**
+     * @brief Obtiene el número de tramas de datos recibidas
+     */
+    uint32_t getDataCount() { return _data_count; }
+
+    /**
+     * @brief Obtiene el número de tramas descartadas por no ser válidas
+     */
+    uint32_t getErrorCount() { return _error_count; }
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "SolarmanV5.h"
-#include <WiFi.h>
+#include "ModbusCRC.h"
+#include <string.h>
+#include <time.h>
 
 SolarmanV5::SolarmanV5(const char* datalogger_ip, uint32_t datalogger_sn, uint8_t mb_slave_id, uint16_t datalogger_port) {
     _datalogger_ip = datalogger_ip;
@@ -7,48 +9,79 @@ SolarmanV5::SolarmanV5(const char* datalogger_ip, uint32_t datalogger_sn, uint8_
     _mb_slave_id = mb_slave_id;
     _datalogger_port = datalogger_port;
     _sequence_number = 0x45;
+    _pipeline_depth = 1;
+    _connect_count = 0;
+    _reuse_count = 0;
+    _last_frame_error = SOLARMAN_FRAME_OK;
+    _last_exception = 0;
+    _breaker_state = SOLARMAN_BREAKER_CLOSED;
+    _breaker_threshold = DEFAULT_BREAKER_THRESHOLD;
+    _consecutive_failures = 0;
+    _base_backoff_ms = DEFAULT_BACKOFF_MS;
+    _max_backoff_ms = DEFAULT_MAX_BACKOFF_MS;
+    _backoff_ms = DEFAULT_BACKOFF_MS;
+    _probe_delay_ms = 0;
+    _breaker_opened_at = 0;
+    _jitter_seed = datalogger_sn ^ 0x9E3779B9;
+    _span_limit = MAX_REGISTERS_PER_READ;
+    _span_good = 0;
+    _span_bad = NO_BAD_SPAN;
+    _span_streak = 0;
+    _keepalive_ms = 0;
+    _last_tx = 0;
+    _heartbeat_count = 0;
+    _connect_started_us = 0;
+    _frame_start_us = 0;
+    _transport = createDefaultTransport();
+    _clock = defaultClock();
+    _owns_transport = true;
+    
+    memset(_ops, 0, sizeof(_ops));
+    _next_handle = 0;
+    _async_state = ASYNC_IDLE;
+    _async_timer = 0;
+    _rx_len = 0;
+    _fresh_connection = false;
 }
 
-void SolarmanV5::begin() {
-    // Inicialización si es necesaria
-    // Podemos agregar verificación de conexión aquí en el futuro
+SolarmanV5::~SolarmanV5() {
+    disconnect();
+    if (_owns_transport) {
+        delete _transport;
+    }
 }
 
-uint16_t SolarmanV5::calculateCRC(uint8_t *data, size_t length) {
-    uint16_t crc = 0xFFFF;
-    for (size_t i = 0; i < length; i++) {
-        crc ^= data[i];
-        for (int j = 0; j < 8; j++) {
-            if (crc & 0x0001) {
-                crc = (crc >> 1) ^ 0xA001;
-            } else {
-                crc = crc >> 1;
-            }
-        }
+void SolarmanV5::setTransport(Transport *transport, Clock *clock) {
+    disconnect();
+    if (_owns_transport) {
+        delete _transport;
+    }
+    _transport = transport;
+    _owns_transport = false;
+    if (clock != nullptr) {
+        _clock = clock;
     }
-    return crc;
 }
 
-uint8_t SolarmanV5::calculateV5Checksum(uint8_t *data, size_t length) {
-    uint8_t checksum = 0;
-    for (size_t i = 1; i < length - 2; i++) {
-        checksum += data[i];
-    }
-    return checksum;
+void SolarmanV5::setCircuitBreaker(uint8_t threshold, uint32_t backoff_ms, uint32_t max_backoff_ms) {
+    _breaker_threshold = threshold;
+    _base_backoff_ms = backoff_ms;
+    _max_backoff_ms = max_backoff_ms < backoff_ms ? backoff_ms : max_backoff_ms;
+    recordSuccess();
+}
+
+void SolarmanV5::begin() {
+    // La conexión se abre de forma perezosa en la primera lectura
+}
+
+void SolarmanV5::disconnect() {
+    _transport->stop();
+    failOps(OP_SENT);
+    _async_state = ASYNC_IDLE;
+    _rx_len = 0;
 }
 
 size_t SolarmanV5::buildV5Frame(uint8_t *v5_frame, uint16_t start_addr, uint16_t reg_count) {
-    uint8_t modbus_data[] = {
-        _mb_slave_id,
-        0x03, // Function: Read Holding Registers
-        (uint8_t)((start_addr >> 8) & 0xFF),
-        (uint8_t)(start_addr & 0xFF),
-        (uint8_t)((reg_count >> 8) & 0xFF),
-        (uint8_t)(reg_count & 0xFF)
-    };
-    
-    uint16_t crc_modbus = calculateCRC(modbus_data, sizeof(modbus_data));
-    
     int pos = 0;
     v5_frame[pos++] = 0xA5; // Start
     v5_frame[pos++] = 0x17; // Length low
@@ -68,112 +101,899 @@ size_t SolarmanV5::buildV5Frame(uint8_t *v5_frame, uint16_t start_addr, uint16_t
         v5_frame[pos++] = 0x00;
     }
     
-    memcpy(&v5_frame[pos], modbus_data, sizeof(modbus_data));
-    pos += sizeof(modbus_data);
+    int modbus_start = pos;
+    v5_frame[pos++] = _mb_slave_id;
+    v5_frame[pos++] = 0x03; // Function: Read Holding Registers
+    v5_frame[pos++] = (start_addr >> 8) & 0xFF;
+    v5_frame[pos++] = start_addr & 0xFF;
+    v5_frame[pos++] = (reg_count >> 8) & 0xFF;
+    v5_frame[pos++] = reg_count & 0xFF;
+    
+    // CRC Modbus y checksum V5 (desde el byte 1) en una sola pasada
+    uint8_t v5_checksum;
+    uint16_t crc_modbus = ModbusCRC::computeWithSum(&v5_frame[1], pos - 1, modbus_start - 1, pos - 1, &v5_checksum);
     v5_frame[pos++] = crc_modbus & 0xFF;
     v5_frame[pos++] = (crc_modbus >> 8) & 0xFF;
+    v5_checksum += v5_frame[pos - 2] + v5_frame[pos - 1];
     
-    // Calcular checksum V5
-    uint8_t v5_checksum = calculateV5Checksum(v5_frame, pos + 2);
     v5_frame[pos++] = v5_checksum;
     v5_frame[pos++] = 0x15; // End
     
+    _last_tx = _clock->millis();
+    _stats.requests++;
     return pos;
 }
 
-bool SolarmanV5::sendReceive(uint8_t *request_frame, size_t frame_len, uint8_t *response, size_t *response_len) {
-    WiFiClient client;
+size_t SolarmanV5::buildControlFrame(uint8_t *frame, uint8_t control, uint8_t seq, const uint8_t *payload, size_t payload_len) {
+    size_t pos = 0;
+    frame[pos++] = 0xA5;
+    frame[pos++] = payload_len & 0xFF;
+    frame[pos++] = (payload_len >> 8) & 0xFF;
+    frame[pos++] = 0x10;
+    frame[pos++] = control;
+    frame[pos++] = seq;
+    frame[pos++] = 0x00;
+    frame[pos++] = _datalogger_sn & 0xFF;
+    frame[pos++] = (_datalogger_sn >> 8) & 0xFF;
+    frame[pos++] = (_datalogger_sn >> 16) & 0xFF;
+    frame[pos++] = (_datalogger_sn >> 24) & 0xFF;
+    memcpy(&frame[pos], payload, payload_len);
+    pos += payload_len;
+    frame[pos] = ModbusCRC::sum(&frame[1], pos - 1);
+    pos++;
+    frame[pos++] = 0x15;
+    return pos;
+}
+
+bool SolarmanV5::writeFrame(const uint8_t *frame, size_t len) {
+    size_t sent = _transport->write(frame, len);
+    _stats.bytes_sent += sent;
+    return sent == len;
+}
+
+void SolarmanV5::recordTransaction(unsigned long sent_us) {
+    unsigned long now = _clock->micros();
+    _stats.first_byte.record(_frame_start_us - sent_us);
+    _stats.transaction.record(now - sent_us);
+}
+
+bool SolarmanV5::ensureConnected(bool *reused) {
+    if (_transport->connected()) {
+        // Descartar restos de una respuesta anterior que llegó tarde
+        discardInput();
+        _rx_len = 0;
+        _reuse_count++;
+        *reused = true;
+        return true;
+    }
     
-    if (!client.connect(_datalogger_ip, _datalogger_port, 10000)) {
+    _transport->stop();
+    *reused = false;
+    unsigned long start = _clock->micros();
+    if (!_transport->connect(_datalogger_ip, _datalogger_port, 10000)) {
+        recordFailure();
         return false;
     }
+    _stats.connect.record(_clock->micros() - start);
+    _connect_count++;
+    _fresh_connection = false;
+    return true;
+}
+
+void SolarmanV5::discardInput() {
+    uint8_t scratch[32];
+    while (_transport->available() > 0 && _transport->read(scratch, sizeof(scratch)) > 0) {
+    }
+}
+
+bool SolarmanV5::readExact(uint8_t *buffer, size_t len, unsigned long timeout_ms) {
+    size_t received = 0;
+    unsigned long start_time = _clock->millis();
     
-    client.write(request_frame, frame_len);
-    client.flush();
-    
-    unsigned long start_time = millis();
-    while (client.connected() && !client.available()) {
-        if (millis() - start_time > 5000) {
-            client.stop();
+    while (received < len) {
+        int available = _transport->available();
+        if (available > 0) {
+            size_t chunk = len - received;
+            if ((size_t)available < chunk) chunk = available;
+            int n = _transport->read(&buffer[received], chunk);
+            if (n > 0) {
+                received += n;
+                start_time = _clock->millis();
+                continue;
+            }
+        }
+        if (!_transport->connected() && !_transport->available()) {
+            return false;
+        }
+        if (_clock->millis() - start_time > timeout_ms) {
+            _stats.timeouts++;
             return false;
         }
-        delay(10);
+        _clock->delay(1);
     }
+    return true;
+}
+
+bool SolarmanV5::readFrame(uint8_t *buffer, size_t buffer_size, size_t *frame_len) {
+    *frame_len = 0;
     
-    *response_len = 0;
-    start_time = millis();
+    // Cabecera V5: el primer byte puede tardar lo que tarde el inversor en contestar
+    if (!readExact(buffer, 1, 5000)) {
+        return false;
+    }
+    _frame_start_us = _clock->micros();
+    if (!readExact(&buffer[1], V5_HEADER_LEN - 1, 1000)) {
+        return false;
+    }
+    if (buffer[0] != 0xA5) {
+        return false;
+    }
     
-    while (client.connected() || client.available()) {
-        if (client.available()) {
-            response[(*response_len)++] = client.read();
-            start_time = millis();
-            
-            if (*response_len >= 2 && response[*response_len-1] == 0x15) {
-                delay(50);
-                if (!client.available()) break;
-            }
-            if (*response_len >= 300) break;
-        }
-        if (millis() - start_time > 1000) break;
+    // La longitud del payload viene en la cabecera (little-endian)
+    size_t payload_len = buffer[1] | (buffer[2] << 8);
+    size_t total_len = V5_HEADER_LEN + payload_len + V5_TRAILER_LEN;
+    if (total_len > buffer_size) {
+        return false;
     }
     
-    client.stop();
+    if (!readExact(&buffer[V5_HEADER_LEN], payload_len + V5_TRAILER_LEN, 1000)) {
+        return false;
+    }
+    if (buffer[total_len - 1] != 0x15) {
+        return false;
+    }
     
-    return (*response_len > 0);
+    *frame_len = total_len;
+    _stats.bytes_received += total_len;
+    recordSuccess();
+    return true;
 }
 
-bool SolarmanV5::parseResponse(uint8_t *response, size_t len, uint16_t *value, bool *is_signed) {
-    if (len < 15) {
+bool SolarmanV5::exchange(uint8_t *request_frame, size_t frame_len, uint8_t *response, size_t *response_len) {
+    if (!writeFrame(request_frame, frame_len)) {
         return false;
     }
+    unsigned long sent_us = _clock->micros();
     
-    // Buscar la trama Modbus en la respuesta
-    for (int i = len - 8; i >= 5; i--) {
-        if (response[i] == _mb_slave_id && response[i+1] == 0x03) {
-            uint8_t data_bytes = response[i+2];
-            if (data_bytes == 0x02 && i + 5 < len) {
-                *value = (response[i+3] << 8) | response[i+4];
-                
-                // Verificar CRC Modbus
-                uint16_t received_crc = (response[i+6] << 8) | response[i+5];
-                uint16_t calculated_crc = calculateCRC(&response[i], 5);
-                
-                if (received_crc == calculated_crc) {
-                    // Detectar si el valor es signed
-                    if (is_signed != nullptr) {
-                        *is_signed = (response[i+3] & 0x80) != 0;
-                    }
-                    return true;
-                }
-            }
+    // Descartar respuestas obsoletas (de una petición anterior que expiró)
+    // hasta encontrar la que corresponde a nuestro número de secuencia
+    for (int frames = 0; frames < MAX_PIPELINE_DEPTH + 1; frames++) {
+        if (!readFrame(response, MAX_RESPONSE_LEN, response_len)) {
+            return false;
+        }
+        int protocol = handleProtocolFrame(response, *response_len);
+        if (protocol < 0) {
+            return false;
+        }
+        if (protocol > 0) {
+            continue;
+        }
+        if (response[5] == request_frame[5]) {
+            recordTransaction(sent_us);
+            return true;
+        }
+    }
+    return false;
+}
+
+// ============================================================================
+// CIRCUIT BREAKER
+// ============================================================================
+
+bool SolarmanV5::allowAttempt() {
+    if (_breaker_state == SOLARMAN_BREAKER_OPEN) {
+        if (_clock->millis() - _breaker_opened_at < _probe_delay_ms) {
+            return false;
         }
+        _breaker_state = SOLARMAN_BREAKER_HALF_OPEN;
+    }
+    return true;
+}
+
+void SolarmanV5::recordSuccess() {
+    _consecutive_failures = 0;
+    _backoff_ms = _base_backoff_ms;
+    _breaker_state = SOLARMAN_BREAKER_CLOSED;
+}
+
+void SolarmanV5::recordFailure() {
+    if (_consecutive_failures < 255) {
+        _consecutive_failures++;
+    }
+    if (_breaker_threshold == 0) {
+        return;
+    }
+    
+    if (_breaker_state == SOLARMAN_BREAKER_HALF_OPEN) {
+        // Falló el intento de prueba: esperar el doble
+        _backoff_ms = (_backoff_ms > _max_backoff_ms / 2) ? _max_backoff_ms : _backoff_ms * 2;
+    } else if (_breaker_state == SOLARMAN_BREAKER_CLOSED && _consecutive_failures >= _breaker_threshold) {
+        _backoff_ms = _base_backoff_ms;
+    } else {
+        return;
+    }
+    
+    // Jitter (xorshift32): varios clientes no reintentan todos a la vez
+    _jitter_seed += _clock->millis();
+    if (_jitter_seed == 0) _jitter_seed = 1;
+    _jitter_seed ^= _jitter_seed << 13;
+    _jitter_seed ^= _jitter_seed >> 17;
+    _jitter_seed ^= _jitter_seed << 5;
+    uint32_t half = _backoff_ms / 2;
+    _probe_delay_ms = _backoff_ms - half + _jitter_seed % (half + 1);
+    
+    _breaker_state = SOLARMAN_BREAKER_OPEN;
+    _breaker_opened_at = _clock->millis();
+}
+
+SolarmanBreakerState SolarmanV5::getBreakerState() {
+    if (_breaker_state == SOLARMAN_BREAKER_OPEN && getNextProbeIn() == 0) {
+        return SOLARMAN_BREAKER_HALF_OPEN;
+    }
+    return _breaker_state;
+}
+
+uint32_t SolarmanV5::getNextProbeIn() {
+    if (_breaker_state != SOLARMAN_BREAKER_OPEN) {
+        return 0;
+    }
+    unsigned long elapsed = _clock->millis() - _breaker_opened_at;
+    return elapsed >= _probe_delay_ms ? 0 : _probe_delay_ms - elapsed;
+}
+
+bool SolarmanV5::sendReceive(uint8_t *request_frame, size_t frame_len, uint8_t *response, size_t *response_len) {
+    if (!allowAttempt()) {
+        return false;
     }
     
+    // Un socket reutilizado puede estar medio abierto (el datalogger lo cerró
+    // sin avisar): si no responde se reconecta una vez y se reintenta
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused;
+        if (attempt > 0) {
+            _stats.retries++;
+        }
+        if (!ensureConnected(&reused)) {
+            return false;
+        }
+        if (exchange(request_frame, frame_len, response, response_len)) {
+            return true;
+        }
+        _transport->stop();
+        if (!reused) {
+            recordFailure();
+            return false;
+        }
+    }
     return false;
 }
 
+SolarmanFrameError SolarmanV5::validateFrame(const uint8_t *frame, size_t len, uint8_t seq, uint16_t *pdu_crc) {
+    if (len < V5_HEADER_LEN + V5_PAYLOAD_HEADER_LEN + V5_TRAILER_LEN) {
+        return SOLARMAN_FRAME_BAD_LENGTH;
+    }
+    if (frame[0] != 0xA5) {
+        return SOLARMAN_FRAME_BAD_START;
+    }
+    if (V5_HEADER_LEN + (frame[1] | (frame[2] << 8)) + V5_TRAILER_LEN != len) {
+        return SOLARMAN_FRAME_BAD_LENGTH;
+    }
+    if (frame[3] != 0x10 || frame[4] != 0x15) {
+        return SOLARMAN_FRAME_BAD_CONTROL;
+    }
+    if (frame[5] != seq) {
+        return SOLARMAN_FRAME_BAD_SEQUENCE;
+    }
+    uint32_t sn = frame[7] | (frame[8] << 8) | (frame[9] << 16) | ((uint32_t)frame[10] << 24);
+    if (sn != _datalogger_sn) {
+        return SOLARMAN_FRAME_BAD_SN;
+    }
+    
+    // El CRC de la trama Modbus se calcula en la misma pasada que el checksum
+    // V5. Cubre la cabecera Modbus y los datos que anuncia la propia respuesta
+    const size_t pdu_start = V5_HEADER_LEN + V5_PAYLOAD_HEADER_LEN;
+    const uint8_t *pdu = &frame[pdu_start];
+    size_t pdu_len = len - pdu_start - V5_TRAILER_LEN;
+    size_t crc_len = 0;
+    if (pdu_len >= 5) {
+        if (pdu[1] == 0x83) {
+            crc_len = 3;
+        } else if (pdu_len >= 5 + (size_t)pdu[2]) {
+            crc_len = 3 + pdu[2];
+        }
+    }
+    uint8_t checksum;
+    *pdu_crc = ModbusCRC::computeWithSum(&frame[1], len - 3, pdu_start - 1, pdu_start - 1 + crc_len, &checksum);
+    if (frame[len - 2] != checksum) {
+        _stats.crc_errors++;
+        return SOLARMAN_FRAME_BAD_CHECKSUM;
+    }
+    if (frame[len - 1] != 0x15) {
+        return SOLARMAN_FRAME_BAD_END;
+    }
+    if (frame[V5_HEADER_LEN] != 0x02) {
+        return SOLARMAN_FRAME_BAD_TYPE;
+    }
+    return SOLARMAN_FRAME_OK;
+}
+
+bool SolarmanV5::decodeResponse(const uint8_t *response, size_t len, uint8_t seq, uint16_t *values, uint16_t count) {
+    _last_exception = 0;
+    uint16_t pdu_crc;
+    _last_frame_error = validateFrame(response, len, seq, &pdu_crc);
+    if (_last_frame_error != SOLARMAN_FRAME_OK) {
+        return false;
+    }
+    
+    // La trama Modbus va en posición fija, tras la cabecera del payload V5
+    const uint8_t *pdu = &response[V5_HEADER_LEN + V5_PAYLOAD_HEADER_LEN];
+    size_t pdu_len = len - V5_HEADER_LEN - V5_PAYLOAD_HEADER_LEN - V5_TRAILER_LEN;
+    if (pdu_len < 5) {
+        _last_frame_error = SOLARMAN_FRAME_BAD_LENGTH;
+        return false;
+    }
+    if (pdu[0] != _mb_slave_id) {
+        _last_frame_error = SOLARMAN_FRAME_BAD_SLAVE;
+        return false;
+    }
+    
+    // Excepción: slave + (0x80 | función) + código + CRC
+    if (pdu[1] == 0x83) {
+        if (pdu_crc != (pdu[3] | (pdu[4] << 8))) {
+            _stats.crc_errors++;
+            _last_frame_error = SOLARMAN_FRAME_BAD_CRC;
+            return false;
+        }
+        _last_exception = pdu[2];
+        _last_frame_error = SOLARMAN_FRAME_EXCEPTION;
+        return false;
+    }
+    if (pdu[1] != 0x03) {
+        _last_frame_error = SOLARMAN_FRAME_BAD_FUNCTION;
+        return false;
+    }
+    
+    // Algunos dataloggers añaden bytes tras el CRC: se admiten, pero no que falten
+    size_t data_bytes = (size_t)count * 2;
+    if (pdu[2] != data_bytes || pdu_len < 5 + data_bytes) {
+        _last_frame_error = SOLARMAN_FRAME_BAD_LENGTH;
+        return false;
+    }
+    // pdu_crc ya viene de la pasada única de validateFrame
+    uint16_t received_crc = pdu[3 + data_bytes] | (pdu[4 + data_bytes] << 8);
+    if (pdu_crc != received_crc) {
+        _stats.crc_errors++;
+        _last_frame_error = SOLARMAN_FRAME_BAD_CRC;
+        return false;
+    }
+    
+    for (uint16_t r = 0; r < count; r++) {
+        values[r] = (pdu[3 + r * 2] << 8) | pdu[4 + r * 2];
+    }
+    return true;
+}
+
+bool SolarmanV5::parseResponse(const uint8_t *response, size_t len, uint8_t seq, uint16_t *values, uint16_t count) {
+    bool ok = decodeResponse(response, len, seq, values, count);
+    updateSpan(count, ok);
+    return ok;
+}
+
+void SolarmanV5::updateSpan(uint16_t count, bool ok) {
+    if (ok) {
+        if (count > _span_good) {
+            _span_good = count;
+        }
+        if (_span_limit < _span_good) {
+            _span_limit = _span_good;
+        }
+        if (count >= _span_bad) {
+            _span_bad = NO_BAD_SPAN;    // El fallo no era por el tamaño
+        }
+        // Tras una racha sin fallos se prueba un límite mayor, por debajo del tamaño que falló
+        if (_span_limit + 1 < _span_bad && ++_span_streak >= SPAN_PROBE_INTERVAL) {
+            _span_limit = (_span_limit + _span_bad) / 2;
+            _span_streak = 0;
+        }
+        return;
+    }
+    
+    // Solo cuentan los fallos que puede provocar el tamaño: la excepción de
+    // valor no válido o menos registros de los pedidos. La de dirección no
+    // válida (0x02) llega también cuando el tramo cubre registros sin mapear
+    bool rejected = _last_frame_error == SOLARMAN_FRAME_BAD_LENGTH ||
+                    (_last_frame_error == SOLARMAN_FRAME_EXCEPTION && _last_exception == 0x03);
+    if (!rejected || count <= _span_good || count <= MIN_SPAN) {
+        return;                     // Ese tamaño ya ha funcionado: el fallo es por otra cosa
+    }
+    if (count < _span_bad) {
+        _span_bad = count;
+    }
+    uint16_t limit = (_span_good + _span_bad) / 2;
+    if (limit < MIN_SPAN) {
+        limit = MIN_SPAN;
+    }
+    if (limit < _span_limit) {
+        _span_limit = limit;
+    }
+    _span_streak = 0;
+}
+
+void SolarmanV5::restoreSpan(uint16_t good, uint16_t bad) {
+    if (bad <= MIN_SPAN || bad > NO_BAD_SPAN) {
+        bad = NO_BAD_SPAN;
+    }
+    if (good >= bad) {
+        good = bad - 1;
+    }
+    _span_good = good;
+    _span_bad = bad;
+    _span_streak = 0;
+    if (bad == NO_BAD_SPAN) {
+        _span_limit = MAX_REGISTERS_PER_READ;
+    } else {
+        uint16_t limit = (good + bad) / 2;
+        _span_limit = limit < MIN_SPAN ? MIN_SPAN : limit;
+    }
+}
+
 bool SolarmanV5::readRegister(uint16_t register_addr, uint16_t *value, bool *is_signed) {
+    if (!readHoldingRegisters(register_addr, 1, value)) {
+        return false;
+    }
+    
+    // Detectar si el valor es signed
+    if (is_signed != nullptr) {
+        *is_signed = (*value & 0x8000) != 0;
+    }
+    return true;
+}
+
+bool SolarmanV5::readHoldingRegisters(uint16_t start_addr, uint16_t count, uint16_t *values) {
+    if (count == 0 || count > MAX_REGISTERS_PER_READ || isBusy()) {
+        return false;
+    }
+    
     uint8_t request_frame[40];
-    uint8_t response[300];
+    uint8_t response[MAX_RESPONSE_LEN];
     size_t response_len;
     
-    size_t frame_len = buildV5Frame(request_frame, register_addr, 1);
+    size_t frame_len = buildV5Frame(request_frame, start_addr, count);
     
     if (!sendReceive(request_frame, frame_len, response, &response_len)) {
         return false;
     }
     
-    return parseResponse(response, response_len, value, is_signed);
+    return parseResponse(response, response_len, request_frame[5], values, count);
 }
 
-bool SolarmanV5::readHoldingRegisters(uint16_t start_addr, uint16_t count, uint16_t *values) {
-    // Implementación para leer múltiples registros
-    // Por simplicidad, por ahora leemos uno por uno
-    for (uint16_t i = 0; i < count; i++) {
-        if (!readRegister(start_addr + i, &values[i])) {
-            return false;
+bool SolarmanV5::readPipelined(SolarmanReadRequest *requests, size_t n) {
+    struct InFlight {
+        uint8_t seq;
+        size_t index;
+        unsigned long sent_us;
+        bool active;
+    };
+    InFlight inflight[MAX_PIPELINE_DEPTH] = {};
+    
+    for (size_t i = 0; i < n; i++) {
+        requests[i].ok = false;
+    }
+    if (isBusy() || !allowAttempt()) {
+        return false;
+    }
+    
+    bool reused;
+    if (!ensureConnected(&reused)) {
+        return false;
+    }
+    
+    uint8_t request_frame[40];
+    uint8_t response[MAX_RESPONSE_LEN];
+    size_t next = 0;
+    size_t pending = 0;
+    size_t sent = 0;
+    bool stream_ok = true;
+    
+    while (stream_ok && (next < n || pending > 0)) {
+        // Llenar la ventana de peticiones en vuelo
+        while (pending < _pipeline_depth && next < n) {
+            SolarmanReadRequest *req = &requests[next];
+            if (req->count == 0 || req->count > MAX_REGISTERS_PER_READ) {
+                next++;
+                continue;
+            }
+            size_t frame_len = buildV5Frame(request_frame, req->start_addr, req->count);
+            if (!writeFrame(request_frame, frame_len)) {
+                stream_ok = false;
+                break;
+            }
+            if (sent++ > 0) {
+                _reuse_count++;
+            }
+            for (uint8_t k = 0; k < MAX_PIPELINE_DEPTH; k++) {
+                if (!inflight[k].active) {
+                    inflight[k].seq = request_frame[5];
+                    inflight[k].index = next;
+                    inflight[k].sent_us = _clock->micros();
+                    inflight[k].active = true;
+                    break;
+                }
+            }
+            pending++;
+            next++;
+        }
+        if (!stream_ok || pending == 0) break;
+            
+        size_t response_len;
+        if (!readFrame(response, sizeof(response), &response_len)) {
+            stream_ok = false;
+            break;
+        }
+        
+        int protocol = handleProtocolFrame(response, response_len);
+        if (protocol < 0) {
+            stream_ok = false;
+            break;
+        }
+        if (protocol > 0) {
+            continue;
+        }
+        
+        // Asociar la respuesta a su petición por el número de secuencia
+        int slot = -1;
+        for (uint8_t k = 0; k < MAX_PIPELINE_DEPTH; k++) {
+            if (inflight[k].active && inflight[k].seq == response[5]) {
+                slot = k;
+                break;
+            }
         }
-        delay(100); // Pequeña pausa entre lecturas
+        if (slot < 0) {
+            continue; // Respuesta obsoleta o duplicada
+        }
+        
+        inflight[slot].active = false;
+        pending--;
+        recordTransaction(inflight[slot].sent_us);
+        SolarmanReadRequest *req = &requests[inflight[slot].index];
+        req->ok = parseResponse(response, response_len, inflight[slot].seq, req->values, req->count);
     }
-    return true;
-}
\ No newline at end of file
+    
+    if (!stream_ok) {
+        _transport->stop();
+        recordFailure();
+    }
+    
+    // Reintentar de uno en uno lo que no llegó; si el datalogger deja de
+    // responder no tiene sentido seguir esperando timeouts
+    bool all_ok = true;
+    bool retry = true;
+    for (size_t i = 0; i < n; i++) {
+        if (!requests[i].ok && retry) {
+            _stats.retries++;
+            requests[i].ok = readHoldingRegisters(requests[i].start_addr, requests[i].count, requests[i].values);
+            retry = requests[i].ok;
+        }
+        all_ok = all_ok && requests[i].ok;
+    }
+    return all_ok;
+}
+
+// ============================================================================
+// LECTURA ASÍNCRONA
+// ============================================================================
+
+void SolarmanV5::completeOp(AsyncOp *op, bool ok) {
+    op->status = ok ? OP_DONE : OP_FAILED;
+    if (op->callback) {
+        op->callback(op->handle, ok, op->ctx);
+    }
+}
+
+void SolarmanV5::failOps(uint8_t status) {
+    for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+        if (_ops[i].status == status) {
+            completeOp(&_ops[i], false);
+        }
+    }
+}
+
+int SolarmanV5::beginRead(uint16_t start_addr, uint16_t count, uint16_t *values,
+                          SolarmanReadCallback callback, void *ctx) {
+    if (count == 0 || count > MAX_REGISTERS_PER_READ || values == nullptr) {
+        return -1;
+    }
+    
+    // Usar un hueco libre o el de una lectura ya terminada
+    for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+        AsyncOp *op = &_ops[i];
+        if (op->status == OP_QUEUED || op->status == OP_SENT) {
+            continue;
+        }
+        op->handle = _next_handle;
+        _next_handle = (_next_handle + 1) & 0x7FFFFFFF;
+        op->start_addr = start_addr;
+        op->count = count;
+        op->values = values;
+        op->callback = callback;
+        op->ctx = ctx;
+        op->status = OP_QUEUED;
+        return op->handle;
+    }
+    return -1;
+}
+
+SolarmanReadStatus SolarmanV5::getReadStatus(int handle) {
+    for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+        if (_ops[i].status != OP_FREE && _ops[i].handle == handle) {
+            switch (_ops[i].status) {
+                case OP_DONE: return SOLARMAN_READ_DONE;
+                case OP_FAILED: return SOLARMAN_READ_FAILED;
+                default: return SOLARMAN_READ_PENDING;
+            }
+        }
+    }
+    return SOLARMAN_READ_UNKNOWN;
+}
+
+bool SolarmanV5::isBusy() {
+    if (_async_state == ASYNC_CONNECTING) {
+        return true;
+    }
+    for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+        if (_ops[i].status == OP_QUEUED || _ops[i].status == OP_SENT) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SolarmanV5::poll() {
+    switch (_async_state) {
+        case ASYNC_IDLE: {
+            bool queued = false;
+            for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+                if (_ops[i].status == OP_QUEUED) queued = true;
+            }
+            if (!queued) {
+                serviceKeepAlive();
+                return;
+            }
+            if (!allowAttempt()) {
+                failOps(OP_QUEUED);
+                return;
+            }
+            if (_transport->connected()) {
+                // Descartar restos de una respuesta anterior que llegó tarde
+                discardInput();
+                _rx_len = 0;
+                _async_state = ASYNC_READY;
+                break;
+            }
+            _connect_started_us = _clock->micros();
+            if (!_transport->startConnect(_datalogger_ip, _datalogger_port)) {
+                recordFailure();
+                failOps(OP_QUEUED);
+                return;
+            }
+            _async_state = ASYNC_CONNECTING;
+            _async_timer = _clock->millis();
+            return;
+        }
+        
+        case ASYNC_CONNECTING: {
+            int res = _transport->checkConnect();
+            if (res == 0 && _clock->millis() - _async_timer > 10000) {
+                _transport->stop();
+                res = -1;
+            }
+            if (res == 0) {
+                return;
+            }
+            if (res < 0) {
+                _async_state = ASYNC_IDLE;
+                recordFailure();
+                failOps(OP_QUEUED);
+                return;
+            }
+            _stats.connect.record(_clock->micros() - _connect_started_us);
+            _connect_count++;
+            _fresh_connection = true;
+            _rx_len = 0;
+            _async_state = ASYNC_READY;
+            break;
+        }
+        
+        case ASYNC_READY:
+            break;
+    }
+    
+    pumpAsync();
+}
+
+int SolarmanV5::receiveFrame() {
+    while (_transport->available() > 0) {
+        size_t wanted;
+        if (_rx_len < V5_HEADER_LEN) {
+            wanted = V5_HEADER_LEN - _rx_len;
+        } else {
+            size_t total_len = V5_HEADER_LEN + (_rx_buffer[1] | (_rx_buffer[2] << 8)) + V5_TRAILER_LEN;
+            wanted = total_len - _rx_len;
+        }
+        int n = _transport->read(&_rx_buffer[_rx_len], wanted);
+        if (n <= 0) {
+            break;
+        }
+        if (_rx_len == 0) {
+            _frame_start_us = _clock->micros();
+        }
+        _rx_len += n;
+        _async_timer = _clock->millis();
+        
+        if (_rx_len == V5_HEADER_LEN) {
+            size_t total_len = V5_HEADER_LEN + (_rx_buffer[1] | (_rx_buffer[2] << 8)) + V5_TRAILER_LEN;
+            if (_rx_buffer[0] != 0xA5 || total_len > MAX_RESPONSE_LEN) {
+                return -1;
+            }
+            continue;
+        }
+        if (_rx_len < V5_HEADER_LEN || (size_t)n < wanted) {
+            continue;
+        }
+        
+        // Trama completa
+        size_t frame_len = _rx_len;
+        _rx_len = 0;
+        if (_rx_buffer[frame_len - 1] != 0x15) {
+            return -1;
+        }
+        _stats.bytes_received += frame_len;
+        recordSuccess();
+        return frame_len;
+    }
+    return 0;
+}
+
+// ============================================================================
+// KEEP-ALIVE
+// ============================================================================
+
+int SolarmanV5::handleProtocolFrame(const uint8_t *frame, size_t len) {
+    if (len < V5_HEADER_LEN + V5_TRAILER_LEN || frame[4] == V5_CONTROL_RESPONSE) {
+        return 0;
+    }
+    
+    // Heartbeat del datalogger: se contesta con la hora, como hace el servidor Solarman.
+    // Sin sincronizar, time() cuenta desde el arranque (una fecha de 1970): se manda 0
+    if (frame[4] == V5_CONTROL_HEARTBEAT && _keepalive_ms > 0) {
+        time_t synced = time(nullptr);
+        uint32_t now = synced >= (time_t)MIN_SYNCED_TIME ? (uint32_t)synced : 0;
+        uint8_t payload[10] = {0x00, 0x01,
+                               (uint8_t)now, (uint8_t)(now >> 8), (uint8_t)(now >> 16), (uint8_t)(now >> 24),
+                               0, 0, 0, 0};
+        uint8_t ack[V5_HEADER_LEN + sizeof(payload) + V5_TRAILER_LEN];
+        size_t ack_len = buildControlFrame(ack, V5_CONTROL_HEARTBEAT_ACK, frame[5], payload, sizeof(payload));
+        if (!writeFrame(ack, ack_len)) {
+            return -1;              // Sin ack el datalogger acabará cerrando: se trata como conexión caída
+        }
+    }
+    // Cualquier otra trama de protocolo (incluida la respuesta a nuestro heartbeat) se descarta
+    return 1;
+}
+
+void SolarmanV5::sendHeartbeat() {
+    uint8_t payload[1] = {0x00};
+    uint8_t frame[V5_HEADER_LEN + sizeof(payload) + V5_TRAILER_LEN];
+    size_t frame_len = buildControlFrame(frame, V5_CONTROL_HEARTBEAT, _sequence_number++, payload, sizeof(payload));
+    _last_tx = _clock->millis();
+    if (!writeFrame(frame, frame_len)) {
+        disconnect();
+        return;
+    }
+    _heartbeat_count++;
+}
+
+void SolarmanV5::serviceKeepAlive() {
+    if (_keepalive_ms == 0 || !_transport->connected()) {
+        return;
+    }
+    
+    // Con la conexión ociosa solo llegan heartbeats o respuestas tardías
+    int frame_len;
+    while ((frame_len = receiveFrame()) != 0) {
+        if (frame_len < 0 || handleProtocolFrame(_rx_buffer, frame_len) < 0) {
+            disconnect();
+            return;
+        }
+    }
+    
+    if (_clock->millis() - _last_tx >= _keepalive_ms) {
+        sendHeartbeat();
+    }
+}
+
+void SolarmanV5::pumpAsync() {
+    if (!_transport->connected() && !_transport->available()) {
+        // El datalogger cerró la conexión: se reabrirá para lo que quede en cola
+        disconnect();
+        return;
+    }
+    
+    // Enviar lo que haya en cola respetando la profundidad del pipeline
+    uint8_t in_flight = 0;
+    for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+        if (_ops[i].status == OP_SENT) in_flight++;
+    }
+    for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE && in_flight < _pipeline_depth; i++) {
+        AsyncOp *op = &_ops[i];
+        if (op->status != OP_QUEUED) {
+            continue;
+        }
+        uint8_t request_frame[40];
+        size_t frame_len = buildV5Frame(request_frame, op->start_addr, op->count);
+        if (!writeFrame(request_frame, frame_len)) {
+            disconnect();
+            return;
+        }
+        op->sent_us = _clock->micros();
+        op->seq = request_frame[5];
+        op->status = OP_SENT;
+        if (_fresh_connection) {
+            _fresh_connection = false;
+        } else {
+            _reuse_count++;
+        }
+        if (in_flight == 0) {
+            _async_timer = _clock->millis();
+        }
+        in_flight++;
+    }
+    
+    if (in_flight == 0) {
+        serviceKeepAlive();
+        return;
+    }
+    
+    // Recibir lo que haya disponible sin esperar
+    bool stream_error = false;
+    int frame_len;
+    while ((frame_len = receiveFrame()) != 0) {
+        if (frame_len < 0) {
+            stream_error = true;
+            break;
+        }
+        int protocol = handleProtocolFrame(_rx_buffer, frame_len);
+        if (protocol < 0) {
+            stream_error = true;
+            break;
+        }
+        if (protocol > 0) {
+            continue;
+        }
+        for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+            AsyncOp *op = &_ops[i];
+            if (op->status == OP_SENT && op->seq == _rx_buffer[5]) {
+                recordTransaction(op->sent_us);
+                completeOp(op, parseResponse(_rx_buffer, frame_len, op->seq, op->values, op->count));
+                break;
+            }
+        }
+        // Si no coincide con ninguna petición es obsoleta o duplicada: se descarta
+    }
+    
+    if (!stream_error) {
+        bool waiting = false;
+        for (uint8_t i = 0; i < ASYNC_QUEUE_SIZE; i++) {
+            if (_ops[i].status == OP_SENT) waiting = true;
+        }
+        unsigned long timeout = (_rx_len == 0) ? 5000 : 1000;
+        if (!waiting || _clock->millis() - _async_timer <= timeout) {
+            return;
+        }
+        _stats.timeouts++;
+        recordFailure();
+    }
+    
+    // Trama corrupta o el datalogger dejó de responder
+    disconnect();
+}
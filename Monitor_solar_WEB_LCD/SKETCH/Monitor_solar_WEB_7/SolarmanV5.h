@@ -1,24 +1,167 @@
 #ifndef SOLARMANV5_H
 #define SOLARMANV5_H
 
-#include <WiFiClient.h>
+#include "RegisterReader.h"
+#include "Transport.h"
 #include <stdint.h>
 #include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief Resultado de la validación de la última trama de respuesta
+ */
+enum SolarmanFrameError {
+    SOLARMAN_FRAME_OK,
+    SOLARMAN_FRAME_BAD_START,       // No empieza por 0xA5
+    SOLARMAN_FRAME_BAD_LENGTH,      // Longitud V5 o Modbus incoherente
+    SOLARMAN_FRAME_BAD_CONTROL,     // Código de control distinto de 0x1510
+    SOLARMAN_FRAME_BAD_SEQUENCE,    // Número de secuencia de otra petición
+    SOLARMAN_FRAME_BAD_SN,          // Número de serie de otro datalogger
+    SOLARMAN_FRAME_BAD_CHECKSUM,    // Checksum V5 incorrecto
+    SOLARMAN_FRAME_BAD_END,         // No termina en 0x15
+    SOLARMAN_FRAME_BAD_TYPE,        // Tipo de trama distinto de 0x02
+    SOLARMAN_FRAME_BAD_SLAVE,       // Respuesta de otro esclavo Modbus
+    SOLARMAN_FRAME_BAD_FUNCTION,    // Función Modbus inesperada
+    SOLARMAN_FRAME_BAD_CRC,         // CRC Modbus incorrecto
+    SOLARMAN_FRAME_EXCEPTION        // El inversor respondió con una excepción Modbus
+};
+
+/**
+ * @brief Estado del circuit breaker de la conexión con el datalogger
+ */
+enum SolarmanBreakerState {
+    SOLARMAN_BREAKER_CLOSED,        // Funcionando: las lecturas se intentan
+    SOLARMAN_BREAKER_OPEN,          // Datalogger caído: las lecturas fallan sin esperar
+    SOLARMAN_BREAKER_HALF_OPEN      // Backoff cumplido: se deja pasar un intento de prueba
+};
+
+class SolarmanV5 : public RegisterReader {
+public:
+    static const uint8_t MAX_PIPELINE_DEPTH = 4;          // Peticiones simultáneas en vuelo
+    static const size_t MAX_RESPONSE_LEN = 300;           // Trama V5 más larga esperada (32 + 2*125)
+    static const size_t V5_HEADER_LEN = 11;               // Inicio + longitud + control + secuencia + SN
+    static const size_t V5_TRAILER_LEN = 2;               // Checksum + fin
+    static const size_t V5_PAYLOAD_HEADER_LEN = 14;       // Tipo + estado + tiempos, antes de la trama Modbus
+    static const uint8_t DEFAULT_BREAKER_THRESHOLD = 3;   // Fallos seguidos que abren el breaker
+    static const uint32_t DEFAULT_BACKOFF_MS = 5000;      // Primera espera con el breaker abierto
+    static const uint32_t DEFAULT_MAX_BACKOFF_MS = 300000; // Espera máxima (5 minutos)
+    static const uint16_t MIN_SPAN = 2;                   // Nunca se baja de aquí (registros de 32 bits)
+    static const uint16_t NO_BAD_SPAN = MAX_REGISTERS_PER_READ + 1; // Ningún tamaño rechazado todavía
+    static const uint8_t SPAN_PROBE_INTERVAL = 32;        // Respuestas buenas seguidas antes de probar más registros
+    static const uint32_t MIN_SYNCED_TIME = 1577836800;   // time() anterior a 2020: reloj sin sincronizar (configTime())
+    
+    // Códigos de control V5 (byte alto; el bajo es siempre 0x10)
+    static const uint8_t V5_CONTROL_REQUEST = 0x45;       // Petición Modbus
+    static const uint8_t V5_CONTROL_RESPONSE = 0x15;      // Respuesta Modbus
+    static const uint8_t V5_CONTROL_HEARTBEAT = 0x47;     // Heartbeat
+    static const uint8_t V5_CONTROL_HEARTBEAT_ACK = 0x17; // Respuesta al heartbeat
 
-class SolarmanV5 {
 private:
+    // Estado del cliente asíncrono
+    enum AsyncState {
+        ASYNC_IDLE,                 // Sin conexión en curso
+        ASYNC_CONNECTING,           // connect() no bloqueante en curso
+        ASYNC_READY                 // Conectado: enviando y recibiendo
+    };
+    
+    enum AsyncOpStatus {
+        OP_FREE,
+        OP_QUEUED,
+        OP_SENT,
+        OP_DONE,
+        OP_FAILED
+    };
+    
+    struct AsyncOp {
+        int handle;
+        uint16_t start_addr;
+        uint16_t count;
+        uint16_t *values;
+        SolarmanReadCallback callback;
+        void *ctx;
+        unsigned long sent_us;      // Envío de la petición (estadísticas)
+        uint8_t seq;
+        uint8_t status;
+    };
+    
+
     uint32_t _datalogger_sn;        // Serial Number del datalogger (formato decimal: 2975087801)
     uint8_t _mb_slave_id;           // Slave ID del inversor (normalmente 1)
     uint8_t _sequence_number;       // Contador de secuencia para frames
+    uint8_t _pipeline_depth;        // Peticiones en vuelo en modo pipeline (1 = desactivado)
     const char* _datalogger_ip;     // IP del datalogger en la red local
     uint16_t _datalogger_port;      // Puerto TCP del datalogger (normalmente 8899)
     
+    // Conexión persistente con el datalogger
+    Transport *_transport;
+    Clock *_clock;
+    bool _owns_transport;           // El transporte por defecto se libera en el destructor
+    uint32_t _connect_count;        // Conexiones TCP abiertas
+    uint32_t _reuse_count;          // Peticiones enviadas sobre una conexión ya usada
+    SolarmanFrameError _last_frame_error;
+    uint8_t _last_exception;        // Código de la última excepción Modbus (0 = ninguna)
+    
+    // Instrumentación
+    RequestStats _stats;
+    unsigned long _connect_started_us;  // Inicio del connect() no bloqueante
+    unsigned long _frame_start_us;      // Llegada del primer byte de la última trama
+    
+    // Circuit breaker: evita esperar timeouts mientras el datalogger no responde
+    SolarmanBreakerState _breaker_state;
+    uint8_t _breaker_threshold;
+    uint8_t _consecutive_failures;
+    uint32_t _base_backoff_ms;
+    uint32_t _max_backoff_ms;
+    uint32_t _backoff_ms;           // Backoff actual, se duplica en cada prueba fallida
+    uint32_t _probe_delay_ms;       // Backoff con jitter hasta el próximo intento
+    unsigned long _breaker_opened_at;
+    uint32_t _jitter_seed;
+    
+    // Tamaño máximo de petición que contesta el datalogger (depende del firmware)
+    uint16_t _span_limit;           // Límite actual para los planes de lectura
+    uint16_t _span_good;            // Mayor petición contestada entera (0 = ninguna)
+    uint16_t _span_bad;             // Menor petición rechazada o truncada (NO_BAD_SPAN = ninguna)
+    uint8_t _span_streak;           // Respuestas buenas desde el último cambio de límite
+    
+    // Keep-alive: heartbeats V5 con la conexión ociosa
+    uint32_t _keepalive_ms;         // Intervalo sin tráfico antes de un heartbeat (0 = desactivado)
+    unsigned long _last_tx;         // Última trama enviada
+    uint32_t _heartbeat_count;      // Heartbeats enviados
+    
+    // Cliente asíncrono
+    AsyncOp _ops[ASYNC_QUEUE_SIZE];
+    int _next_handle;
+    AsyncState _async_state;
+    unsigned long _async_timer;     // Inicio de la espera actual (conexión o respuesta)
+    bool _fresh_connection;         // Conexión recién abierta, todavía sin peticiones
+    uint8_t _rx_buffer[MAX_RESPONSE_LEN];
+    size_t _rx_len;
+    
     // Métodos privados
-    uint16_t calculateCRC(uint8_t *data, size_t length);
-    uint8_t calculateV5Checksum(uint8_t *data, size_t length);
     size_t buildV5Frame(uint8_t *v5_frame, uint16_t start_addr, uint16_t reg_count);
+    size_t buildControlFrame(uint8_t *frame, uint8_t control, uint8_t seq, const uint8_t *payload, size_t payload_len);
+    bool writeFrame(const uint8_t *frame, size_t len);
+    void recordTransaction(unsigned long sent_us);
+    int handleProtocolFrame(const uint8_t *frame, size_t len);    // 0 = no es de protocolo, 1 = atendida, -1 = fallo al contestar
+    void sendHeartbeat();
+    void serviceKeepAlive();
+    int receiveFrame();
+    bool ensureConnected(bool *reused);
+    void discardInput();
+    bool readExact(uint8_t *buffer, size_t len, unsigned long timeout_ms);
+    bool readFrame(uint8_t *buffer, size_t buffer_size, size_t *frame_len);
+    bool exchange(uint8_t *request_frame, size_t frame_len, uint8_t *response, size_t *response_len);
     bool sendReceive(uint8_t *request_frame, size_t frame_len, uint8_t *response, size_t *response_len);
-    bool parseResponse(uint8_t *response, size_t len, uint16_t *value, bool *is_signed);
+    SolarmanFrameError validateFrame(const uint8_t *frame, size_t len, uint8_t seq, uint16_t *pdu_crc);
+    bool decodeResponse(const uint8_t *response, size_t len, uint8_t seq, uint16_t *values, uint16_t count);
+    bool parseResponse(const uint8_t *response, size_t len, uint8_t seq, uint16_t *values, uint16_t count);
+    void updateSpan(uint16_t count, bool ok);
+    bool allowAttempt();
+    void recordSuccess();
+    void recordFailure();
+    void completeOp(AsyncOp *op, bool ok);
+    void failOps(uint8_t status);
+    void pumpAsync();
 
 public:
     /**
@@ -30,6 +173,10 @@ public:
      * @param datalogger_port Puerto TCP del datalogger (por defecto 8899)
      */
     SolarmanV5(const char* datalogger_ip, uint32_t datalogger_sn, uint8_t mb_slave_id = 1, uint16_t datalogger_port = 8899);
+    ~SolarmanV5();
+    
+    SolarmanV5(const SolarmanV5 &) = delete;
+    SolarmanV5 &operator=(const SolarmanV5 &) = delete;
     
     /**
      * @brief Inicializa la comunicación con el datalogger
@@ -39,6 +186,15 @@ public:
      */
     void begin();
     
+    /**
+     * @brief Cierra la conexión TCP con el datalogger
+     * 
+     * La conexión se mantiene abierta entre peticiones y se vuelve a abrir
+     * automáticamente en la siguiente lectura. Las lecturas asíncronas que
+     * estaban esperando respuesta se dan por fallidas.
+     */
+    void disconnect();
+    
     /**
      * @brief Lee un solo registro del inversor
      * 
@@ -53,13 +209,74 @@ public:
     /**
      * @brief Lee múltiples registros consecutivos del inversor
      * 
+     * Envía una única trama V5 con la función Modbus 0x03 pidiendo
+     * `count` registros a partir de `start_addr`.
+     * 
      * @param start_addr Dirección inicial del primer registro
-     * @param count Número de registros a leer
+     * @param count Número de registros a leer (1..MAX_REGISTERS_PER_READ)
      * @param values Array donde se almacenarán los valores leídos
-     * @return true Si todas las lecturas fueron exitosas
-     * @return false Si hubo error en alguna lectura
+     * @return true Si la lectura fue exitosa
+     * @return false Si hubo error en la comunicación o la respuesta no es válida
      */
-    bool readHoldingRegisters(uint16_t start_addr, uint16_t count, uint16_t *values);
+    bool readHoldingRegisters(uint16_t start_addr, uint16_t count, uint16_t *values) override;
+    
+    /**
+     * @brief Lee varios bloques de registros manteniendo varias peticiones en vuelo
+     * 
+     * Envía hasta `pipeline_depth` tramas sin esperar respuesta y asocia cada
+     * respuesta a su petición por el número de secuencia V5. Las respuestas
+     * obsoletas o duplicadas se descartan. Los bloques que se quedan sin
+     * respuesta se reintentan uno a uno.
+     * 
+     * @param requests Array de peticiones; se rellena el campo `ok` de cada una
+     * @param n Número de peticiones
+     * @return true Si todos los bloques se leyeron correctamente
+     * @return false Si alguno falló
+     */
+    bool readPipelined(SolarmanReadRequest *requests, size_t n) override;
+    
+    // ============================================================================
+    // LECTURA ASÍNCRONA
+    // ============================================================================
+    
+    /**
+     * @brief Encola la lectura de un bloque de registros sin bloquear
+     * 
+     * La lectura avanza en las sucesivas llamadas a poll(). Mientras haya
+     * lecturas asíncronas pendientes, las lecturas bloqueantes devuelven false.
+     * 
+     * @param start_addr Dirección inicial del primer registro
+     * @param count Número de registros a leer (1..MAX_REGISTERS_PER_READ)
+     * @param values Array donde se almacenarán los valores (debe seguir vivo hasta el final)
+     * @param callback Función a la que se llama al terminar (opcional)
+     * @param ctx Contexto que se pasa al callback
+     * @return int Handle de la lectura, o -1 si la cola está llena o los parámetros no son válidos
+     */
+    int beginRead(uint16_t start_addr, uint16_t count, uint16_t *values,
+                  SolarmanReadCallback callback = nullptr, void *ctx = nullptr) override;
+    
+    /**
+     * @brief Avanza las lecturas asíncronas (conexión, envío, recepción y parseo)
+     * 
+     * No bloquea: debe llamarse periódicamente desde loop(). Sin lecturas
+     * pendientes mantiene viva la conexión si el keep-alive está activo.
+     */
+    void poll() override;
+    
+    /**
+     * @brief Consulta el estado de una lectura asíncrona
+     * 
+     * @param handle Handle devuelto por beginRead()
+     * @return SolarmanReadStatus Estado de la lectura
+     */
+    SolarmanReadStatus getReadStatus(int handle);
+    
+    /**
+     * @brief Indica si hay lecturas asíncronas pendientes
+     * 
+     * @return true Si hay lecturas en cola, conectando o esperando respuesta
+     */
+    bool isBusy() override;
     
     // ============================================================================
     // MÉTODOS DE CONFIGURACIÓN
@@ -79,12 +296,21 @@ public:
      */
     void setSequenceNumber(uint8_t seq) { _sequence_number = seq; }
     
+    /**
+     * @brief Establece cuántas peticiones pueden estar en vuelo a la vez
+     * 
+     * @param depth Profundidad del pipeline (1..MAX_PIPELINE_DEPTH, 1 = desactivado)
+     */
+    void setPipelineDepth(uint8_t depth) {
+        _pipeline_depth = depth < 1 ? 1 : (depth > MAX_PIPELINE_DEPTH ? MAX_PIPELINE_DEPTH : depth);
+    }
+    
     /**
      * @brief Establece una nueva IP para el datalogger
      * 
      * @param new_ip Nueva dirección IP del datalogger
      */
-    void setDataloggerIP(const char* new_ip) { _datalogger_ip = new_ip; }
+    void setDataloggerIP(const char* new_ip) { disconnect(); _datalogger_ip = new_ip; }
     
     /**
      * @brief Establece un nuevo número de serie para el datalogger
@@ -93,6 +319,45 @@ public:
      */
     void setDataloggerSN(uint32_t new_sn) { _datalogger_sn = new_sn; }
     
+    /**
+     * @brief Sustituye el transporte y el reloj de la plataforma
+     * 
+     * Por defecto se usa WiFiTransport en el ESP32 y PosixTransport en el PC.
+     * Cierra la conexión actual. El transporte indicado no pasa a ser
+     * propiedad de SolarmanV5 y debe seguir vivo mientras se use.
+     * 
+     * @param transport Nuevo transporte
+     * @param clock Nuevo reloj (nullptr = mantener el actual)
+     */
+    void setTransport(Transport *transport, Clock *clock = nullptr);
+    
+    /**
+     * @brief Configura el circuit breaker de la conexión
+     * 
+     * Tras `threshold` fallos seguidos (conexión o timeout) las lecturas fallan
+     * al momento. Pasado el backoff se deja pasar un intento de prueba: si
+     * falla, el backoff se duplica hasta `max_backoff_ms`. Cada espera real es
+     * aleatoria entre la mitad y el total del backoff.
+     * 
+     * @param threshold Fallos seguidos que abren el breaker (0 = desactivado)
+     * @param backoff_ms Primera espera
+     * @param max_backoff_ms Espera máxima
+     */
+    void setCircuitBreaker(uint8_t threshold, uint32_t backoff_ms = DEFAULT_BACKOFF_MS,
+                           uint32_t max_backoff_ms = DEFAULT_MAX_BACKOFF_MS);
+    
+    /**
+     * @brief Activa el keep-alive de la conexión persistente
+     * 
+     * Si la conexión lleva `interval_ms` sin enviar nada, poll() manda un
+     * heartbeat V5 (0x4710) para que el datalogger no cierre la sesión entre
+     * lecturas, y contesta los heartbeats que mande el datalogger. Requiere
+     * llamar a poll() periódicamente también con lecturas bloqueantes.
+     * 
+     * @param interval_ms Intervalo sin tráfico antes de un heartbeat (0 = desactivado)
+     */
+    void setKeepAlive(uint32_t interval_ms) { _keepalive_ms = interval_ms; }
+    
     // ============================================================================
     // MÉTODOS DE INFORMACIÓN
     // ============================================================================
@@ -132,13 +397,144 @@ public:
      */
     uint8_t getSequenceNumber() { return _sequence_number; }
     
+    /**
+     * @brief Obtiene la profundidad actual del pipeline
+     * 
+     * @return uint8_t Peticiones en vuelo permitidas
+     */
+    uint8_t getPipelineDepth() { return _pipeline_depth; }
+    
+    /**
+     * @brief Indica si hay una conexión TCP abierta con el datalogger
+     * 
+     * @return true Si el socket sigue abierto
+     */
+    bool isConnected() { return _transport->connected(); }
+    
+    /**
+     * @brief Obtiene el número de conexiones TCP abiertas desde el arranque
+     * 
+     * @return uint32_t Número de conexiones
+     */
+    uint32_t getConnectCount() { return _connect_count; }
+    
+    /**
+     * @brief Obtiene el número de peticiones que reutilizaron una conexión abierta
+     * 
+     * @return uint32_t Número de reutilizaciones
+     */
+    uint32_t getReuseCount() { return _reuse_count; }
+    
+    /**
+     * @brief Obtiene el resultado de validar la última respuesta recibida
+     * 
+     * @return SolarmanFrameError SOLARMAN_FRAME_OK o el primer campo que no cuadró
+     */
+    SolarmanFrameError getLastFrameError() { return _last_frame_error; }
+    
+    /**
+     * @brief Obtiene el código de la última excepción Modbus del inversor
+     * 
+     * @return uint8_t Código de excepción (2 = dirección no válida...), 0 si la última respuesta no lo fue
+     */
+    uint8_t getLastException() { return _last_exception; }
+    
+    /**
+     * @brief Obtiene el estado del circuit breaker
+     * 
+     * @return SolarmanBreakerState Cerrado, abierto o semiabierto
+     */
+    SolarmanBreakerState getBreakerState();
+    
+    /**
+     * @brief Obtiene el tiempo que falta para el próximo intento de prueba
+     * 
+     * @return uint32_t Milisegundos hasta el próximo intento (0 si no está abierto)
+     */
+    uint32_t getNextProbeIn() override;
+    
+    /**
+     * @brief Obtiene el máximo de registros por petición que se usa ahora
+     * 
+     * Empieza en MAX_REGISTERS_PER_READ. Si el datalogger contesta una
+     * petición con la excepción 0x03 (valor no válido), o con menos registros
+     * de los pedidos, y ese tamaño no ha funcionado nunca, el límite baja a
+     * mitad de camino entre el mayor tamaño que funcionó y el que falló. Tras
+     * SPAN_PROBE_INTERVAL respuestas buenas seguidas vuelve a subir a mitad de
+     * camino del que falló, hasta dar con el mayor que contesta. La excepción
+     * 0x02 (dirección no válida) no cuenta: es lo que contesta el datalogger
+     * cuando el tramo pisa registros sin mapear. Los timeouts tampoco: no dicen
+     * nada del tamaño.
+     * 
+     * @return uint16_t Registros por petición (MIN_SPAN..MAX_REGISTERS_PER_READ)
+     */
+    uint16_t getMaxSpan() override { return _span_limit; }
+    
+    /**
+     * @brief Obtiene la mayor petición que el datalogger ha contestado entera
+     * 
+     * @return uint16_t Registros (0 si todavía no ha contestado ninguna)
+     */
+    uint16_t getLargestGoodSpan() { return _span_good; }
+    
+    /**
+     * @brief Obtiene la menor petición que el datalogger ha rechazado o truncado
+     * 
+     * @return uint16_t Registros (NO_BAD_SPAN si no ha fallado ninguna)
+     */
+    uint16_t getSmallestBadSpan() { return _span_bad; }
+    
+    /**
+     * @brief Restaura lo aprendido sobre el tamaño de las peticiones
+     * 
+     * Pensado para guardar getLargestGoodSpan() y getSmallestBadSpan() (por
+     * ejemplo en Preferences) y no repetir los fallos tras cada arranque.
+     * Los valores fuera de rango se corrigen.
+     * 
+     * @param good Mayor petición contestada entera (0 = ninguna)
+     * @param bad Menor petición rechazada o truncada (NO_BAD_SPAN = ninguna)
+     */
+    void restoreSpan(uint16_t good, uint16_t bad);
+    
+    /**
+     * @brief Obtiene el número de fallos de conexión seguidos
+     * 
+     * @return uint8_t Fallos desde la última respuesta recibida
+     */
+    uint8_t getConsecutiveFailures() { return _consecutive_failures; }
+    
+    /**
+     * @brief Obtiene el número de heartbeats enviados desde el arranque
+     * 
+     * @return uint32_t Número de heartbeats
+     */
+    uint32_t getHeartbeatCount() { return _heartbeat_count; }
+    
+    /**
+     * @brief Obtiene el reloj usado por el protocolo
+     * 
+     * @return Clock* Reloj (millis/delay) de la plataforma o el indicado en setTransport()
+     */
+    Clock *getClock() override { return _clock; }
+    
+    /**
+     * @brief Obtiene las estadísticas de las peticiones al datalogger
+     * 
+     * Incluye los tiempos de conexión, hasta el primer byte y de cada
+     * transacción, los bytes enviados y recibidos, los reintentos, los
+     * timeouts y las respuestas con checksum o CRC incorrecto.
+     * 
+     * @return RequestStats& Estadísticas (se pueden reiniciar con reset())
+     */
+    RequestStats &getStats() override { return _stats; }
+    
     /**
      * @brief Convierte el número de serie a formato hexadecimal
      * 
      * @param buffer Buffer donde se almacenará el string hexadecimal (mínimo 9 bytes)
      */
     void getDataloggerSNHex(char *buffer) {
-        sprintf(buffer, "%08lX", _datalogger_sn);
+        sprintf(buffer, "%08lX", (unsigned long)_datalogger_sn);
     }
     
     /**
@@ -163,7 +559,7 @@ public:
         char sn_hex[9];
         getDataloggerSNHex(sn_hex);
         snprintf(buffer, buffer_size, "IP: %s, SN: %lu (0x%s), Slave: %d, Port: %d", 
-                 _datalogger_ip, _datalogger_sn, sn_hex, _mb_slave_id, _datalogger_port);
+                 _datalogger_ip, (unsigned long)_datalogger_sn, sn_hex, _mb_slave_id, _datalogger_port);
     }
 };
 
@@ -0,0 +1,158 @@
+#ifdef ARDUINO
+
+#include "WiFiTransport.h"
+#include <WiFi.h>
+#include <lwip/sockets.h>
+
+WiFiTransport::WiFiTransport() {
+    _connect_fd = -1;
+    _resolved_host[0] = '\0';
+}
+
+WiFiTransport::WiFiTransport(const WiFiClient &client) {
+    _connect_fd = -1;
+    _resolved_host[0] = '\0';
+    _client = client;
+    _client.setNoDelay(true);
+}
+
+WiFiTransport::~WiFiTransport() {
+    stop();
+}
+
+bool WiFiTransport::connect(const char *host, uint16_t port, uint32_t timeout_ms) {
+    stop();
+    return _client.connect(host, port, timeout_ms);
+}
+
+bool WiFiTransport::startConnect(const char *host, uint16_t port) {
+    stop();
+
+    // Un nombre se resuelve solo en la primera conexión (la de setup()): la consulta DNS
+    // bloquea, y aquí se está en loop() o en la tarea de lectura
+    IPAddress ip;
+    if (!ip.fromString(host)) {
+        if (strcmp(host, _resolved_host) != 0) {
+            if (strlen(host) >= sizeof(_resolved_host) || !WiFi.hostByName(host, ip)) {
+                return false;
+            }
+            strcpy(_resolved_host, host);
+            _resolved_ip = ip;
+        }
+        ip = _resolved_ip;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = (uint32_t)ip;
+    addr.sin_port = htons(port);
+
+    if (::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return false;
+    }
+
+    _connect_fd = fd;
+    return true;
+}
+
+int WiFiTransport::checkConnect() {
+    if (_connect_fd < 0) {
+        return -1;
+    }
+
+    fd_set wfds;
+    FD_ZERO(&wfds);
+    FD_SET(_connect_fd, &wfds);
+    struct timeval tv = {0, 0};
+
+    int res = select(_connect_fd + 1, NULL, &wfds, NULL, &tv);
+    if (res == 0) {
+        return 0; // Todavía conectando
+    }
+
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (res < 0 || getsockopt(_connect_fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
+        closeConnect();
+        return -1;
+    }
+
+    // Conectado: el socket vuelve a modo bloqueante y pasa a manos del WiFiClient
+    int fd = _connect_fd;
+    _connect_fd = -1;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    _client = WiFiClient(fd);
+    return 1;
+}
+
+void WiFiTransport::closeConnect() {
+    if (_connect_fd >= 0) {
+        close(_connect_fd);
+        _connect_fd = -1;
+    }
+}
+
+void WiFiTransport::stop() {
+    closeConnect();
+    _client.stop();
+}
+
+WiFiListener::WiFiListener() {
+    _server = nullptr;
+}
+
+WiFiListener::~WiFiListener() {
+    stop();
+}
+
+bool WiFiListener::begin(uint16_t port) {
+    stop();
+    _server = new WiFiServer(port);
+    _server->begin();
+    _server->setNoDelay(true);
+    return true;
+}
+
+Transport *WiFiListener::accept() {
+    if (_server == nullptr) {
+        return nullptr;
+    }
+    WiFiClient client = _server->available();
+    if (!client) {
+        return nullptr;
+    }
+    return new WiFiTransport(client);
+}
+
+void WiFiListener::stop() {
+    if (_server != nullptr) {
+        _server->end();
+        delete _server;
+        _server = nullptr;
+    }
+}
+
+Transport *createDefaultTransport() {
+    return new WiFiTransport();
+}
+
+Listener *createDefaultListener() {
+    return new WiFiListener();
+}
+
+Clock *defaultClock() {
+    static ArduinoClock clock;
+    return &clock;
+}
+
+#endif
@@ -0,0 +1,102 @@
+// Benchmark en el PC de los núcleos CRC16/Modbus y checksum V5.
+//
+// Compara la implementación original bit a bit (CRC y checksum en dos pasadas)
+// con la versión por tabla y con la pasada única que calcula ambos, que es la
+// que usa SolarmanV5 al construir las peticiones y al validar las respuestas.
+//
+// Compilar y ejecutar desde la raíz del repositorio:
+//   cmake -S host -B host/build && cmake --build host/build
+//   ./host/build/crc_bench
+
+#include "ModbusCRC.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Tamaños de trama V5 típicos: petición, respuesta de 1, 10 y 125 registros
+static const size_t FRAME_SIZES[] = {36, 34, 52, 282};
+static const int ITERATIONS = 200000;
+
+static volatile uint32_t sink;
+
+// Trama con la trama Modbus donde la pone el datalogger: cabecera (11) + payload fijo (14)
+struct Frame {
+    uint8_t data[300];
+    size_t len;
+    size_t crc_start;
+    size_t crc_end;
+};
+
+// Trama válida: CRC Modbus y checksum V5 correctos, como la envía el datalogger
+static void fillFrame(Frame *f, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        f->data[i] = (uint8_t)rand();
+    }
+    f->len = len;
+    f->crc_start = 25;
+    f->crc_end = len - 4;  // Sin CRC, checksum ni fin
+    uint16_t crc = ModbusCRC::compute(&f->data[f->crc_start], f->crc_end - f->crc_start);
+    f->data[f->crc_end] = crc & 0xFF;
+    f->data[f->crc_end + 1] = crc >> 8;
+    f->data[len - 2] = ModbusCRC::sum(&f->data[1], len - 3);
+    f->data[len - 1] = 0x15;
+}
+
+template <typename F>
+static double nsPerFrame(F fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        fn();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ITERATIONS;
+}
+
+int main() {
+    printf("%-8s %14s %14s %14s %9s\n", "bytes", "bitwise+sum", "tabla+sum", "una pasada", "mejora");
+    
+    for (size_t n = 0; n < sizeof(FRAME_SIZES) / sizeof(FRAME_SIZES[0]); n++) {
+        Frame f;
+        fillFrame(&f, FRAME_SIZES[n]);
+        const uint8_t *payload = &f.data[1];
+        size_t sum_len = f.len - 3;  // El checksum V5 va del byte 1 al anterior al checksum
+        size_t crc_start = f.crc_start - 1;
+        size_t crc_end = f.crc_end - 1;
+        
+        // Las tres variantes deben dar el mismo resultado
+        uint8_t fused_sum;
+        uint16_t fused_crc = ModbusCRC::computeWithSum(payload, sum_len, crc_start, crc_end, &fused_sum);
+        uint16_t ref_crc = ModbusCRC::computeBitwise(&payload[crc_start], crc_end - crc_start);
+        uint16_t table_crc = ModbusCRC::compute(&payload[crc_start], crc_end - crc_start);
+        uint8_t ref_sum = ModbusCRC::sum(payload, sum_len);
+        if (fused_crc != ref_crc || table_crc != ref_crc || fused_sum != ref_sum) {
+            printf("ERROR: resultados distintos con %zu bytes\n", f.len);
+            return 1;
+        }
+        
+        // La pasada única valida la trama igual que SolarmanV5::validateFrame
+        uint16_t received_crc = f.data[f.crc_end] | (f.data[f.crc_end + 1] << 8);
+        if (fused_crc != received_crc || fused_sum != f.data[f.len - 2]) {
+            printf("ERROR: trama válida rechazada con %zu bytes\n", f.len);
+            return 1;
+        }
+        
+        double bitwise = nsPerFrame([&]() {
+            sink = ModbusCRC::computeBitwise(&payload[crc_start], crc_end - crc_start) + ModbusCRC::sum(payload, sum_len);
+            f.data[30] ^= (uint8_t)sink;
+        });
+        double table = nsPerFrame([&]() {
+            sink = ModbusCRC::compute(&payload[crc_start], crc_end - crc_start) + ModbusCRC::sum(payload, sum_len);
+            f.data[30] ^= (uint8_t)sink;
+        });
+        double fused = nsPerFrame([&]() {
+            uint8_t s;
+            sink = ModbusCRC::computeWithSum(payload, sum_len, crc_start, crc_end, &s) + s;
+            f.data[30] ^= (uint8_t)sink;
+        });
+        
+        printf("%-8zu %11.1f ns %11.1f ns %11.1f ns %8.1fx\n", f.len, bitwise, table, fused, bitwise / fused);
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+// Benchmark en el PC de un ciclo completo de lectura contra un datalogger
+// (real o simulado), usando el mismo SolarmanV5/DeyeInverter que el ESP32.
+//
+// Compilar desde la raíz del repositorio:
+//   cmake -S host -B host/build && cmake --build host/build
+//   ./host/build/poll_bench <ip> <sn> [puerto] [ciclos] [profundidad]
+
+#include "DeyeInverter.h"
+#include "SolarmanV5.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void printStats(const char *name, const double *times, int n, int failures) {
+    double total = 0, min = 1e9, max = 0;
+    for (int i = 0; i < n; i++) {
+        total += times[i];
+        if (times[i] < min) min = times[i];
+        if (times[i] > max) max = times[i];
+    }
+    printf("%-10s ciclos=%d fallos=%d media=%.2f ms min=%.2f ms max=%.2f ms\n",
+           name, n, failures, n ? total / n : 0.0, n ? min : 0.0, max);
+}
+
+// Estadísticas del lector y de los ciclos, tal como las expone /stats en el ESP32
+static void printReaderStats(RegisterReader &reader, DeyeInverter &inverter) {
+    char json[RequestStats::JSON_MAX_LEN];
+    if (reader.getStats().toJson(json, sizeof(json))) {
+        printf("peticiones: %s\n", json);
+    }
+    if (inverter.getCycleStats().toJson(json, sizeof(json))) {
+        printf("ciclos: %s (fallidos=%u)\n", json, inverter.getFailedCycles());
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "uso: %s <ip> <sn> [puerto] [ciclos] [profundidad]\n", argv[0]);
+        return 1;
+    }
+    const char *ip = argv[1];
+    uint32_t sn = strtoul(argv[2], NULL, 10);
+    uint16_t port = argc > 3 ? atoi(argv[3]) : 8899;
+    int cycles = argc > 4 ? atoi(argv[4]) : 100;
+    uint8_t depth = argc > 5 ? atoi(argv[5]) : 3;
+    if (cycles < 1) cycles = 1;
+
+    SolarmanV5 solarman(ip, sn, 1, port);
+    solarman.setPipelineDepth(depth);
+    DeyeInverter inverter(&solarman);
+    printf("Plan de lectura: %zu peticiones, profundidad %u\n", inverter.getReadPlan().count, solarman.getPipelineDepth());
+
+    double *times = new double[cycles];
+    InverterData data;
+
+    // Lectura bloqueante
+    int failures = 0;
+    for (int i = 0; i < cycles; i++) {
+        auto start = std::chrono::steady_clock::now();
+        if (!inverter.readAllData(&data)) failures++;
+        times[i] = elapsedMs(start);
+    }
+    printStats("bloqueante", times, cycles, failures);
+
+    // Lectura asíncrona
+    failures = 0;
+    for (int i = 0; i < cycles; i++) {
+        auto start = std::chrono::steady_clock::now();
+        inverter.beginReadAll(&data);
+        while (inverter.isReading()) {
+            inverter.poll();
+        }
+        if (!data.data_valid) failures++;
+        times[i] = elapsedMs(start);
+    }
+    printStats("asincrona", times, cycles, failures);
+
+    printf("conexiones=%u reutilizaciones=%u\n", solarman.getConnectCount(), solarman.getReuseCount());
+    printReaderStats(solarman, inverter);
+    
+    // Coste de registrar una muestra en un histograma
+    LatencyHistogram histogram;
+    const int samples = 1000000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < samples; i++) {
+        histogram.record((uint32_t)i * 2654435761u % 6000000);
+    }
+    printf("LatencyHistogram::record(): %.1f ns por muestra\n", elapsedMs(start) * 1e6 / samples);
+    if (data.data_valid) {
+        printf("SOC=%.0f%% FV=%u W red=%d W carga=%u W\n", data.battery_soc.value(),
+               data.pv1_power.raw + data.pv2_power.raw, data.grid_power.raw, data.load_power.raw);
+    }
+    delete[] times;
+    return 0;
+}
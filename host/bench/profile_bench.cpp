@@ -0,0 +1,154 @@
+// Compila en el PC un perfil de inversor (formato de los descriptores YAML de
+// HA solarman), muestra la tabla de registros y el plan de lectura que salen
+// de él, y compara el coste de decodificar con el perfil frente a la tabla
+// integrada DEYE_REGISTERS.
+//
+// Compilar y ejecutar desde la raíz del repositorio:
+//   cmake -S host -B host/build && cmake --build host/build
+//   ./host/build/profile_bench profiles/deye_hybrid.yaml [iteraciones]
+
+#include "DeyeInverter.h"
+#include "InverterProfile.h"
+#include "SolarmanV5.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const GROUP_NAMES[GROUP_COUNT] = {"solar", "battery", "grid", "load", "inverter"};
+static const char *const POLL_NAMES[POLL_CLASS_COUNT] = {"live", "thermal", "totals", "static"};
+
+static bool readFile(const char *path, char **text, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    *text = new char[size > 0 ? size : 1];
+    *len = fread(*text, 1, size, f);
+    fclose(f);
+    return true;
+}
+
+// Trama de datos del datalogger con los bloques de la disposición del inversor
+static size_t buildPush(DeyeInverter &inverter, const uint16_t *image, uint8_t *payload) {
+    const ReadPlan &layout = inverter.getPushLayout();
+    size_t pos = 0;
+    for (size_t b = 0; b < layout.count; b++) {
+        for (uint16_t r = 0; r < layout.blocks[b].count; r++) {
+            uint16_t value = image[layout.blocks[b].start_addr + r];
+            payload[pos++] = value >> 8;
+            payload[pos++] = value & 0xFF;
+        }
+    }
+    return pos;
+}
+
+// Nanosegundos por decodificación de una trama completa
+static double timeDecode(DeyeInverter &inverter, const uint8_t *payload, size_t len, int iterations) {
+    InverterData data;
+    memset(&data, 0, sizeof(data));
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        inverter.decodePush(payload, len, &data);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / iterations;
+}
+
+static void printPlan(const char *name, const ReadPlan &plan) {
+    printf("%s: %zu peticiones", name, plan.count);
+    for (size_t b = 0; b < plan.count; b++) {
+        printf(" 0x%04X+%u", plan.blocks[b].start_addr, plan.blocks[b].count);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "uso: %s <perfil.yaml> [iteraciones]\n", argv[0]);
+        return 1;
+    }
+    int iterations = argc > 2 ? atoi(argv[2]) : 1000000;
+    if (iterations < 1) iterations = 1;
+
+    char *text;
+    size_t len;
+    if (!readFile(argv[1], &text, &len)) {
+        perror(argv[1]);
+        return 1;
+    }
+    InverterProfile profile;
+    auto start = std::chrono::steady_clock::now();
+    bool ok = profile.compile(text, len);
+    double compile_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    delete[] text;
+    if (!ok) {
+        fprintf(stderr, "%s:%d: %s\n", argv[1], profile.getErrorLine(), profileErrorLabel(profile.getError()));
+        return 1;
+    }
+    printf("Perfil \"%s\": %zu registros, %zu con conversión, %u elementos ignorados (%.1f us)\n",
+           profile.getName(), profile.getRegisterCount(), profile.getConversionCount(), profile.getSkippedCount(),
+           compile_us);
+    for (size_t i = 0; i < profile.getRegisterCount(); i++) {
+        const RegisterDescriptor &reg = profile.getRegisters()[i];
+        printf("  0x%04X %-2s %-8s %-7s campo +%-3u %u bytes", reg.address, reg.width == 2 ? "x2" : "",
+               GROUP_NAMES[reg.group], POLL_NAMES[reg.poll], reg.field_offset, reg.field_size);
+        if (reg.conversion) {
+            const ValueConversion &conv = profile.getConversions()[reg.conversion - 1];
+            if (conv.lookup_count) {
+                printf("  códigos:");
+                for (uint8_t c = 0; c < conv.lookup_count; c++) {
+                    printf(" %u→%d", c, conv.lookup[c] == UNKNOWN_CODE ? -1 : conv.lookup[c]);
+                }
+            } else {
+                printf("  x%d/%d%+d%s", conv.mul, conv.div, conv.add, conv.raw_signed ? " (con signo)" : "");
+            }
+        }
+        printf("\n");
+    }
+
+    SolarmanV5 reader("127.0.0.1", 0);
+    DeyeInverter builtin(&reader);
+    DeyeInverter custom(&reader);
+    if (!custom.setProfile(&profile)) {
+        fprintf(stderr, "El plan de lectura del perfil no cabe en %zu peticiones\n", MAX_PLAN_BLOCKS);
+        return 1;
+    }
+    // Tramas de datos con los bloques del plan completo de cada uno, como las de datalogger_sim
+    builtin.setPushLayout(builtin.getReadPlan().blocks, builtin.getReadPlan().count);
+    custom.setPushLayout(custom.getReadPlan().blocks, custom.getReadPlan().count);
+    printPlan("Plan integrado", builtin.getReadPlan());
+    printPlan("Plan del perfil", custom.getReadPlan());
+
+    // Imagen de registros aleatoria: misma decodificación si el perfil describe los mismos registros
+    static uint16_t image[DeyeInverter::REGISTER_MAP_SIZE];
+    srand(1);
+    for (size_t r = 0; r < DeyeInverter::REGISTER_MAP_SIZE; r++) {
+        image[r] = rand() & 0xFFFF;
+    }
+    static uint8_t builtin_payload[2 * MAX_PLAN_BLOCKS * RegisterReader::MAX_REGISTERS_PER_READ];
+    static uint8_t custom_payload[sizeof(builtin_payload)];
+    size_t builtin_len = buildPush(builtin, image, builtin_payload);
+    size_t custom_len = buildPush(custom, image, custom_payload);
+
+    InverterData a, b;
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    builtin.decodePush(builtin_payload, builtin_len, &a);
+    custom.decodePush(custom_payload, custom_len, &b);
+    a.timestamp = b.timestamp = 0;
+    printf("Misma decodificación que la tabla integrada: %s\n", memcmp(&a, &b, sizeof(a)) == 0 ? "sí" : "no");
+    printf("Ejemplo: PV1 %u W, SOC %u %%, batería %d W, red %d W, inversor %.1f °C, estado %s\n",
+           b.pv1_power.raw, b.battery_soc.raw, b.battery_power.raw, b.grid_power.raw,
+           b.inverter_temperature.value(), runningStatusLabel(b.running_status));
+
+    double builtin_ns = timeDecode(builtin, builtin_payload, builtin_len, iterations);
+    double custom_ns = timeDecode(custom, custom_payload, custom_len, iterations);
+    printf("Decodificación de una trama completa: integrada %.0f ns, perfil %.0f ns (%d iteraciones)\n",
+           builtin_ns, custom_ns, iterations);
+    return 0;
+}
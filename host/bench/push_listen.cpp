@@ -0,0 +1,72 @@
+// Escucha en el PC las tramas que envía el datalogger a su servidor
+// (SolarmanServer) y muestra los datos decodificados con DeyeInverter.
+//
+// Compilar desde la raíz del repositorio:
+//   cmake -S host -B host/build && cmake --build host/build
+//   ./host/build/push_listen [puerto] [sn]
+// y configurar en el datalogger ("Server B") la IP del PC y ese puerto, o
+// probarlo con ./host/build/datalogger_sim --push 127.0.0.1:10000 --push-interval 5
+//
+// Las tramas se decodifican con los bloques del plan de lectura completo, que
+// es lo que envía datalogger_sim. Con un datalogger real la disposición depende
+// de su firmware: la longitud de los datos y los valores ayudan a averiguarla.
+
+#include "DeyeInverter.h"
+#include "SolarmanServer.h"
+#include "SolarmanV5.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static volatile sig_atomic_t running = 1;
+
+static void onSignal(int) {
+    running = 0;
+}
+
+struct PushContext {
+    DeyeInverter *inverter;
+    InverterData data;
+};
+
+static void onData(uint8_t frame_type, const uint8_t *payload, size_t len, void *ctx) {
+    PushContext *push = (PushContext *)ctx;
+    bool ok = push->inverter->decodePush(payload, len, &push->data);
+    printf("datos tipo=0x%02X %zu bytes completa=%d SOC=%.0f%% FV=%u W red=%d W carga=%u W\n",
+           frame_type, len, ok, push->data.battery_soc.value(),
+           push->data.pv1_power.raw + push->data.pv2_power.raw, push->data.grid_power.raw,
+           push->data.load_power.raw);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    uint16_t port = argc > 1 ? atoi(argv[1]) : SolarmanServer::DEFAULT_PORT;
+    uint32_t sn = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+
+    // DeyeInverter solo se usa para decodificar: nunca se conecta al datalogger
+    SolarmanV5 solarman("127.0.0.1", sn);
+    PushContext push = {new DeyeInverter(&solarman), InverterData()};
+    const ReadPlan &layout = push.inverter->getReadPlan();
+    push.inverter->setPushLayout(layout.blocks, layout.count);
+
+    SolarmanServer server(sn);
+    server.onData(onData, &push);
+    if (!server.begin(port)) {
+        perror("listen");
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    printf("Esperando al datalogger en el puerto %u\n", port);
+    fflush(stdout);
+
+    while (running) {
+        server.poll();
+        solarman.getClock()->delay(10);
+    }
+    printf("conexiones=%u tramas=%u datos=%u errores=%u\n", server.getConnectCount(), server.getFrameCount(),
+           server.getDataCount(), server.getErrorCount());
+    delete push.inverter;
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Benchmark en el PC de un ciclo completo de lectura por Modbus RTU directo
+// (adaptador USB-RS485 o el pty de modbus_rtu_sim), usando el mismo
+// ModbusRTU/DeyeInverter que el ESP32.
+//
+// Compilar desde la raíz del repositorio:
+//   cmake -S host -B host/build && cmake --build host/build
+//   ./host/build/rtu_bench <dispositivo> [baudios] [ciclos] [slave]
+
+#include "DeyeInverter.h"
+#include "ModbusRTU.h"
+#include "PosixSerialPort.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void printStats(const char *name, const double *times, int n, int failures) {
+    double total = 0, min = 1e9, max = 0;
+    for (int i = 0; i < n; i++) {
+        total += times[i];
+        if (times[i] < min) min = times[i];
+        if (times[i] > max) max = times[i];
+    }
+    double mean = n ? total / n : 0.0;
+    printf("%-10s ciclos=%d fallos=%d media=%.2f ms min=%.2f ms max=%.2f ms (%.2f Hz)\n",
+           name, n, failures, mean, n ? min : 0.0, max, mean > 0 ? 1000.0 / mean : 0.0);
+}
+
+// Estadísticas del lector y de los ciclos, tal como las expone /stats en el ESP32
+static void printReaderStats(RegisterReader &reader, DeyeInverter &inverter) {
+    char json[RequestStats::JSON_MAX_LEN];
+    if (reader.getStats().toJson(json, sizeof(json))) {
+        printf("peticiones: %s\n", json);
+    }
+    if (inverter.getCycleStats().toJson(json, sizeof(json))) {
+        printf("ciclos: %s (fallidos=%u)\n", json, inverter.getFailedCycles());
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "uso: %s <dispositivo> [baudios] [ciclos] [slave]\n", argv[0]);
+        return 1;
+    }
+    const char *device = argv[1];
+    uint32_t baud = argc > 2 ? strtoul(argv[2], NULL, 10) : 9600;
+    int cycles = argc > 3 ? atoi(argv[3]) : 20;
+    uint8_t slave = argc > 4 ? atoi(argv[4]) : 1;
+    if (cycles < 1) cycles = 1;
+
+    PosixSerialPort port(device);
+    ModbusRTU rtu(&port, slave, baud);
+    if (!rtu.begin()) {
+        fprintf(stderr, "no se pudo abrir %s a %u baudios\n", device, baud);
+        return 1;
+    }
+    DeyeInverter inverter(&rtu);
+    const ReadPlan &plan = inverter.getReadPlan();
+    unsigned registers = 0;
+    for (size_t i = 0; i < plan.count; i++) {
+        registers += plan.blocks[i].count;
+    }
+    printf("Plan de lectura: %zu peticiones, %u registros, t3.5=%u ms\n", plan.count, registers, rtu.getSilenceMs());
+
+    double *times = new double[cycles];
+    InverterData data;
+
+    // Lectura bloqueante
+    int failures = 0;
+    for (int i = 0; i < cycles; i++) {
+        auto start = std::chrono::steady_clock::now();
+        if (!inverter.readAllData(&data)) failures++;
+        times[i] = elapsedMs(start);
+    }
+    printStats("bloqueante", times, cycles, failures);
+
+    // Lectura asíncrona
+    failures = 0;
+    for (int i = 0; i < cycles; i++) {
+        auto start = std::chrono::steady_clock::now();
+        inverter.beginReadAll(&data);
+        while (inverter.isReading()) {
+            inverter.poll();
+        }
+        if (!data.data_valid) failures++;
+        times[i] = elapsedMs(start);
+    }
+    printStats("asincrona", times, cycles, failures);
+
+    printf("peticiones=%u timeouts=%u errores=%u\n", rtu.getRequestCount(), rtu.getTimeoutCount(), rtu.getErrorCount());
+    printReaderStats(rtu, inverter);
+    if (data.data_valid) {
+        printf("SOC=%.0f%% FV=%u W red=%d W carga=%u W\n", data.battery_soc.value(),
+               data.pv1_power.raw + data.pv2_power.raw, data.grid_power.raw, data.load_power.raw);
+    }
+    delete[] times;
+    return 0;
+}
@@ -0,0 +1,649 @@
+// Simulador en el PC de un datalogger Solarman V5 delante de un inversor Deye.
+//
+// Atiende peticiones V5 con la función Modbus 0x03 sobre una imagen de
+// registros configurable, y permite añadir los defectos de un datalogger real:
+// latencia al aceptar, retardo y jitter por petición, respuestas perdidas,
+// respuestas troceadas en varios segmentos TCP, una sola conexión a la vez,
+// cierre de las conexiones ociosas y un límite de registros por petición por
+// encima del cual trunca la respuesta o contesta con una excepción, como
+// algunas versiones de firmware. Contesta también a los heartbeats V5.
+//
+// Con --push hace además de datalogger que envía sus datos a un servidor
+// (SolarmanServer): se conecta, manda un handshake y, cada cierto tiempo, una
+// trama de datos con los registros en los bloques del plan de lectura
+// completo de DeyeInverter (getReadPlan()), la disposición que usan push_listen
+// y profile_bench.
+//
+// Compilar y ejecutar desde la raíz del repositorio:
+//   cmake -S host -B host/build && cmake --build host/build
+//   ./host/build/datalogger_sim --port 8899 --delay 80 --jitter 40 --drop 2
+//   ./host/build/poll_bench 127.0.0.1 1234567890 8899
+//
+// Opciones:
+//   --port N            Puerto TCP (8899)
+//   --sn N              SN del datalogger; 0 acepta cualquiera (0)
+//   --slave N           Slave ID del inversor (1)
+//   --accept-delay MS   Tiempo que tarda en atender una conexión nueva (0)
+//   --delay MS          Retardo de cada respuesta (0)
+//   --jitter MS         Retardo aleatorio añadido, de 0 a MS (0)
+//   --drop PCT          Porcentaje de peticiones sin respuesta (0)
+//   --split N           Trocea cada respuesta en N segmentos TCP (1)
+//   --split-gap MS      Pausa entre segmentos (2)
+//   --single            Una sola conexión: las demás se cierran nada más aceptarlas
+//   --idle-timeout MS   Cierra la conexión tras MS sin recibir nada, como el datalogger (0)
+//   --max-span N        Registros por petición que contesta enteros; de más, trunca la respuesta (125)
+//   --span-exception    Por encima de --max-span contesta con la excepción 0x03 en lugar de truncar
+//   --reg ADDR=VALOR    Fija un registro (admite 0x.. y valores negativos); repetible
+//   --push IP:PUERTO    Envía tramas de datos a ese servidor
+//   --push-interval S   Segundos entre tramas de datos (60)
+//   --seed N            Semilla del generador aleatorio
+//   --verbose           Muestra cada petición
+
+#include "DeyeInverter.h"
+#include "ModbusCRC.h"
+#include "SolarmanV5.h"
+#include "deye_slave.h"
+
+#include <arpa/inet.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <deque>
+#include <vector>
+
+static const size_t V5_HEADER_LEN = 11;
+static const size_t V5_TRAILER_LEN = 2;
+static const size_t MAX_FRAME_LEN = 1024;
+
+struct Options {
+    uint16_t port;
+    uint32_t sn;
+    uint8_t slave;
+    unsigned accept_delay;
+    unsigned delay;
+    unsigned jitter;
+    unsigned drop_pct;
+    unsigned split;
+    unsigned split_gap;
+    unsigned idle_timeout;
+    unsigned max_span;
+    bool span_exception;
+    const char *push_host;
+    uint16_t push_port;
+    unsigned push_interval;
+    bool single;
+    bool verbose;
+};
+
+struct Segment {
+    unsigned long due;
+    std::vector<uint8_t> bytes;
+};
+
+struct Client {
+    int fd;
+    unsigned long ready_at;         // No se atiende antes (latencia al aceptar)
+    unsigned long last_rx;          // Último dato recibido (cierre por inactividad)
+    std::vector<uint8_t> rx;
+    std::deque<Segment> tx;
+};
+
+struct Stats {
+    unsigned long connections;
+    unsigned long refused;
+    unsigned long requests;
+    unsigned long replies;
+    unsigned long dropped;
+    unsigned long invalid;
+    unsigned long oversized;
+    unsigned long heartbeats;
+    unsigned long idle_closed;
+    unsigned long pushes;
+    unsigned long push_acks;
+};
+
+// Conexión saliente hacia el servidor de --push
+struct PushClient {
+    int fd;
+    unsigned long next_at;
+    uint8_t seq;
+    std::vector<uint8_t> rx;
+};
+
+static Options opts;
+static Stats stats;
+static uint16_t regs[0x10000];
+static ReadPlan push_layout;
+static volatile sig_atomic_t running = 1;
+
+static unsigned long nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void onSignal(int) {
+    running = 0;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "uso: %s [--port N] [--sn N] [--slave N] [--accept-delay MS] [--delay MS] [--jitter MS]\n"
+                    "          [--drop PCT] [--split N] [--split-gap MS] [--single] [--idle-timeout MS]\n"
+                    "          [--max-span N] [--span-exception] [--reg ADDR=VALOR]... [--push IP:PUERTO] [--push-interval S]\n"
+                    "          [--seed N] [--verbose]\n", name);
+}
+
+static bool parseArgs(int argc, char **argv) {
+    opts.port = 8899;
+    opts.sn = 0;
+    opts.slave = 1;
+    opts.split = 1;
+    opts.split_gap = 2;
+    opts.max_span = SLAVE_MAX_REGISTERS_PER_READ;
+    opts.push_interval = 60;
+    srand(time(NULL));
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--single") == 0) {
+            opts.single = true;
+        } else if (strcmp(arg, "--span-exception") == 0) {
+            opts.span_exception = true;
+        } else if (strcmp(arg, "--verbose") == 0) {
+            opts.verbose = true;
+        } else if (value == NULL) {
+            return false;
+        } else {
+            i++;
+            if (strcmp(arg, "--port") == 0) opts.port = atoi(value);
+            else if (strcmp(arg, "--sn") == 0) opts.sn = strtoul(value, NULL, 10);
+            else if (strcmp(arg, "--slave") == 0) opts.slave = atoi(value);
+            else if (strcmp(arg, "--accept-delay") == 0) opts.accept_delay = atoi(value);
+            else if (strcmp(arg, "--delay") == 0) opts.delay = atoi(value);
+            else if (strcmp(arg, "--jitter") == 0) opts.jitter = atoi(value);
+            else if (strcmp(arg, "--drop") == 0) opts.drop_pct = atoi(value);
+            else if (strcmp(arg, "--split") == 0) opts.split = atoi(value) < 1 ? 1 : atoi(value);
+            else if (strcmp(arg, "--split-gap") == 0) opts.split_gap = atoi(value);
+            else if (strcmp(arg, "--idle-timeout") == 0) opts.idle_timeout = atoi(value);
+            else if (strcmp(arg, "--max-span") == 0) opts.max_span = atoi(value) < 1 ? 1 : atoi(value);
+            else if (strcmp(arg, "--push-interval") == 0) opts.push_interval = atoi(value);
+            else if (strcmp(arg, "--push") == 0) {
+                static char host[64];
+                const char *colon = strchr(value, ':');
+                if (colon == NULL || (size_t)(colon - value) >= sizeof(host)) return false;
+                memcpy(host, value, colon - value);
+                host[colon - value] = '\0';
+                opts.push_host = host;
+                opts.push_port = atoi(colon + 1);
+            }
+            else if (strcmp(arg, "--seed") == 0) srand(atoi(value));
+            else if (strcmp(arg, "--reg") == 0) {
+                if (!parseReg(regs, value)) return false;
+            } else {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Respuesta a un heartbeat (0x4710): estado y hora, como el servidor Solarman
+static std::vector<uint8_t> buildHeartbeatAck(const uint8_t *request) {
+    uint32_t now = time(NULL);
+    std::vector<uint8_t> frame(V5_HEADER_LEN + 10 + V5_TRAILER_LEN);
+    frame[0] = 0xA5;
+    frame[1] = 10;
+    frame[3] = 0x10;
+    frame[4] = 0x17;
+    frame[5] = request[5];
+    frame[6] = request[6];
+    memcpy(&frame[7], &request[7], 4);
+    frame[12] = 0x01;
+    for (int i = 0; i < 4; i++) {
+        frame[13 + i] = (now >> (8 * i)) & 0xFF;
+    }
+    frame[frame.size() - 2] = ModbusCRC::sum(&frame[1], frame.size() - 3);
+    frame[frame.size() - 1] = 0x15;
+    return frame;
+}
+
+// Construye la trama V5 de respuesta alrededor de la trama Modbus
+static std::vector<uint8_t> buildResponse(const uint8_t *request, const uint8_t *modbus, size_t modbus_len) {
+    size_t payload_len = 14 + modbus_len;
+    std::vector<uint8_t> frame(V5_HEADER_LEN + payload_len + V5_TRAILER_LEN);
+    uint32_t uptime = nowMs() / 1000;
+
+    frame[0] = 0xA5;
+    frame[1] = payload_len & 0xFF;
+    frame[2] = (payload_len >> 8) & 0xFF;
+    frame[3] = 0x10;                        // Control: respuesta (0x1510)
+    frame[4] = 0x15;
+    frame[5] = request[5];                  // Misma secuencia que la petición
+    frame[6] = request[6];
+    memcpy(&frame[7], &request[7], 4);      // SN
+    frame[11] = 0x02;                       // Tipo de trama
+    frame[12] = 0x01;                       // Estado
+    for (int i = 0; i < 4; i++) {
+        frame[13 + i] = (uptime >> (8 * i)) & 0xFF;  // Tiempo de funcionamiento
+    }
+    memcpy(&frame[25], modbus, modbus_len);
+
+    size_t checksum_pos = frame.size() - 2;
+    frame[checksum_pos] = ModbusCRC::sum(&frame[1], checksum_pos - 1);
+    frame[checksum_pos + 1] = 0x15;
+    return frame;
+}
+
+// Trama Modbus de respuesta (lectura o excepción); vacía si no hay que responder
+static std::vector<uint8_t> handleModbus(const uint8_t *pdu, size_t len) {
+    if (len < 8 || ModbusCRC::compute(pdu, 6) != (pdu[6] | (pdu[7] << 8))) {
+        stats.invalid++;
+        return std::vector<uint8_t>();
+    }
+    if (pdu[0] != opts.slave) {
+        return std::vector<uint8_t>();      // Otro esclavo: el inversor no contesta
+    }
+    uint16_t count = (pdu[4] << 8) | pdu[5];
+    if (pdu[1] == 0x03 && count > opts.max_span) {
+        stats.oversized++;
+        if (opts.span_exception) {
+            std::vector<uint8_t> reply;
+            reply.push_back(pdu[0]);
+            reply.push_back(0x83);
+            reply.push_back(0x03);
+            uint16_t crc = ModbusCRC::compute(reply.data(), reply.size());
+            reply.push_back(crc & 0xFF);
+            reply.push_back(crc >> 8);
+            return reply;
+        }
+        // Contesta solo los primeros registros, con una trama Modbus válida
+        uint8_t truncated[8];
+        memcpy(truncated, pdu, sizeof(truncated));
+        truncated[4] = opts.max_span >> 8;
+        truncated[5] = opts.max_span & 0xFF;
+        return buildModbusReply(regs, truncated);
+    }
+    return buildModbusReply(regs, pdu);
+}
+
+// Encola la respuesta respetando el orden de las anteriores
+static void queueReply(Client *client, const std::vector<uint8_t> &frame) {
+    unsigned long due = nowMs() + opts.delay + (opts.jitter ? rand() % (opts.jitter + 1) : 0);
+    if (!client->tx.empty() && client->tx.back().due > due) {
+        due = client->tx.back().due;
+    }
+
+    size_t parts = opts.split < frame.size() ? opts.split : frame.size();
+    size_t pos = 0;
+    for (size_t i = 0; i < parts; i++) {
+        size_t len = (frame.size() - pos) / (parts - i);
+        Segment seg;
+        seg.due = due + i * opts.split_gap;
+        seg.bytes.assign(frame.begin() + pos, frame.begin() + pos + len);
+        client->tx.push_back(seg);
+        pos += len;
+    }
+}
+
+// Procesa las tramas completas recibidas
+static void processRequests(Client *client) {
+    std::vector<uint8_t> &rx = client->rx;
+    while (!rx.empty()) {
+        // Resincronizar con el siguiente inicio de trama
+        if (rx[0] != 0xA5) {
+            size_t skip = 1;
+            while (skip < rx.size() && rx[skip] != 0xA5) skip++;
+            rx.erase(rx.begin(), rx.begin() + skip);
+            stats.invalid++;
+            continue;
+        }
+        if (rx.size() < V5_HEADER_LEN) {
+            return;
+        }
+        size_t total = V5_HEADER_LEN + (rx[1] | (rx[2] << 8)) + V5_TRAILER_LEN;
+        if (total > MAX_FRAME_LEN) {
+            rx.erase(rx.begin());
+            stats.invalid++;
+            continue;
+        }
+        if (rx.size() < total) {
+            return;
+        }
+
+        const uint8_t *frame = rx.data();
+        uint32_t sn = frame[7] | (frame[8] << 8) | (frame[9] << 16) | ((uint32_t)frame[10] << 24);
+        bool valid = frame[total - 1] == 0x15 &&
+                     frame[total - 2] == ModbusCRC::sum(&frame[1], total - 3) &&
+                     frame[3] == 0x10;
+        bool request = frame[4] == 0x45 && total >= V5_HEADER_LEN + 15 + 8 + V5_TRAILER_LEN;
+        if (!valid) {
+            stats.invalid++;
+        } else if (opts.sn != 0 && sn != opts.sn) {
+            stats.invalid++;                // SN de otro datalogger: se ignora
+        } else if (frame[4] == 0x47) {
+            stats.heartbeats++;
+            queueReply(client, buildHeartbeatAck(frame));
+        } else if (!request) {
+            stats.invalid++;
+        } else {
+            stats.requests++;
+            const uint8_t *pdu = &frame[V5_HEADER_LEN + 15];
+            size_t pdu_len = total - V5_HEADER_LEN - 15 - V5_TRAILER_LEN;
+            std::vector<uint8_t> modbus = handleModbus(pdu, pdu_len);
+            bool drop = opts.drop_pct > 0 && (unsigned)(rand() % 100) < opts.drop_pct;
+            if (opts.verbose) {
+                printf("fd=%d seq=%02X addr=0x%04X count=%u%s\n", client->fd, frame[5],
+                       (pdu[2] << 8) | pdu[3], (pdu[4] << 8) | pdu[5], drop ? " (perdida)" : "");
+            }
+            if (drop) {
+                stats.dropped++;
+            } else if (!modbus.empty()) {
+                queueReply(client, buildResponse(frame, modbus.data(), modbus.size()));
+                stats.replies++;
+            }
+        }
+        rx.erase(rx.begin(), rx.begin() + total);
+    }
+}
+
+// Envía los segmentos que ya tocan; false si la conexión se ha caído
+static bool flushReplies(Client *client, unsigned long now) {
+    while (!client->tx.empty() && client->tx.front().due <= now) {
+        Segment &seg = client->tx.front();
+        ssize_t n = send(client->fd, seg.bytes.data(), seg.bytes.size(), MSG_NOSIGNAL);
+        if (n < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        if ((size_t)n < seg.bytes.size()) {
+            seg.bytes.erase(seg.bytes.begin(), seg.bytes.begin() + n);
+            return true;
+        }
+        client->tx.pop_front();
+    }
+    return true;
+}
+
+// Trama enviada por el datalogger por iniciativa propia (handshake, datos...)
+static std::vector<uint8_t> buildPushFrame(uint8_t control, uint8_t seq, const std::vector<uint8_t> &payload) {
+    std::vector<uint8_t> frame(V5_HEADER_LEN + payload.size() + V5_TRAILER_LEN);
+    frame[0] = 0xA5;
+    frame[1] = payload.size() & 0xFF;
+    frame[2] = (payload.size() >> 8) & 0xFF;
+    frame[3] = 0x10;
+    frame[4] = control;
+    frame[5] = seq;
+    for (int i = 0; i < 4; i++) {
+        frame[7 + i] = (opts.sn >> (8 * i)) & 0xFF;
+    }
+    memcpy(&frame[V5_HEADER_LEN], payload.data(), payload.size());
+    size_t checksum_pos = frame.size() - 2;
+    frame[checksum_pos] = ModbusCRC::sum(&frame[1], checksum_pos - 1);
+    frame[checksum_pos + 1] = 0x15;
+    return frame;
+}
+
+// Datos: tipo, sensor y tiempos (15 bytes) seguidos de los bloques de registros
+static std::vector<uint8_t> buildDataPayload() {
+    std::vector<uint8_t> payload(15, 0);
+    uint32_t uptime = nowMs() / 1000;
+    payload[0] = 0x01;
+    for (int i = 0; i < 4; i++) {
+        payload[3 + i] = (uptime >> (8 * i)) & 0xFF;
+    }
+    for (size_t b = 0; b < push_layout.count; b++) {
+        const RegisterBlock &block = push_layout.blocks[b];
+        for (uint16_t r = 0; r < block.count; r++) {
+            payload.push_back(regs[block.start_addr + r] >> 8);
+            payload.push_back(regs[block.start_addr + r] & 0xFF);
+        }
+    }
+    return payload;
+}
+
+static void closePush(PushClient *push) {
+    if (push->fd >= 0) {
+        close(push->fd);
+        push->fd = -1;
+    }
+    push->rx.clear();
+}
+
+static bool sendPush(PushClient *push, const std::vector<uint8_t> &frame) {
+    if (send(push->fd, frame.data(), frame.size(), MSG_NOSIGNAL) != (ssize_t)frame.size()) {
+        closePush(push);
+        return false;
+    }
+    return true;
+}
+
+// Conecta con el servidor si hace falta y envía una trama de datos cuando toca
+static void servePush(PushClient *push, unsigned long now) {
+    if (opts.push_host == NULL) {
+        return;
+    }
+
+    // Contar las confirmaciones del servidor
+    if (push->fd >= 0) {
+        uint8_t buffer[256];
+        ssize_t n = recv(push->fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            closePush(push);
+        } else if (n > 0) {
+            push->rx.insert(push->rx.end(), buffer, buffer + n);
+            while (push->rx.size() >= V5_HEADER_LEN) {
+                size_t total = V5_HEADER_LEN + (push->rx[1] | (push->rx[2] << 8)) + V5_TRAILER_LEN;
+                if (push->rx[0] != 0xA5 || total > MAX_FRAME_LEN) {
+                    closePush(push);
+                    break;
+                }
+                if (push->rx.size() < total) {
+                    break;
+                }
+                if (push->rx[4] == 0x12) {
+                    stats.push_acks++;
+                }
+                push->rx.erase(push->rx.begin(), push->rx.begin() + total);
+            }
+        }
+    }
+
+    if (now < push->next_at) {
+        return;
+    }
+    push->next_at = now + opts.push_interval * 1000UL;
+
+    if (push->fd < 0) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(opts.push_port);
+        if (inet_pton(AF_INET, opts.push_host, &addr.sin_addr) != 1) {
+            return;
+        }
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            if (fd >= 0) close(fd);
+            return;
+        }
+        push->fd = fd;
+        std::vector<uint8_t> hello(15, 0);
+        hello[0] = 0x02;
+        if (!sendPush(push, buildPushFrame(0x41, push->seq++, hello))) {
+            return;
+        }
+    }
+
+    if (sendPush(push, buildPushFrame(0x42, push->seq++, buildDataPayload()))) {
+        stats.pushes++;
+    }
+}
+
+static int openListener(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void acceptClient(int listen_fd, std::vector<Client> &clients) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    if (opts.single && !clients.empty()) {
+        close(fd);                          // El datalogger solo atiende a un cliente
+        stats.refused++;
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    Client client;
+    client.fd = fd;
+    client.ready_at = nowMs() + opts.accept_delay;
+    client.last_rx = client.ready_at;
+    clients.push_back(client);
+    stats.connections++;
+}
+
+int main(int argc, char **argv) {
+    loadDefaultImage(regs);
+    if (!parseArgs(argc, argv)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Disposición de las tramas de datos: los bloques del plan de lectura completo
+    SolarmanV5 layout_source("127.0.0.1", opts.sn);
+    DeyeInverter layout_inverter(&layout_source);
+    push_layout = layout_inverter.getReadPlan();
+    PushClient push;
+    push.fd = -1;
+    push.next_at = 0;
+    push.seq = 1;
+
+    int listen_fd = openListener(opts.port);
+    if (listen_fd < 0) {
+        perror("listen");
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    printf("Datalogger simulado en el puerto %u (retardo %u+%u ms, pérdidas %u%%, %u segmentos%s)\n",
+           opts.port, opts.delay, opts.jitter, opts.drop_pct, opts.split, opts.single ? ", una conexión" : "");
+    fflush(stdout);
+
+    std::vector<Client> clients;
+    std::vector<struct pollfd> fds;
+
+    while (running) {
+        unsigned long now = nowMs();
+
+        // Esperar hasta el siguiente evento programado como mucho
+        int timeout = 100;
+        for (size_t i = 0; i < clients.size(); i++) {
+            unsigned long next = clients[i].ready_at;
+            if (now >= next) {
+                if (clients[i].tx.empty()) continue;
+                next = clients[i].tx.front().due;
+            }
+            int wait = next > now ? (int)(next - now) : 0;
+            if (wait < timeout) timeout = wait;
+        }
+        for (size_t i = 0; i < clients.size() && opts.idle_timeout; i++) {
+            unsigned long idle_at = clients[i].last_rx + opts.idle_timeout;
+            int wait = idle_at > now ? (int)(idle_at - now) : 0;
+            if (wait < timeout) timeout = wait;
+        }
+
+        fds.clear();
+        struct pollfd pfd = {listen_fd, POLLIN, 0};
+        fds.push_back(pfd);
+        for (size_t i = 0; i < clients.size(); i++) {
+            pfd.fd = clients[i].fd;
+            pfd.events = now >= clients[i].ready_at ? POLLIN : 0;
+            pfd.revents = 0;
+            fds.push_back(pfd);
+        }
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        now = nowMs();
+
+        servePush(&push, now);
+        if (fds[0].revents & POLLIN) {
+            acceptClient(listen_fd, clients);
+        }
+
+        for (size_t i = 0; i < clients.size();) {
+            Client *client = &clients[i];
+            bool alive = true;
+            short revents = i + 1 < fds.size() ? fds[i + 1].revents : 0;
+
+            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                uint8_t buffer[512];
+                ssize_t n = recv(client->fd, buffer, sizeof(buffer), 0);
+                if (n > 0) {
+                    client->last_rx = now;
+                    client->rx.insert(client->rx.end(), buffer, buffer + n);
+                    processRequests(client);
+                } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                    alive = false;
+                }
+            }
+            if (alive && now >= client->ready_at) {
+                alive = flushReplies(client, now);
+            }
+            if (alive && opts.idle_timeout && now >= client->last_rx + opts.idle_timeout) {
+                alive = false;
+                stats.idle_closed++;
+            }
+
+            if (!alive) {
+                close(client->fd);
+                clients.erase(clients.begin() + i);
+                fds.erase(fds.begin() + i + 1);
+            } else {
+                i++;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < clients.size(); i++) {
+        close(clients[i].fd);
+    }
+    closePush(&push);
+    close(listen_fd);
+    printf("\nconexiones=%lu rechazadas=%lu peticiones=%lu respuestas=%lu perdidas=%lu invalidas=%lu"
+           " demasiado_largas=%lu heartbeats=%lu cerradas_inactivas=%lu envios=%lu confirmados=%lu\n",
+           stats.connections, stats.refused, stats.requests, stats.replies, stats.dropped, stats.invalid,
+           stats.oversized, stats.heartbeats, stats.idle_closed, stats.pushes, stats.push_acks);
+    return 0;
+}
@@ -0,0 +1,93 @@
+// Inversor Deye simulado, común a los simuladores del PC: imagen de registros
+// por defecto y respuesta a las tramas Modbus de lectura (función 0x03).
+
+#ifndef DEYE_SLAVE_H
+#define DEYE_SLAVE_H
+
+#include "ModbusCRC.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+static const uint16_t SLAVE_MAX_REGISTERS_PER_READ = 125;
+
+// Imagen por defecto: valores plausibles en todos los registros que lee DeyeInverter
+static void loadDefaultImage(uint16_t *regs) {
+    regs[0x0000] = 5;                       // Tipo: híbrido trifásico LV
+    regs[0x003B] = 2;                       // Estado: Normal
+    regs[0x004C] = 123;                     // Energía comprada hoy: 12.3 kWh
+    regs[0x004D] = 45;                      // Energía vendida hoy: 4.5 kWh
+    regs[0x004F] = 5000;                    // Frecuencia: 50.00 Hz
+    regs[0x0054] = 187;                     // Consumo hoy: 18.7 kWh
+    regs[0x005A] = 1345;                    // Temperatura DC: 34.5 °C
+    regs[0x0060] = 123456 & 0xFFFF;         // Producción total: 12345.6 kWh (32 bits)
+    regs[0x0061] = 123456 >> 16;
+    regs[0x006C] = 215;                     // Producción hoy: 21.5 kWh
+    regs[0x006D] = 3854;                    // PV1: 385.4 V
+    regs[0x006E] = 52;                      //      5.2 A
+    regs[0x006F] = 3721;                    // PV2: 372.1 V
+    regs[0x0070] = 48;                      //      4.8 A
+    regs[0x0096] = 2334;                    // Red L1: 233.4 V
+    regs[0x00A0] = 512;                     //         5.12 A
+    regs[0x00A9] = (uint16_t)-420;          // Potencia de red: -420 W (venta)
+    regs[0x00AD] = (uint16_t)1250;          // Potencia inversor L1
+    regs[0x00AE] = (uint16_t)-30;           // Potencia inversor L2
+    regs[0x00AF] = (uint16_t)1220;          // Potencia total inversor
+    regs[0x00B0] = 950;                     // Carga L1: 950 W
+    regs[0x00B2] = 1730;                    // Carga total: 1730 W
+    regs[0x00B6] = 1251;                    // Temperatura batería: 25.1 °C
+    regs[0x00B7] = 5230;                    // Batería: 52.30 V
+    regs[0x00B8] = 76;                      // SOC: 76 %
+    regs[0x00BA] = 2004;                    // Potencia PV1: 2004 W
+    regs[0x00BB] = 1786;                    // Potencia PV2: 1786 W
+    regs[0x00BD] = 0;                       // Estado batería: cargando
+    regs[0x00BE] = (uint16_t)-1200;         // Potencia batería: -1200 W (carga)
+    regs[0x00BF] = (uint16_t)-2294;         // Corriente batería: -22.94 A
+    regs[0x00F4] = 0;                       // Modo de trabajo: Selling First
+}
+
+// Opción --reg ADDR=VALOR (admite 0x.. y valores negativos)
+static bool parseReg(uint16_t *regs, const char *arg) {
+    const char *eq = strchr(arg, '=');
+    if (eq == NULL) {
+        return false;
+    }
+    long addr = strtol(arg, NULL, 0);
+    long value = strtol(eq + 1, NULL, 0);
+    if (addr < 0 || addr > 0xFFFF || value < -32768 || value > 0xFFFF) {
+        return false;
+    }
+    regs[addr] = (uint16_t)value;
+    return true;
+}
+
+// Respuesta (lectura o excepción) a una petición Modbus de 8 bytes con el CRC ya comprobado
+static std::vector<uint8_t> buildModbusReply(const uint16_t *regs, const uint8_t *pdu) {
+    std::vector<uint8_t> reply;
+    uint16_t start = (pdu[2] << 8) | pdu[3];
+    uint16_t count = (pdu[4] << 8) | pdu[5];
+    reply.push_back(pdu[0]);
+    if (pdu[1] != 0x03) {
+        reply.push_back(pdu[1] | 0x80);
+        reply.push_back(0x01);              // Función no soportada
+    } else if (count == 0 || count > SLAVE_MAX_REGISTERS_PER_READ || (uint32_t)start + count > 0x10000) {
+        reply.push_back(0x83);
+        reply.push_back(0x03);              // Valor no válido
+    } else {
+        reply.push_back(0x03);
+        reply.push_back(count * 2);
+        for (uint16_t i = 0; i < count; i++) {
+            reply.push_back(regs[start + i] >> 8);
+            reply.push_back(regs[start + i] & 0xFF);
+        }
+    }
+    uint16_t crc = ModbusCRC::compute(reply.data(), reply.size());
+    reply.push_back(crc & 0xFF);
+    reply.push_back(crc >> 8);
+    return reply;
+}
+
+#endif
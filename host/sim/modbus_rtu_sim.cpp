@@ -0,0 +1,258 @@
+// Simulador en el PC de un inversor Deye en el bus RS485 (Modbus RTU).
+//
+// Crea un pseudo-terminal (pty) que hace de puerto serie del inversor y
+// contesta en él las peticiones con la función Modbus 0x03 sobre la misma
+// imagen de registros que datalogger_sim. Como el pty entrega los bytes al
+// instante, cada respuesta se retrasa el tiempo que tardarían petición y
+// respuesta en pasar por el cable a la velocidad indicada, más el tiempo de
+// proceso del inversor.
+//
+// Compilar y ejecutar desde la raíz del repositorio:
+//   cmake -S host -B host/build && cmake --build host/build
+//   ./host/build/modbus_rtu_sim --link /tmp/ttyDEYE --baud 9600 --delay 15
+//   ./host/build/rtu_bench /tmp/ttyDEYE 9600
+//
+// Opciones:
+//   --link RUTA         Enlace simbólico al pty, para no depender de /dev/pts/N
+//   --slave N           Slave ID del inversor (1)
+//   --baud N            Velocidad simulada del bus (9600)
+//   --delay MS          Tiempo de proceso del inversor antes de contestar (10)
+//   --drop PCT          Porcentaje de peticiones sin respuesta (0)
+//   --reg ADDR=VALOR    Fija un registro (admite 0x.. y valores negativos); repetible
+//   --seed N            Semilla del generador aleatorio
+//   --verbose           Muestra cada petición
+
+#include "deye_slave.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <deque>
+#include <vector>
+
+static const size_t REQUEST_LEN = 8;                // Petición FC03: slave + función + dirección + cantidad + CRC
+
+struct Options {
+    const char *link;
+    uint8_t slave;
+    unsigned baud;
+    unsigned delay;
+    unsigned drop_pct;
+    bool verbose;
+};
+
+struct Reply {
+    unsigned long long due_us;
+    std::vector<uint8_t> bytes;
+};
+
+struct Stats {
+    unsigned long requests;
+    unsigned long replies;
+    unsigned long exceptions;
+    unsigned long dropped;
+    unsigned long other_slave;
+    unsigned long resyncs;
+};
+
+static Options opts;
+static Stats stats;
+static uint16_t regs[0x10000];
+static volatile sig_atomic_t running = 1;
+
+static unsigned long long nowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void onSignal(int) {
+    running = 0;
+}
+
+// Tiempo en el cable de len bytes en 8N1 con bit de parada: 10 bits por byte
+static unsigned long long wireTimeUs(size_t len) {
+    return (unsigned long long)len * 10 * 1000000 / opts.baud;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "uso: %s [--link RUTA] [--slave N] [--baud N] [--delay MS] [--drop PCT]\n"
+                    "          [--reg ADDR=VALOR]... [--seed N] [--verbose]\n", name);
+}
+
+static bool parseArgs(int argc, char **argv) {
+    opts.slave = 1;
+    opts.baud = 9600;
+    opts.delay = 10;
+    srand(time(NULL));
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--verbose") == 0) {
+            opts.verbose = true;
+        } else if (value == NULL) {
+            return false;
+        } else {
+            i++;
+            if (strcmp(arg, "--link") == 0) opts.link = value;
+            else if (strcmp(arg, "--slave") == 0) opts.slave = atoi(value);
+            else if (strcmp(arg, "--baud") == 0) opts.baud = atoi(value);
+            else if (strcmp(arg, "--delay") == 0) opts.delay = atoi(value);
+            else if (strcmp(arg, "--drop") == 0) opts.drop_pct = atoi(value);
+            else if (strcmp(arg, "--seed") == 0) srand(atoi(value));
+            else if (strcmp(arg, "--reg") == 0) {
+                if (!parseReg(regs, value)) return false;
+            } else {
+                return false;
+            }
+        }
+    }
+    return opts.baud > 0;
+}
+
+// Abre el pty y deja abierto también el lado esclavo, así el maestro no ve
+// un cierre cada vez que el cliente cierra el puerto
+static int openPty(int *slave_fd) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        return -1;
+    }
+    const char *name = ptsname(master);
+    *slave_fd = name ? open(name, O_RDWR | O_NOCTTY) : -1;
+    if (*slave_fd < 0) {
+        close(master);
+        return -1;
+    }
+    struct termios tio;
+    tcgetattr(*slave_fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(*slave_fd, TCSANOW, &tio);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL, 0) | O_NONBLOCK);
+
+    printf("Inversor simulado en %s", name);
+    if (opts.link) {
+        unlink(opts.link);
+        if (symlink(name, opts.link) == 0) {
+            printf(" (%s)", opts.link);
+        } else {
+            perror(" symlink");
+        }
+    }
+    printf(", slave %u, %u baudios, proceso %u ms, pérdidas %u%%\n", opts.slave, opts.baud, opts.delay, opts.drop_pct);
+    fflush(stdout);
+    return master;
+}
+
+// Separa las peticiones del flujo recibido: cada una son 8 bytes con CRC válido
+static void processRequests(std::vector<uint8_t> &rx, std::deque<Reply> &replies, unsigned long long now) {
+    while (rx.size() >= REQUEST_LEN) {
+        if (ModbusCRC::compute(rx.data(), 6) != (rx[6] | (rx[7] << 8))) {
+            // Ruido o trama de otro tipo: avanzar un byte hasta resincronizar
+            rx.erase(rx.begin());
+            stats.resyncs++;
+            continue;
+        }
+        uint8_t request[REQUEST_LEN];
+        memcpy(request, rx.data(), REQUEST_LEN);
+        rx.erase(rx.begin(), rx.begin() + REQUEST_LEN);
+        stats.requests++;
+
+        bool drop = opts.drop_pct > 0 && (unsigned)(rand() % 100) < opts.drop_pct;
+        if (opts.verbose) {
+            printf("slave=%u func=%02X addr=0x%04X count=%u%s\n", request[0], request[1],
+                   (request[2] << 8) | request[3], (request[4] << 8) | request[5], drop ? " (perdida)" : "");
+        }
+        if (request[0] != opts.slave) {
+            stats.other_slave++;            // Otro esclavo del bus: el inversor calla
+            continue;
+        }
+        if (drop) {
+            stats.dropped++;
+            continue;
+        }
+
+        Reply reply;
+        reply.bytes = buildModbusReply(regs, request);
+        if (reply.bytes[1] & 0x80) {
+            stats.exceptions++;
+        }
+        // La respuesta no puede empezar antes de que la anterior termine
+        unsigned long long start = now + wireTimeUs(REQUEST_LEN) + opts.delay * 1000ULL;
+        if (!replies.empty() && replies.back().due_us > start) {
+            start = replies.back().due_us;
+        }
+        reply.due_us = start + wireTimeUs(reply.bytes.size());
+        replies.push_back(reply);
+    }
+}
+
+int main(int argc, char **argv) {
+    loadDefaultImage(regs);
+    if (!parseArgs(argc, argv)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int slave_fd;
+    int master = openPty(&slave_fd);
+    if (master < 0) {
+        perror("pty");
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    std::vector<uint8_t> rx;
+    std::deque<Reply> replies;
+
+    while (running) {
+        unsigned long long now = nowUs();
+        int timeout = 100;
+        if (!replies.empty()) {
+            unsigned long long due = replies.front().due_us;
+            timeout = due > now ? (int)((due - now + 999) / 1000) : 0;
+        }
+
+        struct pollfd pfd = {master, POLLIN, 0};
+        if (poll(&pfd, 1, timeout) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        now = nowUs();
+
+        if (pfd.revents & POLLIN) {
+            uint8_t buffer[512];
+            ssize_t n = read(master, buffer, sizeof(buffer));
+            if (n > 0) {
+                rx.insert(rx.end(), buffer, buffer + n);
+                processRequests(rx, replies, now);
+            }
+        }
+
+        while (!replies.empty() && replies.front().due_us <= now) {
+            const std::vector<uint8_t> &bytes = replies.front().bytes;
+            if (write(master, bytes.data(), bytes.size()) == (ssize_t)bytes.size()) {
+                stats.replies++;
+            }
+            replies.pop_front();
+        }
+    }
+
+    close(slave_fd);
+    close(master);
+    if (opts.link) {
+        unlink(opts.link);
+    }
+    printf("\npeticiones=%lu respuestas=%lu excepciones=%lu perdidas=%lu otro_esclavo=%lu resincronizaciones=%lu\n",
+           stats.requests, stats.replies, stats.exceptions, stats.dropped, stats.other_slave, stats.resyncs);
+    return 0;
+}
@@ -0,0 +1,337 @@
+// Simulador en el PC de una pasarela Modbus TCP (RS485-Ethernet) delante de
+// un inversor Deye.
+//
+// Atiende peticiones Modbus TCP (cabecera MBAP) con la función 0x03 sobre la
+// misma imagen de registros que datalogger_sim, con varias transacciones en
+// vuelo por conexión. Por defecto contesta en orden, como una pasarela que
+// pasa las peticiones de una en una por el bus RS485; con --parallel cada
+// respuesta sale en cuanto cumple su retardo, y con jitter llegan
+// desordenadas, como en un equipo Modbus TCP nativo.
+//
+// Compilar y ejecutar desde la raíz del repositorio:
+//   cmake -S host -B host/build && cmake --build host/build
+//   ./host/build/modbus_tcp_sim --port 1502 --delay 20 --jitter 10
+//   ./host/build/mbtcp_bench 127.0.0.1 1502
+//
+// Opciones:
+//   --port N            Puerto TCP (1502; el 502 estándar requiere privilegios)
+//   --unit N            Unit ID del inversor (1); a otros se contesta con la excepción 0x0B
+//   --delay MS          Retardo de cada respuesta (0)
+//   --jitter MS         Retardo aleatorio añadido, de 0 a MS (0)
+//   --parallel          Respuestas independientes en lugar de una detrás de otra
+//   --drop PCT          Porcentaje de peticiones sin respuesta (0)
+//   --reg ADDR=VALOR    Fija un registro (admite 0x.. y valores negativos); repetible
+//   --seed N            Semilla del generador aleatorio
+//   --verbose           Muestra cada petición
+
+#include "deye_slave.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+static const size_t MBAP_HEADER_LEN = 7;
+static const size_t MAX_ADU_LEN = 260;
+
+struct Options {
+    uint16_t port;
+    uint8_t unit;
+    unsigned delay;
+    unsigned jitter;
+    unsigned drop_pct;
+    bool parallel;
+    bool verbose;
+};
+
+struct Reply {
+    unsigned long due;
+    std::vector<uint8_t> bytes;
+};
+
+struct Client {
+    int fd;
+    std::vector<uint8_t> rx;
+    std::vector<Reply> tx;          // Ordenadas por instante de envío
+};
+
+struct Stats {
+    unsigned long connections;
+    unsigned long requests;
+    unsigned long replies;
+    unsigned long exceptions;
+    unsigned long dropped;
+    unsigned long invalid;
+    unsigned long reordered;
+};
+
+static Options opts;
+static Stats stats;
+static uint16_t regs[0x10000];
+static unsigned long bus_free_at;  // Fin de la última respuesta en modo pasarela
+static volatile sig_atomic_t running = 1;
+
+static unsigned long nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void onSignal(int) {
+    running = 0;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "uso: %s [--port N] [--unit N] [--delay MS] [--jitter MS] [--parallel] [--drop PCT]\n"
+                    "          [--reg ADDR=VALOR]... [--seed N] [--verbose]\n", name);
+}
+
+static bool parseArgs(int argc, char **argv) {
+    opts.port = 1502;
+    opts.unit = 1;
+    srand(time(NULL));
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--parallel") == 0) {
+            opts.parallel = true;
+        } else if (strcmp(arg, "--verbose") == 0) {
+            opts.verbose = true;
+        } else if (value == NULL) {
+            return false;
+        } else {
+            i++;
+            if (strcmp(arg, "--port") == 0) opts.port = atoi(value);
+            else if (strcmp(arg, "--unit") == 0) opts.unit = atoi(value);
+            else if (strcmp(arg, "--delay") == 0) opts.delay = atoi(value);
+            else if (strcmp(arg, "--jitter") == 0) opts.jitter = atoi(value);
+            else if (strcmp(arg, "--drop") == 0) opts.drop_pct = atoi(value);
+            else if (strcmp(arg, "--seed") == 0) srand(atoi(value));
+            else if (strcmp(arg, "--reg") == 0) {
+                if (!parseReg(regs, value)) return false;
+            } else {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Respuesta MBAP: misma cabecera que la petición con la PDU de respuesta
+static std::vector<uint8_t> buildAdu(const uint8_t *request, const uint8_t *pdu) {
+    std::vector<uint8_t> reply;
+    if (pdu[0] != opts.unit) {
+        // La pasarela no obtuvo respuesta del esclavo
+        reply.push_back(pdu[0]);
+        reply.push_back(pdu[1] | 0x80);
+        reply.push_back(0x0B);
+        reply.push_back(0);
+        reply.push_back(0);
+    } else {
+        reply = buildModbusReply(regs, pdu);
+    }
+    size_t length = reply.size() - 2;       // Sin CRC: unit ID + PDU
+    std::vector<uint8_t> adu(MBAP_HEADER_LEN - 1 + length);
+    memcpy(adu.data(), request, 4);         // Transaction ID + protocolo
+    adu[4] = length >> 8;
+    adu[5] = length & 0xFF;
+    memcpy(&adu[6], reply.data(), length);
+    return adu;
+}
+
+static void queueReply(Client *client, Reply reply) {
+    size_t pos = client->tx.size();
+    while (pos > 0 && client->tx[pos - 1].due > reply.due) {
+        pos--;
+    }
+    if (pos < client->tx.size()) {
+        stats.reordered++;
+    }
+    client->tx.insert(client->tx.begin() + pos, reply);
+}
+
+// Procesa las peticiones completas; false si el flujo no es Modbus TCP
+static bool processRequests(Client *client, unsigned long now) {
+    while (client->rx.size() >= MBAP_HEADER_LEN) {
+        const uint8_t *header = client->rx.data();
+        size_t length = (header[4] << 8) | header[5];
+        if (header[2] != 0 || header[3] != 0 || length < 2 || MBAP_HEADER_LEN - 1 + length > MAX_ADU_LEN) {
+            stats.invalid++;
+            return false;
+        }
+        size_t adu_len = MBAP_HEADER_LEN - 1 + length;
+        if (client->rx.size() < adu_len) {
+            break;
+        }
+        stats.requests++;
+
+        // Petición en formato RTU (unit + PDU) para el inversor simulado
+        uint8_t pdu[8] = {};
+        memcpy(pdu, &header[6], length < 6 ? length : 6);
+        bool drop = opts.drop_pct > 0 && (unsigned)(rand() % 100) < opts.drop_pct;
+        if (opts.verbose) {
+            printf("fd=%d tid=%u unit=%u func=%02X addr=0x%04X count=%u%s\n", client->fd,
+                   (header[0] << 8) | header[1], pdu[0], pdu[1], (pdu[2] << 8) | pdu[3],
+                   (pdu[4] << 8) | pdu[5], drop ? " (perdida)" : "");
+        }
+        if (drop) {
+            stats.dropped++;
+        } else {
+            Reply reply;
+            reply.bytes = buildAdu(header, pdu);
+            if (reply.bytes[7] & 0x80) {
+                stats.exceptions++;
+            }
+            unsigned long wait = opts.delay + (opts.jitter ? rand() % (opts.jitter + 1) : 0);
+            if (opts.parallel) {
+                reply.due = now + wait;
+            } else {
+                reply.due = (bus_free_at > now ? bus_free_at : now) + wait;
+                bus_free_at = reply.due;
+            }
+            queueReply(client, reply);
+        }
+        client->rx.erase(client->rx.begin(), client->rx.begin() + adu_len);
+    }
+    return true;
+}
+
+static bool flushReplies(Client *client, unsigned long now) {
+    while (!client->tx.empty() && client->tx.front().due <= now) {
+        const std::vector<uint8_t> &bytes = client->tx.front().bytes;
+        if (send(client->fd, bytes.data(), bytes.size(), MSG_NOSIGNAL) != (ssize_t)bytes.size()) {
+            return false;
+        }
+        stats.replies++;
+        client->tx.erase(client->tx.begin());
+    }
+    return true;
+}
+
+static int openListener(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char **argv) {
+    loadDefaultImage(regs);
+    if (!parseArgs(argc, argv)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int listen_fd = openListener(opts.port);
+    if (listen_fd < 0) {
+        perror("listen");
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    printf("Pasarela Modbus TCP simulada en el puerto %u (unit %u, retardo %u+%u ms, %s, pérdidas %u%%)\n",
+           opts.port, opts.unit, opts.delay, opts.jitter, opts.parallel ? "en paralelo" : "en orden", opts.drop_pct);
+    fflush(stdout);
+
+    std::vector<Client> clients;
+    std::vector<struct pollfd> fds;
+
+    while (running) {
+        unsigned long now = nowMs();
+        int timeout = 100;
+        for (size_t i = 0; i < clients.size(); i++) {
+            if (clients[i].tx.empty()) continue;
+            unsigned long due = clients[i].tx.front().due;
+            int wait = due > now ? (int)(due - now) : 0;
+            if (wait < timeout) timeout = wait;
+        }
+
+        fds.clear();
+        struct pollfd pfd = {listen_fd, POLLIN, 0};
+        fds.push_back(pfd);
+        for (size_t i = 0; i < clients.size(); i++) {
+            pfd.fd = clients[i].fd;
+            pfd.revents = 0;
+            fds.push_back(pfd);
+        }
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) {
+            perror("poll");
+            break;
+        }
+        now = nowMs();
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd >= 0) {
+                int nodelay = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+                Client client;
+                client.fd = fd;
+                clients.push_back(client);
+                stats.connections++;
+            }
+        }
+
+        for (size_t i = 0; i < clients.size();) {
+            Client *client = &clients[i];
+            bool alive = true;
+            short revents = i + 1 < fds.size() ? fds[i + 1].revents : 0;
+
+            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                uint8_t buffer[512];
+                ssize_t n = recv(client->fd, buffer, sizeof(buffer), 0);
+                if (n > 0) {
+                    client->rx.insert(client->rx.end(), buffer, buffer + n);
+                    alive = processRequests(client, now);
+                } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                    alive = false;
+                }
+            }
+            if (alive) {
+                alive = flushReplies(client, now);
+            }
+
+            if (!alive) {
+                close(client->fd);
+                clients.erase(clients.begin() + i);
+                fds.erase(fds.begin() + i + 1);
+            } else {
+                i++;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < clients.size(); i++) {
+        close(clients[i].fd);
+    }
+    close(listen_fd);
+    printf("\nconexiones=%lu peticiones=%lu respuestas=%lu excepciones=%lu perdidas=%lu invalidas=%lu desordenadas=%lu\n",
+           stats.connections, stats.requests, stats.replies, stats.exceptions, stats.dropped, stats.invalid,
+           stats.reordered);
+    return 0;
+}